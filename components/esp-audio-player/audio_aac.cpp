@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_aac_dec.h"
+#include "audio_log.h"
+#include "audio_aac.h"
+
+static const char *TAG = "aac";
+
+/** The ADTS frame length field is 13 bits */
+#define AAC_DATA_BUF_SIZE   (8192)
+/** Refill trigger, a stereo AAC frame is at most 1536 bytes plus its header */
+#define AAC_REFILL_BYTES    (2048)
+/** 2048 stereo frames, what HE-AAC with parametric stereo decodes a frame to, grown for more channels */
+#define AAC_PCM_SIZE        (2048 * 2 * sizeof(int16_t))
+
+static inline bool is_adts_sync(const uint8_t *p) {
+    // ADTS sync word with layer 0, MPEG audio frames have a non zero layer
+    return (p[0] == 0xFF) && ((p[1] & 0xF6) == 0xF0);
+}
+
+/** frame length from a 7 byte ADTS header, the header included */
+static inline size_t adts_frame_length(const uint8_t *p) {
+    return ((p[3] & 0x03) << 11) | (p[4] << 3) | (p[5] >> 5);
+}
+
+static void aac_fill(FILE *fp, aac_instance *pInstance) {
+    size_t unread_bytes = pInstance->bytes_in_data_buf - (pInstance->read_ptr - pInstance->data_buf);
+
+    /* move the unread bytes to the start, then fill with new data */
+    memmove(pInstance->data_buf, pInstance->read_ptr, unread_bytes);
+    size_t nRead = fread(pInstance->data_buf + unread_bytes, 1, pInstance->data_buf_size - unread_bytes, fp);
+
+    pInstance->bytes_in_data_buf = unread_bytes + nRead;
+    pInstance->read_ptr = pInstance->data_buf;
+
+    if ((nRead == 0) || feof(fp)) {
+        pInstance->eof_reached = true;
+    }
+
+    LOGI_2("nRead %d, eof %d", (int)nRead, pInstance->eof_reached);
+}
+
+bool is_aac(const uint8_t *head, size_t len) {
+    return (len >= 7) && is_adts_sync(head);
+}
+
+bool aac_start(const uint8_t *head, size_t len, aac_instance *pInstance) {
+    memset(pInstance, 0, sizeof(*pInstance));
+
+    pInstance->data_buf_size = AAC_DATA_BUF_SIZE;
+    pInstance->data_buf = static_cast<uint8_t*>(malloc(pInstance->data_buf_size));
+    pInstance->pcm.size = AAC_PCM_SIZE;
+    pInstance->pcm.buf = static_cast<uint8_t*>(malloc(pInstance->pcm.size));
+    if((pInstance->data_buf == NULL) || (pInstance->pcm.buf == NULL)) {
+        ESP_LOGE(TAG, "Failed allocate aac buffers");
+        aac_stop(pInstance);
+        return false;
+    }
+
+    esp_aac_dec_cfg_t cfg = ESP_AAC_DEC_CONFIG_DEFAULT();
+    if(esp_aac_dec_open(&cfg, sizeof(cfg), &pInstance->decoder) != ESP_AUDIO_ERR_OK) {
+        ESP_LOGE(TAG, "Failed create AAC decoder");
+        aac_stop(pInstance);
+        return false;
+    }
+
+    // the probed bytes are the start of the stream, decode them before reading on
+    memcpy(pInstance->data_buf, head, len);
+    pInstance->bytes_in_data_buf = len;
+    pInstance->read_ptr = pInstance->data_buf;
+    return true;
+}
+
+DECODE_STATUS decode_aac(FILE *fp, decode_data *pData, aac_instance *pInstance) {
+    pData->fmt = pInstance->fmt;
+    if(pcm_queue_pop(&pInstance->pcm, pData)) {
+        return DECODE_STATUS_CONTINUE;
+    }
+
+    size_t unread_bytes = pInstance->bytes_in_data_buf - (pInstance->read_ptr - pInstance->data_buf);
+    if((unread_bytes < AAC_REFILL_BYTES) && !pInstance->eof_reached) {
+        aac_fill(fp, pInstance);
+        unread_bytes = pInstance->bytes_in_data_buf;
+    }
+
+    if(unread_bytes == 0) {
+        LOGI_1("unread_bytes == 0, status done");
+        return DECODE_STATUS_DONE;
+    }
+
+    /* Find the ADTS sync word, the last byte is kept as it can start one */
+    uint8_t *sync = pInstance->read_ptr;
+    uint8_t *end = pInstance->read_ptr + unread_bytes;
+    while(((sync + 1) < end) && !is_adts_sync(sync)) {
+        sync++;
+    }
+    if(sync != pInstance->read_ptr) {
+        ESP_LOGE(TAG, "ADTS sync word not found, dropping %d bytes", (int)(sync - pInstance->read_ptr));
+        unread_bytes -= sync - pInstance->read_ptr;
+        pInstance->read_ptr = sync;
+    }
+
+    size_t frame_length = (unread_bytes >= 7) ? adts_frame_length(pInstance->read_ptr) : 0;
+    if((unread_bytes < 7) || (frame_length > unread_bytes)) {
+        if(pInstance->eof_reached) {
+            LOGI_1("truncated last frame, status done");
+            return DECODE_STATUS_DONE;
+        }
+        aac_fill(fp, pInstance);
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+    if(frame_length < 7) {
+        // not a frame header after all, search again past it
+        pInstance->read_ptr++;
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+
+    esp_audio_dec_in_raw_t raw = {};
+    raw.buffer = pInstance->read_ptr;
+    raw.len = frame_length;
+    esp_audio_dec_out_frame_t frame = {};
+    frame.buffer = pInstance->pcm.buf;
+    frame.len = pInstance->pcm.size;
+    esp_audio_dec_info_t info;
+    esp_audio_err_t err = esp_aac_dec_decode(pInstance->decoder, &raw, &frame, &info);
+    if(err == ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
+        // more channels than the initial size allows, grow to what the decoder asks for and retry
+        uint8_t *buf = static_cast<uint8_t*>(realloc(pInstance->pcm.buf, frame.needed_size));
+        if(buf == NULL) {
+            ESP_LOGE(TAG, "Failed grow pcm buffer to %d bytes", (int)frame.needed_size);
+            return DECODE_STATUS_ERROR;
+        }
+        LOGI_1("pcm buffer %d -> %d bytes", (int)pInstance->pcm.size, (int)frame.needed_size);
+        pInstance->pcm.buf = buf;
+        pInstance->pcm.size = frame.needed_size;
+        frame.buffer = pInstance->pcm.buf;
+        frame.len = pInstance->pcm.size;
+        frame.decoded_size = 0;
+        raw.consumed = 0;
+        err = esp_aac_dec_decode(pInstance->decoder, &raw, &frame, &info);
+    }
+    if(err != ESP_AUDIO_ERR_OK) {
+        // like a misdetected mp3 frame header, drop the sync word and search again
+        ESP_LOGE(TAG, "status error %d", err);
+        pInstance->read_ptr++;
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+    pInstance->read_ptr += frame_length;
+
+    pInstance->fmt.sample_rate = info.sample_rate;
+    pInstance->fmt.bits_per_sample = info.bits_per_sample;
+    pInstance->fmt.channels = info.channel;
+    pData->fmt = pInstance->fmt;
+
+    pInstance->pcm.len = frame.decoded_size;
+    pInstance->pcm.pos = 0;
+
+    LOGI_3("aac: channels %d, sr %d, bps %d, frame bytes %d, decoded %d",
+        (int)pData->fmt.channels,
+        pData->fmt.sample_rate,
+        (int)pData->fmt.bits_per_sample,
+        (int)frame_length,
+        (int)frame.decoded_size);
+
+    return pcm_queue_pop(&pInstance->pcm, pData) ? DECODE_STATUS_CONTINUE : DECODE_STATUS_NO_DATA_CONTINUE;
+}
+
+void aac_stop(aac_instance *pInstance) {
+    if(pInstance->decoder) esp_aac_dec_close(pInstance->decoder);
+    if(pInstance->data_buf) free(pInstance->data_buf);
+    if(pInstance->pcm.buf) free(pInstance->pcm.buf);
+    pInstance->decoder = NULL;
+    pInstance->data_buf = NULL;
+    pInstance->pcm.buf = NULL;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdio.h>
+#include "audio_decode_types.h"
+
+typedef struct {
+    uint8_t *data_buf;
+
+    /** number of bytes in data_buf, room for the largest ADTS frame */
+    size_t data_buf_size;
+
+    /**
+     * Total bytes in data_buf,
+     * not the number of bytes remaining after the read_ptr
+     */
+    size_t bytes_in_data_buf;
+
+    /** Pointer to read location in data_buf */
+    uint8_t *read_ptr;
+
+    // set to true if the end of file has been reached
+    bool eof_reached;
+
+    void *decoder;
+    format fmt;
+    pcm_queue pcm;
+} aac_instance;
+
+/**
+ * @param head - the first bytes of the file, read once by the caller
+ */
+bool is_aac(const uint8_t *head, size_t len);
+/**
+ * Open a decoder for a new ADTS stream whose first len bytes were already read into head
+ *
+ * @return true if the decoder is open, aac_stop() must be called then
+ */
+bool aac_start(const uint8_t *head, size_t len, aac_instance *pInstance);
+DECODE_STATUS decode_aac(FILE *fp, decode_data *pData, aac_instance *pInstance);
+/**
+ * Close the decoder and free the buffers aac_start() allocated
+ */
+void aac_stop(aac_instance *pInstance);
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
 typedef enum {
     DECODE_STATUS_CONTINUE,         /*< data remaining, call decode again */
@@ -53,5 +55,47 @@ typedef struct {
 } decode_data;
 
 
+/** Bytes read once from the start of a file to detect its type, then decoded */
+#define AUDIO_PROBE_BYTES   64
+
 #define BYTES_IN_WORD       2
 #define BITS_PER_BYTE       8
+
+/**
+ * Audio decoded a packet at a time into a buffer of its own, that can be larger
+ * than decode_data::samples, and handed out over several decode calls
+ */
+typedef struct {
+    uint8_t *buf;
+
+    /** capacity of buf */
+    size_t size;
+
+    /** bytes decoded into buf */
+    size_t len;
+
+    /** bytes of buf handed out so far */
+    size_t pos;
+} pcm_queue;
+
+/**
+ * Copy as many whole frames as fit into pData->samples, pData->fmt must be set
+ *
+ * @return false if the queue was empty
+ */
+static inline bool pcm_queue_pop(pcm_queue *pQueue, decode_data *pData) {
+    if(pQueue->pos == pQueue->len) {
+        pData->frame_count = 0;
+        return false;
+    }
+
+    size_t bytes_per_frame = pData->fmt.channels * (pData->fmt.bits_per_sample / BITS_PER_BYTE);
+    size_t max = (pData->samples_capacity / bytes_per_frame) * bytes_per_frame;
+    size_t n = pQueue->len - pQueue->pos;
+    n = (n < max) ? n : max;
+
+    memcpy(pData->samples, pQueue->buf + pQueue->pos, n);
+    pQueue->pos += n;
+    pData->frame_count = n / bytes_per_frame;
+    return n != 0;
+}
@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "audio_kernels.h"
+
+#if CONFIG_AUDIO_PLAYER_OUTPUT_SIMD
+extern "C" void audio_kernel_gain_s16_aes3(int16_t *samples, const int16_t *gain, uint32_t blocks);
+#endif
+
+/** a stereo frame stored at once, the int16_t buffer is accessed through it */
+typedef uint32_t __attribute__((may_alias)) stereo_frame_t;
+
+static inline int16_t clip16(int32_t v)
+{
+    return (v > INT16_MAX) ? INT16_MAX : ((v < INT16_MIN) ? INT16_MIN : v);
+}
+
+static inline stereo_frame_t stereo_frame(int16_t v)
+{
+    return static_cast<uint16_t>(v) | (static_cast<uint32_t>(static_cast<uint16_t>(v)) << 16);
+}
+
+void audio_gain_set(audio_gain_t *gain, int32_t target, uint32_t ramp_frames)
+{
+    target = (target < 0) ? 0 : ((target > AUDIO_GAIN_UNITY) ? AUDIO_GAIN_UNITY : target);
+    gain->target = target;
+    int32_t left = (target << 15) - gain->pos;
+    if((ramp_frames == 0) || (left == 0)) {
+        gain->pos = target << 15;
+        gain->step = 0;
+        return;
+    }
+    // rounded away from zero, so the target is reached within ramp_frames
+    int32_t n = static_cast<int32_t>(ramp_frames);
+    gain->step = (left > 0) ? (left + n - 1) / n : (left - n + 1) / n;
+}
+
+/** frames of this block still on the ramp */
+static size_t gain_ramp_frames(const audio_gain_t *gain, size_t frames)
+{
+    if(gain->step == 0) {
+        return 0;
+    }
+    int32_t left = (gain->target << 15) - gain->pos;
+    int32_t round = (gain->step > 0) ? gain->step - 1 : gain->step + 1;
+    size_t ramp = (left + round) / gain->step;
+    return (ramp < frames) ? ramp : frames;
+}
+
+static void gain_advance(audio_gain_t *gain, size_t frames)
+{
+    if(gain->step == 0) {
+        return;
+    }
+    if(frames == gain_ramp_frames(gain, SIZE_MAX)) {
+        gain->pos = gain->target << 15;
+        gain->step = 0;
+    } else {
+        gain->pos += gain->step * static_cast<int32_t>(frames);
+    }
+}
+
+static inline int32_t gain_at(const audio_gain_t *gain, size_t frame)
+{
+    return static_cast<int32_t>((gain->pos + static_cast<int64_t>(gain->step) * frame) >> 15);
+}
+
+void audio_kernel_gain_ansi(int16_t *samples, size_t count, int16_t gain)
+{
+    for(size_t k = 0; k < count; k++) {
+        samples[k] = clip16((samples[k] * gain) >> 15);
+    }
+}
+
+void audio_kernel_gain(int16_t *samples, size_t count, int16_t gain)
+{
+#if CONFIG_AUDIO_PLAYER_OUTPUT_SIMD
+    // the vector loads and stores need 16 byte alignment, the edges are done in C
+    size_t head = ((16 - (reinterpret_cast<uintptr_t>(samples) & 15)) & 15) / sizeof(int16_t);
+    head = (head < count) ? head : count;
+    audio_kernel_gain_ansi(samples, head, gain);
+    samples += head;
+    count -= head;
+
+    size_t blocks = count / 8;
+    if(blocks) {
+        audio_kernel_gain_s16_aes3(samples, &gain, blocks);
+    }
+    audio_kernel_gain_ansi(samples + blocks * 8, count - blocks * 8, gain);
+#else
+    audio_kernel_gain_ansi(samples, count, gain);
+#endif
+}
+
+void audio_kernel_output(int16_t *samples, size_t frames, uint32_t channels, audio_gain_t *gain)
+{
+    size_t ramp = gain_ramp_frames(gain, frames);
+    int32_t g = gain->target;
+
+    if(channels == 1) {
+        // back to front, stereo frame k covers mono samples 2k and 2k + 1, which are already read
+        stereo_frame_t *out = reinterpret_cast<stereo_frame_t*>(samples);
+        size_t k = frames;
+        if(g == AUDIO_GAIN_UNITY) {
+            while(k > ramp) {
+                k--;
+                out[k] = stereo_frame(samples[k]);
+            }
+        } else {
+            while(k > ramp) {
+                k--;
+                out[k] = stereo_frame(clip16((samples[k] * g) >> 15));
+            }
+        }
+        while(k) {
+            k--;
+            out[k] = stereo_frame(clip16((samples[k] * gain_at(gain, k)) >> 15));
+        }
+    } else {
+        for(size_t k = 0; k < ramp; k++) {
+            int32_t gk = gain_at(gain, k);
+            samples[k * 2] = clip16((samples[k * 2] * gk) >> 15);
+            samples[k * 2 + 1] = clip16((samples[k * 2 + 1] * gk) >> 15);
+        }
+        if(g != AUDIO_GAIN_UNITY) {
+            audio_kernel_gain(samples + ramp * 2, (frames - ramp) * 2, g);
+        }
+    }
+
+    gain_advance(gain, ramp);
+}
@@ -4,14 +4,12 @@
 
 static const char *TAG = "mp3";
 
-bool is_mp3(FILE *fp) {
+bool is_mp3(const uint8_t *head, size_t len) {
     bool is_mp3_file = false;
 
-    fseek(fp, 0, SEEK_SET);
-
     // see https://en.wikipedia.org/wiki/List_of_file_signatures
-    uint8_t magic[3];
-    if(sizeof(magic) == fread(magic, 1, sizeof(magic), fp)) {
+    const uint8_t *magic = head;
+    if(len >= 3) {
         if((magic[0] == 0xFF) &&
             (magic[1] == 0xFB))
         {
@@ -28,25 +26,24 @@ bool is_mp3(FILE *fp) {
                   (magic[1] == 0x44) &&
                   (magic[2] == 0x33)) /* 'ID3' */
         {
-            fseek(fp, 0, SEEK_SET);
-
-            /* Get ID3 head */
-            mp3_id3_header_v2_t tag;
-            if (sizeof(mp3_id3_header_v2_t) == fread(&tag, 1, sizeof(mp3_id3_header_v2_t), fp)) {
-                if (memcmp("ID3", (const void *) &tag, sizeof(tag.header)) == 0) {
-                    is_mp3_file = true;
-                }
+            /* the whole ID3v2 head is there */
+            if (len >= sizeof(mp3_id3_header_v2_t)) {
+                is_mp3_file = true;
             }
         }
     }
 
-    // seek back to the start of the file to avoid
-    // missing frames upon decode
-    fseek(fp, 0, SEEK_SET);
-
     return is_mp3_file;
 }
 
+void mp3_start(const uint8_t *head, size_t len, mp3_instance *pInstance) {
+    // the probed bytes are the start of the stream, decode them before reading on
+    memcpy(pInstance->data_buf, head, len);
+    pInstance->bytes_in_data_buf = len;
+    pInstance->read_ptr = pInstance->data_buf;
+    pInstance->eof_reached = false;
+}
+
 /**
  * @return true if data remains, false on error or end of file
  */
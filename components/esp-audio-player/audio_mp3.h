@@ -44,5 +44,12 @@ typedef struct {
     bool eof_reached;
 } mp3_instance;
 
-bool is_mp3(FILE *fp);
+/**
+ * @param head - the first bytes of the file, read once by the caller
+ */
+bool is_mp3(const uint8_t *head, size_t len);
+/**
+ * Reset pInstance for a new file whose first len bytes were already read into head
+ */
+void mp3_start(const uint8_t *head, size_t len, mp3_instance *pInstance);
 DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, FILE *fp, decode_data *pData, mp3_instance *pInstance);
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_opus_dec.h"
+#include "audio_log.h"
+#include "audio_opus.h"
+
+static const char *TAG = "opus";
+
+/** Larger packets are dropped, 120 ms of the highest bitrate Opus allows is below this */
+#define OPUS_PACKET_MAX     (4096)
+/** The longest Opus packet decodes to 120 ms */
+#define OPUS_FRAME_MS_MAX   (120)
+
+/**
+ * Read from the probed bytes first, then from the file, so a stream that
+ * cannot seek is read exactly once
+ */
+static size_t opus_read(FILE *fp, opus_instance *pInstance, void *dst, size_t len) {
+    size_t from_head = (len < pInstance->head_len) ? len : pInstance->head_len;
+    memcpy(dst, pInstance->head, from_head);
+    pInstance->head += from_head;
+    pInstance->head_len -= from_head;
+
+    size_t bytes_read = from_head;
+    if(bytes_read < len) {
+        bytes_read += fread(static_cast<uint8_t*>(dst) + from_head, 1, len - from_head, fp);
+    }
+    return bytes_read;
+}
+
+/**
+ * Read the next Ogg page header and its lacing values, see RFC 3533
+ */
+static bool ogg_next_page(FILE *fp, opus_instance *pInstance) {
+    uint8_t page[27];
+    if(opus_read(fp, pInstance, page, sizeof(page)) != sizeof(page)) {
+        return false;
+    }
+    if(memcmp(page, "OggS", 4) != 0) {
+        ESP_LOGE(TAG, "lost the Ogg page sync");
+        return false;
+    }
+
+    pInstance->segment_count = page[26];
+    pInstance->segment_index = 0;
+    return opus_read(fp, pInstance, pInstance->segments, pInstance->segment_count) == pInstance->segment_count;
+}
+
+/**
+ * Put the next packet together, a lacing value below 255 ends it
+ *
+ * @return false at the end of the stream
+ */
+static bool ogg_next_packet(FILE *fp, opus_instance *pInstance) {
+    pInstance->packet_len = 0;
+    while(true) {
+        if(pInstance->segment_index == pInstance->segment_count) {
+            if(!ogg_next_page(fp, pInstance)) {
+                return false;
+            }
+            continue;
+        }
+
+        size_t n = pInstance->segments[pInstance->segment_index++];
+        // an oversized packet is read over the start of the buffer, and dropped by the caller
+        bool fits = (pInstance->packet_len + n) <= pInstance->packet_size;
+        uint8_t *dst = fits ? pInstance->packet + pInstance->packet_len : pInstance->packet;
+        if(opus_read(fp, pInstance, dst, n) != n) {
+            return false;
+        }
+        pInstance->packet_len = fits ? pInstance->packet_len + n : pInstance->packet_size + 1;
+
+        if(n < 255) {
+            return true;
+        }
+    }
+}
+
+/**
+ * Opus decodes straight to 8, 12, 16 or 24 kHz, which spares the resampler
+ * when the output runs at one of them
+ */
+static uint32_t opus_decode_rate(void) {
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+    switch(CONFIG_AUDIO_PLAYER_RESAMPLE_RATE) {
+        case 8000:
+        case 12000:
+        case 16000:
+        case 24000:
+            return CONFIG_AUDIO_PLAYER_RESAMPLE_RATE;
+    }
+#endif
+    return 48000;
+}
+
+bool is_opus(const uint8_t *head, size_t len) {
+    // first page carries the Opus identification header, RFC 7845
+    return (len >= 36) &&
+           (memcmp(head, "OggS", 4) == 0) &&
+           (memcmp(head + 28, "OpusHead", 8) == 0);
+}
+
+bool opus_start(FILE *fp, const uint8_t *head, size_t len, opus_instance *pInstance) {
+    memset(pInstance, 0, sizeof(*pInstance));
+    pInstance->head = head;
+    pInstance->head_len = len;
+
+    pInstance->packet_size = OPUS_PACKET_MAX;
+    pInstance->packet = static_cast<uint8_t*>(malloc(pInstance->packet_size));
+    if(pInstance->packet == NULL) {
+        ESP_LOGE(TAG, "Failed allocate packet buffer");
+        return false;
+    }
+
+    // OpusHead: version, channel count, pre-skip, input rate, gain, mapping family
+    const uint8_t *id = pInstance->packet;
+    if(!ogg_next_packet(fp, pInstance) || (pInstance->packet_len < 19) ||
+       (pInstance->packet_len > pInstance->packet_size)) {
+        ESP_LOGE(TAG, "no OpusHead packet");
+        goto fail;
+    }
+    pInstance->channels = id[9];
+    if((id[18] != 0) || (pInstance->channels < 1) || (pInstance->channels > 2)) {
+        ESP_LOGE(TAG, "mapping family %d with %d channels is not supported", id[18], id[9]);
+        goto fail;
+    }
+    pInstance->sample_rate = opus_decode_rate();
+    // the pre-skip counts 48 kHz samples
+    pInstance->skip = (id[10] | (id[11] << 8)) * (pInstance->sample_rate / 1000) / 48;
+
+    // OpusTags, only read past
+    if(!ogg_next_packet(fp, pInstance)) {
+        ESP_LOGE(TAG, "no OpusTags packet");
+        goto fail;
+    }
+
+    {
+        esp_opus_dec_cfg_t cfg = ESP_OPUS_DEC_CONFIG_DEFAULT();
+        cfg.sample_rate = pInstance->sample_rate;
+        cfg.channel = pInstance->channels;
+        if(esp_opus_dec_open(&cfg, sizeof(cfg), &pInstance->decoder) != ESP_AUDIO_ERR_OK) {
+            ESP_LOGE(TAG, "Failed create Opus decoder");
+            goto fail;
+        }
+    }
+
+    pInstance->pcm.size = pInstance->sample_rate / 1000 * OPUS_FRAME_MS_MAX * pInstance->channels * sizeof(int16_t);
+    pInstance->pcm.buf = static_cast<uint8_t*>(malloc(pInstance->pcm.size));
+    if(pInstance->pcm.buf == NULL) {
+        ESP_LOGE(TAG, "Failed allocate pcm buffer");
+        goto fail;
+    }
+
+    LOGI_2("channels=%lu, decoded at %lu Hz, pre-skip %lu frames",
+            (unsigned long)pInstance->channels, (unsigned long)pInstance->sample_rate, (unsigned long)pInstance->skip);
+    return true;
+
+fail:
+    opus_stop(pInstance);
+    return false;
+}
+
+DECODE_STATUS decode_opus(FILE *fp, decode_data *pData, opus_instance *pInstance) {
+    pData->fmt.sample_rate = pInstance->sample_rate;
+    pData->fmt.bits_per_sample = 16;
+    pData->fmt.channels = pInstance->channels;
+
+    if(pcm_queue_pop(&pInstance->pcm, pData)) {
+        return DECODE_STATUS_CONTINUE;
+    }
+
+    if(!ogg_next_packet(fp, pInstance)) {
+        return DECODE_STATUS_DONE;
+    }
+    if(pInstance->packet_len > pInstance->packet_size) {
+        ESP_LOGE(TAG, "packet above %d bytes dropped", (int)pInstance->packet_size);
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+
+    esp_audio_dec_in_raw_t raw = {};
+    raw.buffer = pInstance->packet;
+    raw.len = pInstance->packet_len;
+    esp_audio_dec_out_frame_t frame = {};
+    frame.buffer = pInstance->pcm.buf;
+    frame.len = pInstance->pcm.size;
+    esp_audio_dec_info_t info;
+    esp_audio_err_t err = esp_opus_dec_decode(pInstance->decoder, &raw, &frame, &info);
+    if(err != ESP_AUDIO_ERR_OK) {
+        // a damaged packet is lost on its own, the next one decodes
+        ESP_LOGE(TAG, "status error %d", err);
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+
+    size_t bytes_per_frame = pInstance->channels * sizeof(int16_t);
+    size_t frames = frame.decoded_size / bytes_per_frame;
+    size_t skip = (pInstance->skip < frames) ? pInstance->skip : frames;
+    pInstance->skip -= skip;
+    pInstance->pcm.len = frames * bytes_per_frame;
+    pInstance->pcm.pos = skip * bytes_per_frame;
+
+    return pcm_queue_pop(&pInstance->pcm, pData) ? DECODE_STATUS_CONTINUE : DECODE_STATUS_NO_DATA_CONTINUE;
+}
+
+void opus_stop(opus_instance *pInstance) {
+    if(pInstance->decoder) esp_opus_dec_close(pInstance->decoder);
+    if(pInstance->packet) free(pInstance->packet);
+    if(pInstance->pcm.buf) free(pInstance->pcm.buf);
+    pInstance->decoder = NULL;
+    pInstance->packet = NULL;
+    pInstance->pcm.buf = NULL;
+}
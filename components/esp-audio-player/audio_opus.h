@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdio.h>
+#include "audio_decode_types.h"
+
+typedef struct {
+    /** probed bytes not consumed yet, read before the file */
+    const uint8_t *head;
+    size_t head_len;
+
+    /** lacing values of the current Ogg page */
+    uint8_t segments[255];
+    uint8_t segment_count;
+    uint8_t segment_index;
+
+    /**
+     * Opus packet put together from the lacing values, possibly over several pages,
+     * packet_len is above packet_size for a packet too large to keep
+     */
+    uint8_t *packet;
+    size_t packet_size;
+    size_t packet_len;
+
+    void *decoder;
+    uint32_t sample_rate;
+    uint32_t channels;
+
+    /** decoded frames still to drop at the start of the stream, the OpusHead pre-skip */
+    uint32_t skip;
+
+    pcm_queue pcm;
+} opus_instance;
+
+/**
+ * @param head - the first bytes of the file, read once by the caller
+ */
+bool is_opus(const uint8_t *head, size_t len);
+/**
+ * Read the OpusHead and OpusTags packets, from head and then fp, and open a decoder for
+ * the channel count. head must stay valid while the file decodes.
+ *
+ * @return true if the stream can be decoded, opus_stop() must be called then
+ */
+bool opus_start(FILE *fp, const uint8_t *head, size_t len, opus_instance *pInstance);
+DECODE_STATUS decode_opus(FILE *fp, decode_data *pData, opus_instance *pInstance);
+/**
+ * Close the decoder and free the buffers opus_start() allocated
+ */
+void opus_stop(opus_instance *pInstance);
@@ -38,6 +38,16 @@
 
 #include "audio_wav.h"
 #include "audio_mp3.h"
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+#include "audio_opus.h"
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+#include "audio_aac.h"
+#endif
+#include "audio_kernels.h"
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+#include "audio_resample.h"
+#endif
 
 static const char *TAG = "audio";
 
@@ -64,7 +74,13 @@ typedef enum {
     FILE_TYPE_MP3,
 #endif
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
-    FILE_TYPE_WAV
+    FILE_TYPE_WAV,
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+    FILE_TYPE_OPUS,
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    FILE_TYPE_AAC,
 #endif
 } FILE_TYPE;
 
@@ -94,6 +110,21 @@ typedef struct audio_instance {
     HMP3Decoder mp3_decoder;
     mp3_instance mp3_data;
 #endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+    opus_instance opus_data;            /*< decoder and buffers only while an Opus file plays */
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    aac_instance aac_data;              /*< decoder and buffers only while an AAC file plays */
+#endif
+
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+    audio_resample_t resample;
+#endif
+
+    /* **************** OUTPUT GAIN **************** */
+    audio_gain_t gain;                  /*< unity, the volume is set by the codec and the mixer */
 } audio_instance_t;
 
 static audio_instance_t instance;
@@ -191,9 +222,10 @@ static void audio_instance_init(audio_instance_t &i) {
     i.s_audio_cb = NULL;
     i.audio_cb_usrt_ctx = NULL;
     i.state = AUDIO_PLAYER_STATE_IDLE;
+    audio_gain_set(&i.gain, AUDIO_GAIN_UNITY, 0);
 }
 
-static esp_err_t mono_to_stereo(uint32_t output_bits_per_sample, decode_data &adata)
+static esp_err_t mono_to_stereo(uint32_t output_bits_per_sample, decode_data &adata, audio_gain_t *gain)
 {
     size_t data = adata.frame_count * (output_bits_per_sample / BITS_PER_BYTE);
     data *= 2;
@@ -204,6 +236,13 @@ static esp_err_t mono_to_stereo(uint32_t output_bits_per_sample, decode_data &ad
         return ESP_ERR_NO_MEM;
     }
 
+    // 16 bit audio is duplicated in the same pass as the gain is applied
+    if(output_bits_per_sample == 16) {
+        audio_kernel_output(reinterpret_cast<int16_t*>(adata.samples), adata.frame_count, 1, gain);
+        adata.fmt.channels = 2;
+        return ESP_OK;
+    }
+
     size_t new_sample_count = adata.frame_count * 2;
 
     // convert from back to front to allow conversion in-place
@@ -234,27 +273,51 @@ static esp_err_t mono_to_stereo(uint32_t output_bits_per_sample, decode_data &ad
     return ESP_OK;
 }
 
+/**
+ * Formats recognized but not played, because the decoder is disabled or refused
+ * the stream, named in the error so that a source returning them is spotted at once
+ */
+static const char *unsupported_format(const uint8_t *head, size_t len)
+{
+    if((len >= 4) && (memcmp(head, "OggS", 4) == 0)) {
+        // first page carries the Opus identification header, RFC 7845
+        return ((len >= 36) && (memcmp(head + 28, "OpusHead", 8) == 0)) ? "Ogg Opus" : "Ogg";
+    }
+    // ADTS sync word with layer 0, MPEG audio frames have a non zero layer
+    if((len >= 2) && (head[0] == 0xFF) && ((head[1] & 0xF6) == 0xF0)) {
+        return "ADTS AAC";
+    }
+    return NULL;
+}
+
 static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
 {
     LOGI_1("start to decode");
 
+    // Probe the type on the first bytes, read once, the decoders start from them.
+    // The file is never rewound, so it can be a stream that cannot seek.
+    uint8_t head[AUDIO_PROBE_BYTES];
+    size_t head_len = fread(head, 1, sizeof(head), fp);
+
     format i2s_format;
     memset(&i2s_format, 0, sizeof(i2s_format));
 
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+    bool resampling = false;            /*< the last block went through the resampler */
+#endif
+
     esp_err_t ret = ESP_OK;
     audio_player_event_t audio_event = { .type = AUDIO_PLAYER_REQUEST_NONE, .fp = NULL };
 
     FILE_TYPE file_type = FILE_TYPE_UNKNOWN;
 
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
-    if(is_mp3(fp)) {
+    if(is_mp3(head, head_len)) {
         file_type = FILE_TYPE_MP3;
         LOGI_1("file is mp3");
 
         // initialize mp3_instance
-        i->mp3_data.bytes_in_data_buf = 0;
-        i->mp3_data.read_ptr = i->mp3_data.data_buf;
-        i->mp3_data.eof_reached = false;
+        mp3_start(head, head_len, &i->mp3_data);
     }
 #endif
 
@@ -263,20 +326,51 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
     // cppcheck-suppress knownConditionTrueFalse
     if(file_type == FILE_TYPE_UNKNOWN)
     {
-        if(is_wav(fp, &i->wav_data)) {
+        if(is_wav(head, head_len) && wav_start(fp, head, head_len, &i->wav_data)) {
             file_type = FILE_TYPE_WAV;
             LOGI_1("file is wav");
         }
     }
 #endif
 
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+    // cppcheck-suppress knownConditionTrueFalse
+    if(file_type == FILE_TYPE_UNKNOWN)
+    {
+        if(is_opus(head, head_len) && opus_start(fp, head, head_len, &i->opus_data)) {
+            file_type = FILE_TYPE_OPUS;
+            LOGI_1("file is ogg opus");
+        }
+    }
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    // cppcheck-suppress knownConditionTrueFalse
+    if(file_type == FILE_TYPE_UNKNOWN)
+    {
+        if(is_aac(head, head_len) && aac_start(head, head_len, &i->aac_data)) {
+            file_type = FILE_TYPE_AAC;
+            LOGI_1("file is adts aac");
+        }
+    }
+#endif
+
     // cppcheck-suppress knownConditionTrueFalse
     if(file_type == FILE_TYPE_UNKNOWN) {
-        ESP_LOGE(TAG, "unknown file type, cleaning up");
+        const char *unsupported = unsupported_format(head, head_len);
+        if(unsupported) {
+            ESP_LOGE(TAG, "%s is not supported, cleaning up", unsupported);
+        } else {
+            ESP_LOGE(TAG, "unknown file type, cleaning up");
+        }
         dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE);
         goto clean_up;
     }
 
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+    audio_resample_reset(&i->resample);
+#endif
+
     do {
         /* Process audio event sent from other task */
         if (pdPASS == xQueuePeek(i->event_queue, &audio_event, 0)) {
@@ -339,6 +433,16 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
             case FILE_TYPE_WAV:
                 decode_status = decode_wav(fp, &i->output, &i->wav_data);
                 break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+            case FILE_TYPE_OPUS:
+                decode_status = decode_opus(fp, &i->output, &i->opus_data);
+                break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+            case FILE_TYPE_AAC:
+                decode_status = decode_aac(fp, &i->output, &i->aac_data);
+                break;
 #endif
             case FILE_TYPE_UNKNOWN:
                 ESP_LOGE(TAG, "unexpected unknown file type when decoding");
@@ -348,21 +452,40 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
         // break out and exit if we aren't supposed to continue decoding
         if(decode_status == DECODE_STATUS_CONTINUE)
         {
+            format output_format = i->output.fmt;
+            bool resample = false;
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+            // convert to the fixed output rate, the resampler also does mono -> stereo
+            if((i->output.fmt.bits_per_sample == 16) &&
+               (i->output.fmt.sample_rate != CONFIG_AUDIO_PLAYER_RESAMPLE_RATE)) {
+                resample = (audio_resample_config(&i->resample, i->output.fmt.sample_rate, i->output.fmt.channels,
+                                                  CONFIG_AUDIO_PLAYER_RESAMPLE_RATE) == ESP_OK);
+            }
+            if(resample) {
+                output_format.sample_rate = CONFIG_AUDIO_PLAYER_RESAMPLE_RATE;
+                output_format.channels = 2;
+            }
+            resampling = resample;
+#endif
+
             // if mono, convert to stereo as es8311 requires stereo input
             // even though it is mono output
-            if(i->output.fmt.channels ==  1) {
+            if(!resample && i->output.fmt.channels ==  1) {
                 LOGI_3("c == 1, mono -> stereo");
-                ret = mono_to_stereo(i->output.fmt.bits_per_sample, i->output);
+                ret = mono_to_stereo(i->output.fmt.bits_per_sample, i->output, &i->gain);
                 if(ret != ESP_OK) {
                     goto clean_up;
                 }
+                output_format = i->output.fmt;
+            } else if(!resample && (i->output.fmt.channels == 2) && (i->output.fmt.bits_per_sample == 16)) {
+                audio_kernel_output(reinterpret_cast<int16_t*>(i->output.samples), i->output.frame_count, 2, &i->gain);
             }
 
             /* Configure I2S clock if the output format changed */
-            if ((i2s_format.sample_rate != i->output.fmt.sample_rate) ||
-                    (i2s_format.channels != i->output.fmt.channels) ||
-                    (i2s_format.bits_per_sample != i->output.fmt.bits_per_sample)) {
-                i2s_format = i->output.fmt;
+            if ((i2s_format.sample_rate != output_format.sample_rate) ||
+                    (i2s_format.channels != output_format.channels) ||
+                    (i2s_format.bits_per_sample != output_format.bits_per_sample)) {
+                i2s_format = output_format;
                 LOGI_1("format change: sr=%d, bit=%d, ch=%d",
                         i2s_format.sample_rate,
                         i2s_format.bits_per_sample,
@@ -380,6 +503,14 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
              * audio decoding to occur while the previous set of samples is finishing playback, in order
              * to ensure playback without interruption.
              */
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+            if(resample) {
+                ret = audio_resample_write(&i->resample, reinterpret_cast<int16_t*>(i->output.samples),
+                                           i->output.frame_count, &i->gain, i->config.write_fn);
+                ESP_GOTO_ON_ERROR(ret, clean_up, TAG, "resample write");
+                continue;
+            }
+#endif
             size_t i2s_bytes_written = 0;
             size_t bytes_to_write = i->output.frame_count * i->output.fmt.channels * (i2s_format.bits_per_sample / 8);
             LOGI_2("c %d, bps %d, bytes %d, frame_count %d",
@@ -397,11 +528,27 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
             LOGI_2("no data");
         } else { // DECODE_STATUS_DONE || DECODE_STATUS_ERROR
             LOGI_1("breaking out of playback");
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+            if(resampling) {
+                // the filter still holds the end of the file
+                ret = audio_resample_drain(&i->resample, &i->gain, i->config.write_fn);
+            }
+#endif
             break;
         }
     } while (true);
 
 clean_up:
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_OPUS)
+    if(file_type == FILE_TYPE_OPUS) {
+        opus_stop(&i->opus_data);
+    }
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    if(file_type == FILE_TYPE_AAC) {
+        aac_stop(&i->aac_data);
+    }
+#endif
     return ret;
 }
 
@@ -522,6 +669,9 @@ static void cleanup_memory(audio_instance_t &i)
     if(i.mp3_data.data_buf) free(i.mp3_data.data_buf);
 #endif
     if(i.output.samples) free(i.output.samples);
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+    audio_resample_free(&i.resample);
+#endif
 
     vQueueDelete(i.event_queue);
 }
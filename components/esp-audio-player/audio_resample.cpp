@@ -0,0 +1,267 @@
+#include <math.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "audio_log.h"
+#include "audio_resample.h"
+
+static const char *TAG = "resample";
+
+/** -6 dB point of the low pass relative to the lower Nyquist frequency */
+#define RESAMPLE_CUTOFF     0.9f
+
+/** Kaiser window beta, about 60 dB stop band attenuation */
+#define RESAMPLE_BETA       6.0f
+
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_SIMD
+extern "C" int32_t audio_resample_dot_s16_aes3(const int16_t *x, const int16_t *c, uint32_t blocks);
+#endif
+
+static inline int16_t saturate16(int32_t v)
+{
+    return (v > INT16_MAX) ? INT16_MAX : ((v < INT16_MIN) ? INT16_MIN : v);
+}
+
+int16_t audio_resample_dot_ansi(const int16_t *x, const int16_t *c, uint32_t taps)
+{
+    int32_t acc = 0;
+    for(uint32_t j = 0; j < taps; j += 4) {
+        acc += x[j] * c[j];
+        acc += x[j + 1] * c[j + 1];
+        acc += x[j + 2] * c[j + 2];
+        acc += x[j + 3] * c[j + 3];
+    }
+    return saturate16(acc >> 15);
+}
+
+int16_t audio_resample_dot(const int16_t *x, const int16_t *c, uint32_t taps)
+{
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_SIMD
+    return saturate16(audio_resample_dot_s16_aes3(x, c, taps / 8));
+#else
+    return audio_resample_dot_ansi(x, c, taps);
+#endif
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while(b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static float bessel_i0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for(int k = 1; k < 32 && term > sum * 1e-7f; k++) {
+        float f = x / (2.0f * k);
+        term *= f * f;
+        sum += term;
+    }
+    return sum;
+}
+
+static void *resample_alloc(size_t size)
+{
+    // the dot products read coefficients and history for every output sample, prefer internal RAM
+    void *p = heap_caps_aligned_alloc(16, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if(!p) {
+        p = heap_caps_aligned_alloc(16, size, MALLOC_CAP_8BIT);
+    }
+    return p;
+}
+
+/**
+ * Kaiser windowed sinc of taps * phases + 1 points at phases * in_rate, split into
+ * phases + 1 phases. Every phase is normalized to a gain of 1.0.
+ */
+static void resample_design(audio_resample_t *rs)
+{
+    uint32_t n = rs->taps * rs->phases;
+    float low = (rs->in_rate < rs->out_rate) ? rs->in_rate : rs->out_rate;
+    float fc = 0.5f * RESAMPLE_CUTOFF * low / rs->in_rate / rs->phases;
+    float i0_beta = bessel_i0(RESAMPLE_BETA);
+
+    for(uint32_t q = 0; q <= rs->phases; q++) {
+        int16_t *c = rs->coef + q * rs->taps;
+        float h[rs->taps];
+        float sum = 0.0f;
+        for(uint32_t j = 0; j < rs->taps; j++) {
+            // c[q][j] weighs x[pos + j], see audio_resample.h
+            uint32_t k = q + (rs->taps - 1 - j) * rs->phases;
+            float t = (float)k - n / 2.0f;
+            float sinc = (t == 0.0f) ? 1.0f : sinf((float)M_PI * 2.0f * fc * t) / ((float)M_PI * 2.0f * fc * t);
+            float r = 2.0f * t / n;
+            float w = bessel_i0(RESAMPLE_BETA * sqrtf(fmaxf(0.0f, 1.0f - r * r))) / i0_beta;
+            h[j] = sinc * w;
+            sum += h[j];
+        }
+
+        int32_t total = 0;
+        uint32_t peak = 0;
+        for(uint32_t j = 0; j < rs->taps; j++) {
+            c[j] = saturate16(lrintf(h[j] / sum * 32768.0f));
+            total += c[j];
+            if(c[j] > c[peak]) {
+                peak = j;
+            }
+        }
+        // put the rounding error on the largest tap so a constant passes unchanged
+        c[peak] = saturate16(c[peak] + 32768 - total);
+    }
+}
+
+esp_err_t audio_resample_config(audio_resample_t *rs, int in_rate, uint32_t channels, int out_rate)
+{
+    if((in_rate == rs->in_rate) && (out_rate == rs->out_rate) && (channels == rs->channels)) {
+        return ESP_OK;
+    }
+    if((channels < 1) || (channels > 2) || (in_rate <= 0) || (out_rate <= 0)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    audio_resample_free(rs);
+
+    uint32_t g = gcd(in_rate, out_rate);
+    rs->up = out_rate / g;
+    rs->down = in_rate / g;
+    rs->phases = (rs->up <= AUDIO_RESAMPLE_PHASES) ? rs->up : AUDIO_RESAMPLE_PHASES;
+    // keep the same number of taps at the lower of the two rates
+    rs->taps = AUDIO_RESAMPLE_TAPS;
+    if(in_rate > out_rate) {
+        rs->taps = (AUDIO_RESAMPLE_TAPS * in_rate + out_rate - 1) / out_rate;
+    }
+    rs->taps = (rs->taps + 7) & ~7;
+    rs->hist_len = (rs->taps + AUDIO_RESAMPLE_IN_FRAMES + 7) & ~7;
+
+    rs->coef = static_cast<int16_t*>(resample_alloc((rs->phases + 1) * rs->taps * sizeof(int16_t)));
+    rs->hist = static_cast<int16_t*>(resample_alloc(channels * AUDIO_RESAMPLE_COPIES * rs->hist_len * sizeof(int16_t)));
+    rs->out = static_cast<int16_t*>(resample_alloc(AUDIO_RESAMPLE_OUT_FRAMES * 2 * sizeof(int16_t)));
+    if(!rs->coef || !rs->hist || !rs->out) {
+        ESP_LOGE(TAG, "no memory for %d -> %d", in_rate, out_rate);
+        audio_resample_free(rs);
+        return ESP_ERR_NO_MEM;
+    }
+
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->channels = channels;
+    resample_design(rs);
+    audio_resample_reset(rs);
+
+    LOGI_1("%d -> %d Hz, L %u, M %u, %u phases of %u taps", in_rate, out_rate,
+           (unsigned)rs->up, (unsigned)rs->down, (unsigned)rs->phases, (unsigned)rs->taps);
+    return ESP_OK;
+}
+
+void audio_resample_reset(audio_resample_t *rs)
+{
+    if(!rs->hist) {
+        return;
+    }
+    memset(rs->hist, 0, rs->channels * AUDIO_RESAMPLE_COPIES * rs->hist_len * sizeof(int16_t));
+    // half a filter of silence in front, the first output frame is centered on the first input frame
+    rs->fill = rs->taps / 2 - 1;
+    rs->pos = 0;
+    rs->phase = 0;
+    rs->out_frames = 0;
+}
+
+void audio_resample_free(audio_resample_t *rs)
+{
+    if(rs->coef) heap_caps_free(rs->coef);
+    if(rs->hist) heap_caps_free(rs->hist);
+    if(rs->out) heap_caps_free(rs->out);
+    memset(rs, 0, sizeof(*rs));
+}
+
+static inline int16_t *resample_copy(audio_resample_t *rs, uint32_t ch, uint32_t s)
+{
+    return rs->hist + (ch * AUDIO_RESAMPLE_COPIES + s) * rs->hist_len;
+}
+
+// once a write failed the rest of the call's output is dropped, the state still advances
+static void resample_flush(audio_resample_t *rs, audio_gain_t *gain, audio_player_write_fn write_fn, esp_err_t *ret)
+{
+    if(!rs->out_frames || *ret != ESP_OK) {
+        rs->out_frames = 0;
+        return;
+    }
+    audio_kernel_output(rs->out, rs->out_frames, 2, gain);
+    size_t bytes = rs->out_frames * 2 * sizeof(int16_t);
+    size_t written = 0;
+    rs->out_frames = 0;
+    *ret = write_fn(rs->out, bytes, &written, portMAX_DELAY);
+}
+
+esp_err_t audio_resample_write(audio_resample_t *rs, const int16_t *samples, size_t frames,
+                               audio_gain_t *gain, audio_player_write_fn write_fn)
+{
+    esp_err_t ret = ESP_OK;
+
+    while(frames) {
+        // append to every copy, copy s holds x[n + s] at index n
+        size_t n = rs->hist_len - rs->fill;
+        n = (frames < n) ? frames : n;
+        for(uint32_t ch = 0; ch < rs->channels; ch++) {
+            for(uint32_t s = 0; s < AUDIO_RESAMPLE_COPIES; s++) {
+                int16_t *dst = resample_copy(rs, ch, s);
+                const int16_t *src = samples + ch;
+                for(size_t f = (rs->fill >= s) ? 0 : s - rs->fill; f < n; f++) {
+                    dst[rs->fill + f - s] = src[f * rs->channels];
+                }
+            }
+        }
+        rs->fill += n;
+        samples += n * rs->channels;
+        frames -= n;
+
+        while(rs->pos + rs->taps <= rs->fill) {
+            uint32_t q = (rs->phases == rs->up) ? rs->phase : (rs->phase * rs->phases + rs->up / 2) / rs->up;
+            const int16_t *c = rs->coef + q * rs->taps;
+            uint32_t s = rs->pos & (AUDIO_RESAMPLE_COPIES - 1);
+            size_t base = rs->pos - s;
+
+            int16_t *o = rs->out + rs->out_frames * 2;
+            o[0] = audio_resample_dot(resample_copy(rs, 0, s) + base, c, rs->taps);
+            o[1] = (rs->channels == 2) ? audio_resample_dot(resample_copy(rs, 1, s) + base, c, rs->taps) : o[0];
+            if(++rs->out_frames == AUDIO_RESAMPLE_OUT_FRAMES) {
+                resample_flush(rs, gain, write_fn, &ret);
+            }
+
+            rs->phase += rs->down;
+            rs->pos += rs->phase / rs->up;
+            rs->phase %= rs->up;
+        }
+
+        // drop what no later window needs
+        for(uint32_t ch = 0; ch < rs->channels; ch++) {
+            for(uint32_t s = 0; s < AUDIO_RESAMPLE_COPIES; s++) {
+                if(rs->fill > rs->pos + s) {
+                    int16_t *copy = resample_copy(rs, ch, s);
+                    memmove(copy, copy + rs->pos, (rs->fill - rs->pos - s) * sizeof(int16_t));
+                }
+            }
+        }
+        rs->fill -= rs->pos;
+        rs->pos = 0;
+    }
+
+    resample_flush(rs, gain, write_fn, &ret);
+    return ret;
+}
+
+esp_err_t audio_resample_drain(audio_resample_t *rs, audio_gain_t *gain, audio_player_write_fn write_fn)
+{
+    if(!rs->hist) {
+        return ESP_OK;
+    }
+    // the last output frame is centered on the last input frame once taps / 2 more follow it
+    int16_t silence[rs->taps / 2 * rs->channels];
+    memset(silence, 0, sizeof(silence));
+    esp_err_t ret = audio_resample_write(rs, silence, rs->taps / 2, gain, write_fn);
+    audio_resample_reset(rs);
+    return ret;
+}
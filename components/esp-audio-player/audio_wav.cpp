@@ -5,30 +5,44 @@
 static const char *TAG = "wav";
 
 /**
- * @param fp
- * @param pInstance - Values can be considered valid if true is returned
- * @return true if file is a wav file
+ * Read from the probed bytes first, then from the file, so a stream that
+ * cannot seek is read exactly once
  */
-bool is_wav(FILE *fp, wav_instance *pInstance) {
-    fseek(fp, 0, SEEK_SET);
+static size_t wav_read(FILE *fp, wav_instance *pInstance, void *dst, size_t len) {
+    size_t from_head = (len < pInstance->head_len) ? len : pInstance->head_len;
+    memcpy(dst, pInstance->head, from_head);
+    pInstance->head += from_head;
+    pInstance->head_len -= from_head;
 
-    size_t bytes_read = fread(&pInstance->header, 1, sizeof(wav_header_t), fp);
-    if(bytes_read != sizeof(wav_header_t)) {
-        return false;
+    size_t bytes_read = from_head;
+    if(bytes_read < len) {
+        bytes_read += fread(static_cast<uint8_t*>(dst) + from_head, 1, len - from_head, fp);
     }
+    return bytes_read;
+}
 
-    wav_header_t *wav_head = &pInstance->header;
-    if((NULL == strstr(reinterpret_cast<char *>(wav_head->ChunkID), "RIFF")) ||
-        (NULL == strstr(reinterpret_cast<char*>(wav_head->Format), "WAVE"))
-      )
-    {
+/**
+ * @return true if file is a wav file
+ */
+bool is_wav(const uint8_t *head, size_t len) {
+    return (len >= sizeof(wav_header_t)) &&
+           (memcmp(head, "RIFF", 4) == 0) &&
+           (memcmp(head + 8, "WAVE", 4) == 0);
+}
+
+bool wav_start(FILE *fp, const uint8_t *head, size_t len, wav_instance *pInstance) {
+    pInstance->head = head;
+    pInstance->head_len = len;
+
+    size_t bytes_read = wav_read(fp, pInstance, &pInstance->header, sizeof(wav_header_t));
+    if(bytes_read != sizeof(wav_header_t)) {
         return false;
     }
 
     // decode chunks until we find the 'data' one
     wav_subchunk_header_t subchunk;
     while(true) {
-        bytes_read = fread(&subchunk, 1, sizeof(wav_subchunk_header_t), fp);
+        bytes_read = wav_read(fp, pInstance, &subchunk, sizeof(wav_subchunk_header_t));
         if(bytes_read != sizeof(wav_subchunk_header_t)) {
             return false;
         }
@@ -36,16 +50,24 @@ bool is_wav(FILE *fp, wav_instance *pInstance) {
         if(memcmp(subchunk.SubchunkID, "data", 4) == 0)
         {
             break;
-        } else {
-            // advance beyond this subchunk, it could be a 'LIST' chunk with file info or some other unhandled subchunk
-            fseek(fp, subchunk.SubchunkSize, SEEK_CUR);
+        }
+
+        // read past this subchunk, it could be a 'LIST' chunk with file info or some other unhandled subchunk
+        uint8_t skip[32];
+        size_t left = subchunk.SubchunkSize;
+        while(left > 0) {
+            size_t chunk = (left < sizeof(skip)) ? left : sizeof(skip);
+            if(wav_read(fp, pInstance, skip, chunk) != chunk) {
+                return false;
+            }
+            left -= chunk;
         }
     }
 
     LOGI_2("sample_rate=%d, channels=%d, bps=%d",
-            wav_head->SampleRate,
-            wav_head->NumChannels,
-            wav_head->BitsPerSample);
+            pInstance->header.SampleRate,
+            pInstance->header.NumChannels,
+            pInstance->header.BitsPerSample);
 
     return true;
 }
@@ -60,7 +82,7 @@ DECODE_STATUS decode_wav(FILE *fp, decode_data *pData, wav_instance *pInstance)
     size_t frames_to_read = pData->samples_capacity / bytes_per_frame;
     size_t bytes_to_read = frames_to_read * bytes_per_frame;
 
-    size_t bytes_read = fread(pData->samples, 1, bytes_to_read, fp);
+    size_t bytes_read = wav_read(fp, pInstance, pData->samples, bytes_to_read);
 
     pData->fmt.channels = pInstance->header.NumChannels;
     pData->fmt.bits_per_sample = pInstance->header.BitsPerSample;
@@ -28,7 +28,21 @@ typedef struct {
 
 typedef struct {
     wav_header_t header;
+
+    /** probed bytes not consumed yet, read before the file */
+    const uint8_t *head;
+    size_t head_len;
 } wav_instance;
 
-bool is_wav(FILE *fp, wav_instance *pInstance);
+/**
+ * @param head - the first bytes of the file, read once by the caller
+ */
+bool is_wav(const uint8_t *head, size_t len);
+/**
+ * Parse the header, from head and then fp, up to the start of the 'data' payload.
+ * head must stay valid while the file decodes.
+ *
+ * @param pInstance - Values can be considered valid if true is returned
+ */
+bool wav_start(FILE *fp, const uint8_t *head, size_t len, wav_instance *pInstance);
 DECODE_STATUS decode_wav(FILE *fp, decode_data *pData, wav_instance *pInstance);
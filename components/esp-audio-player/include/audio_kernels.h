@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Output stage kernels of the player
+ *
+ * Decoded 16 bit audio is brought to the stereo output format in one pass over the buffer:
+ * mono samples are duplicated, the gain is applied, ramping linearly towards a target,
+ * and the result is clipped to 16 bit.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** 0 dB in Q15 */
+#define AUDIO_GAIN_UNITY        (1 << 15)
+
+typedef struct {
+    int32_t pos;        /*< gain applied to the next frame, Q15 with 15 more fraction bits */
+    int32_t target;     /*< Q15 gain the ramp ends at, at most AUDIO_GAIN_UNITY */
+    int32_t step;       /*< change of pos per frame, 0 when not ramping */
+} audio_gain_t;
+
+/**
+ * Move the gain to target, a Q15 value, over ramp_frames frames, at once for 0
+ */
+void audio_gain_set(audio_gain_t *gain, int32_t target, uint32_t ramp_frames);
+
+/**
+ * Convert frames of mono or stereo samples in place to stereo and apply the gain
+ *
+ * The buffer must hold frames * 2 samples for mono input.
+ */
+void audio_kernel_output(int16_t *samples, size_t frames, uint32_t channels, audio_gain_t *gain);
+
+/**
+ * samples = clip(samples * gain >> 15), the SIMD version when enabled, otherwise the ANSI one
+ */
+void audio_kernel_gain(int16_t *samples, size_t count, int16_t gain);
+void audio_kernel_gain_ansi(int16_t *samples, size_t count, int16_t gain);
+
+#ifdef __cplusplus
+}
+#endif
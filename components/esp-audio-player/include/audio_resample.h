@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_player.h"
+#include "audio_kernels.h"
+
+/**
+ * Polyphase sample rate converter from the decoded rate to a fixed output rate
+ *
+ * The ratio out/in is reduced to L/M. A Kaiser windowed sinc low pass is designed at
+ * P * in_rate and split into P + 1 phases of 'taps' Q15 coefficients, with P = L when L is
+ * small enough, so the phases are exact, otherwise P = AUDIO_RESAMPLE_PHASES and each output
+ * frame uses the nearest phase. Every output sample is one dot product of a phase with the
+ * last 'taps' input samples of its channel.
+ *
+ * Input is 16 bit mono or stereo, output is always 16 bit stereo, so the mono to stereo
+ * step is done on the way.
+ */
+
+/** output frames collected before write_fn is called */
+#define AUDIO_RESAMPLE_OUT_FRAMES   256
+
+/** input frames buffered per channel on top of the filter history */
+#define AUDIO_RESAMPLE_IN_FRAMES    128
+
+/** most phases in the table, ratios with a larger L use the nearest one */
+#define AUDIO_RESAMPLE_PHASES       256
+
+/** taps per phase at or above the output rate, more when the input rate is higher */
+#define AUDIO_RESAMPLE_TAPS         24
+
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_SIMD
+/** shifted copies of the history, so every window starts on a 16 byte boundary in one of them */
+#define AUDIO_RESAMPLE_COPIES       8
+#else
+#define AUDIO_RESAMPLE_COPIES       1
+#endif
+
+typedef struct {
+    int in_rate;
+    int out_rate;
+    uint32_t channels;
+
+    uint32_t up;            /*< L */
+    uint32_t down;          /*< M */
+    uint32_t phases;        /*< P */
+    uint32_t taps;          /*< coefficients per phase, multiple of 8 */
+    int16_t *coef;          /*< (phases + 1) * taps, phase q at coef + q * taps */
+
+    uint32_t phase;         /*< position of the next output frame between input frames, 0..L-1 */
+    size_t pos;             /*< first history sample of the next output frame */
+    size_t fill;            /*< history samples per channel */
+    size_t hist_len;        /*< capacity of one history copy */
+    int16_t *hist;          /*< [channel][copy][hist_len] */
+
+    int16_t *out;           /*< AUDIO_RESAMPLE_OUT_FRAMES stereo frames */
+    size_t out_frames;
+} audio_resample_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Set up the conversion of in_rate to out_rate, the filter is only rebuilt when the
+ * rates or the channel count change.
+ *
+ * @return ESP_ERR_NOT_SUPPORTED for more than two channels
+ */
+esp_err_t audio_resample_config(audio_resample_t *rs, int in_rate, uint32_t channels, int out_rate);
+
+/**
+ * Forget the history, called when a new file starts.
+ */
+void audio_resample_reset(audio_resample_t *rs);
+
+/**
+ * Convert frames of interleaved samples and pass the output to write_fn in blocks,
+ * with the gain applied. Returns the first error of write_fn, the output after it is dropped.
+ */
+esp_err_t audio_resample_write(audio_resample_t *rs, const int16_t *samples, size_t frames,
+                               audio_gain_t *gain, audio_player_write_fn write_fn);
+
+/**
+ * Push the last input frames out through the filter, called when a file ends. Feeds taps / 2
+ * frames of silence, the history is reset afterwards.
+ */
+esp_err_t audio_resample_drain(audio_resample_t *rs, audio_gain_t *gain, audio_player_write_fn write_fn);
+
+void audio_resample_free(audio_resample_t *rs);
+
+/**
+ * Dot product of taps Q15 coefficients with taps samples, both 16 byte aligned, taps a
+ * multiple of 8, saturated to 16 bit. The SIMD version when enabled, otherwise the ANSI one.
+ */
+int16_t audio_resample_dot(const int16_t *x, const int16_t *c, uint32_t taps);
+int16_t audio_resample_dot_ansi(const int16_t *x, const int16_t *c, uint32_t taps);
+
+#ifdef __cplusplus
+}
+#endif
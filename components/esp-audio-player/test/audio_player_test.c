@@ -0,0 +1,678 @@
+// Copyright 2020 Espressif Systems (Shanghai) Co. Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "unity.h"
+#include "audio_player.h"
+#include "driver/gpio.h"
+#include "test_utils.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <string.h>
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "mp3dec.h"
+#include "sdkconfig.h"
+#include "audio_kernels.h"
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+#include "audio_resample.h"
+#endif
+
+static const char *TAG = "AUDIO PLAYER TEST";
+
+#define CONFIG_BSP_I2S_NUM 1
+
+/* Audio */
+#define BSP_I2S_SCLK          (GPIO_NUM_17)
+#define BSP_I2S_MCLK          (GPIO_NUM_2)
+#define BSP_I2S_LCLK          (GPIO_NUM_47)
+#define BSP_I2S_DOUT          (GPIO_NUM_15) // To Codec ES8311
+#define BSP_I2S_DSIN          (GPIO_NUM_16) // From ADC ES7210
+#define BSP_POWER_AMP_IO      (GPIO_NUM_46)
+#define BSP_MUTE_STATUS       (GPIO_NUM_1)
+
+/**
+ * @brief ESP-BOX I2S pinout
+ *
+ * Can be used for i2s_std_gpio_config_t and/or i2s_std_config_t initialization
+ */
+#define BSP_I2S_GPIO_CFG       \
+    {                          \
+        .mclk = BSP_I2S_MCLK,  \
+        .bclk = BSP_I2S_SCLK,  \
+        .ws = BSP_I2S_LCLK,    \
+        .dout = BSP_I2S_DOUT,  \
+        .din = BSP_I2S_DSIN,   \
+        .invert_flags = {      \
+            .mclk_inv = false, \
+            .bclk_inv = false, \
+            .ws_inv = false,   \
+        },                     \
+    }
+
+/**
+ * @brief Mono Duplex I2S configuration structure
+ *
+ * This configuration is used by default in bsp_audio_init()
+ */
+#define BSP_I2S_DUPLEX_MONO_CFG(_sample_rate)                                                         \
+    {                                                                                                 \
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(_sample_rate),                                          \
+        .slot_cfg = I2S_STD_PHILIP_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO), \
+        .gpio_cfg = BSP_I2S_GPIO_CFG,                                                                 \
+    }
+
+static i2s_chan_handle_t i2s_tx_chan;
+static i2s_chan_handle_t i2s_rx_chan;
+
+static esp_err_t bsp_i2s_write(void * audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+    ret = i2s_channel_write(i2s_tx_chan, (char *)audio_buffer, len, bytes_written, timeout_ms);
+    return ret;
+}
+
+static esp_err_t bsp_i2s_reconfig_clk(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    esp_err_t ret = ESP_OK;
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(rate),
+        .slot_cfg = I2S_STD_PHILIP_SLOT_DEFAULT_CONFIG((i2s_data_bit_width_t)bits_cfg, (i2s_slot_mode_t)ch),
+        .gpio_cfg = BSP_I2S_GPIO_CFG,
+    };
+
+    ret |= i2s_channel_disable(i2s_tx_chan);
+    ret |= i2s_channel_reconfig_std_clock(i2s_tx_chan, &std_cfg.clk_cfg);
+    ret |= i2s_channel_reconfig_std_slot(i2s_tx_chan, &std_cfg.slot_cfg);
+    ret |= i2s_channel_enable(i2s_tx_chan);
+    return ret;
+}
+
+static esp_err_t audio_mute_function(AUDIO_PLAYER_MUTE_SETTING setting) {
+    ESP_LOGI(TAG, "mute setting %d", setting);
+    return ESP_OK;
+}
+
+TEST_CASE("audio player can be newed and deleted", "[audio player]")
+{
+    audio_player_config_t config = { .mute_fn = audio_mute_function,
+                                     .write_fn = bsp_i2s_write,
+                                     .clk_set_fn = bsp_i2s_reconfig_clk,
+                                     .priority = 0,
+                                     .coreID = 0 };
+    esp_err_t ret = audio_player_new(config);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    ret = audio_player_delete();
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    audio_player_state_t state = audio_player_get_state();
+    TEST_ASSERT_EQUAL(state, AUDIO_PLAYER_STATE_SHUTDOWN);
+}
+
+static esp_err_t bsp_audio_init(const i2s_std_config_t *i2s_config, i2s_chan_handle_t *tx_channel, i2s_chan_handle_t *rx_channel)
+{
+    /* Setup I2S peripheral */
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(CONFIG_BSP_I2S_NUM, I2S_ROLE_MASTER);
+    chan_cfg.auto_clear = true; // Auto clear the legacy data in the DMA buffer
+    ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, tx_channel, rx_channel));
+
+    /* Setup I2S channels */
+    const i2s_std_config_t std_cfg_default = BSP_I2S_DUPLEX_MONO_CFG(22050);
+    const i2s_std_config_t *p_i2s_cfg = &std_cfg_default;
+    if (i2s_config != NULL) {
+        p_i2s_cfg = i2s_config;
+    }
+
+    if (tx_channel != NULL) {
+        ESP_ERROR_CHECK(i2s_channel_init_std_mode(*tx_channel, p_i2s_cfg));
+        ESP_ERROR_CHECK(i2s_channel_enable(*tx_channel));
+    }
+    if (rx_channel != NULL) {
+        ESP_ERROR_CHECK(i2s_channel_init_std_mode(*rx_channel, p_i2s_cfg));
+        ESP_ERROR_CHECK(i2s_channel_enable(*rx_channel));
+    }
+
+    /* Setup power amplifier pin */
+    const gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT,
+        .pin_bit_mask = BIT64(BSP_POWER_AMP_IO),
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLDOWN_DISABLE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+
+    return ESP_OK;
+}
+
+static audio_player_callback_event_t expected_event;
+static QueueHandle_t event_queue;
+
+static void audio_player_callback(audio_player_cb_ctx_t *ctx)
+{
+    TEST_ASSERT_EQUAL(ctx->audio_event, expected_event);
+
+    // wake up the test so it can continue to the next step
+    TEST_ASSERT_EQUAL(xQueueSend(event_queue, &(ctx->audio_event), 0), pdPASS);
+}
+
+TEST_CASE("audio player states and callbacks are correct", "[audio player]")
+{
+    audio_player_callback_event_t event;
+
+    /* Configure I2S peripheral and Power Amplifier */
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(44100),
+        .slot_cfg = I2S_STD_PHILIP_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
+        .gpio_cfg = BSP_I2S_GPIO_CFG,
+    };
+    esp_err_t ret = bsp_audio_init(&std_cfg, &i2s_tx_chan, &i2s_rx_chan);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    audio_player_config_t config = { .mute_fn = audio_mute_function,
+                                     .write_fn = bsp_i2s_write,
+                                     .clk_set_fn = bsp_i2s_reconfig_clk,
+                                     .priority = 0,
+                                     .coreID = 0 };
+    ret = audio_player_new(config);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    event_queue = xQueueCreate(1, sizeof(audio_player_callback_event_t));
+    TEST_ASSERT_NOT_NULL(event_queue);
+
+    ret = audio_player_callback_register(audio_player_callback, NULL);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    audio_player_state_t state = audio_player_get_state();
+    TEST_ASSERT_EQUAL(state, AUDIO_PLAYER_STATE_IDLE);
+
+    extern const char mp3_start[] asm("_binary_gs_16b_1c_44100hz_mp3_start");
+    extern const char mp3_end[]   asm("_binary_gs_16b_1c_44100hz_mp3_end");
+
+    // -1 due to the size being 1 byte too large, I think because end is the byte
+    // immediately after the last byte in the memory but I'm not sure - cmm 2022-08-20
+    //
+    // Suppression as these are linker symbols and cppcheck doesn't know how to ensure
+    // they are the same object
+    // cppcheck-suppress comparePointers
+    size_t mp3_size = (mp3_end - mp3_start) - 1;
+    ESP_LOGI(TAG, "mp3_size %zu bytes", mp3_size);
+
+    FILE *fp = fmemopen((void*)mp3_start, mp3_size, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+
+
+
+    ///////////////
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_PLAYING;
+    ret = audio_player_play(fp);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    // wait for playing event to arrive
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(100)), pdPASS);
+
+    // confirm state is playing
+    state = audio_player_get_state();
+    TEST_ASSERT_EQUAL(state, AUDIO_PLAYER_STATE_PLAYING);
+
+
+
+    ///////////////
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_PAUSE;
+    ret = audio_player_pause();
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    // wait for paused event to arrive
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(100)), pdPASS);
+
+    state = audio_player_get_state();
+    TEST_ASSERT_EQUAL(state, AUDIO_PLAYER_STATE_PAUSE);
+
+
+
+    ////////////////
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_PLAYING;
+    ret = audio_player_resume();
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    // wait for paused event to arrive
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(100)), pdPASS);
+
+
+
+    ///////////////
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_IDLE;
+
+    // the track is 16 seconds long so lets wait a bit here
+    int sleep_seconds = 16;
+    ESP_LOGI(TAG, "sleeping for %d seconds for playback to complete", sleep_seconds);
+    vTaskDelay(pdMS_TO_TICKS(sleep_seconds * 1000));
+
+    // wait for idle event to arrive
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(100)), pdPASS);
+
+    state = audio_player_get_state();
+    TEST_ASSERT_EQUAL(state, AUDIO_PLAYER_STATE_IDLE);
+
+
+
+    ///////////////
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_SHUTDOWN;
+    ret = audio_player_delete();
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    // wait for idle event to arrive
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(100)), pdPASS);
+
+    state = audio_player_get_state();
+    TEST_ASSERT_EQUAL(state, AUDIO_PLAYER_STATE_SHUTDOWN);
+
+    vQueueDelete(event_queue);
+
+    TEST_ESP_OK(i2s_channel_disable(i2s_tx_chan));
+    TEST_ESP_OK(i2s_channel_disable(i2s_rx_chan));
+    TEST_ESP_OK(i2s_del_channel(i2s_tx_chan));
+    TEST_ESP_OK(i2s_del_channel(i2s_rx_chan));
+
+    ESP_LOGI(TAG, "NOTE: a memory leak will be reported the first time this test runs.\n");
+    ESP_LOGI(TAG, "esp-idf v4.4.1 and v4.4.2 both leak memory between i2s_driver_install() and i2s_driver_uninstall()\n");
+}
+
+#if CONFIG_AUDIO_PLAYER_RESAMPLE_RATE
+#define RESAMPLE_TEST_SECONDS   1
+#define RESAMPLE_TEST_TONE      1000
+#define RESAMPLE_TEST_SKIP      256
+
+static int16_t *resample_output;
+static size_t resample_output_frames;
+static size_t resample_output_max;
+
+static esp_err_t resample_test_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    size_t frames = len / (2 * sizeof(int16_t));
+    if (resample_output_frames + frames > resample_output_max) {
+        frames = resample_output_max - resample_output_frames;
+    }
+    memcpy(resample_output + resample_output_frames * 2, audio_buffer, frames * 2 * sizeof(int16_t));
+    resample_output_frames += frames;
+    *bytes_written = len;
+    return ESP_OK;
+}
+
+/**
+ * THD+N of the left channel in dB, the least squares fit of the tone is the signal and
+ * everything else is distortion and noise
+ */
+static float resample_thd_n(const int16_t *out, size_t frames, float tone, float rate)
+{
+    double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+    for (size_t k = RESAMPLE_TEST_SKIP; k < frames - RESAMPLE_TEST_SKIP; k++) {
+        double w = 2 * M_PI * tone * k / rate;
+        double s = sin(w), c = cos(w), y = out[k * 2];
+        ss += s * s; sc += s * c; cc += c * c; ys += y * s; yc += y * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+    double err = 0, sig = 0;
+    for (size_t k = RESAMPLE_TEST_SKIP; k < frames - RESAMPLE_TEST_SKIP; k++) {
+        double w = 2 * M_PI * tone * k / rate;
+        double fit = a * sin(w) + b * cos(w);
+        err += (out[k * 2] - fit) * (out[k * 2] - fit);
+        sig += fit * fit;
+    }
+    return 10 * log10(err / sig);
+}
+
+TEST_CASE("resampler THD+N and cycles per output sample", "[audio player][resample]")
+{
+    const int rates[] = { 8000, 11025, 16000, 22050, 24000, 44100, 48000 };
+    const int out_rate = CONFIG_AUDIO_PLAYER_RESAMPLE_RATE;
+
+    // room for more than the expected output, so a drain that overshoots shows up
+    resample_output_max = out_rate * RESAMPLE_TEST_SECONDS + RESAMPLE_TEST_SKIP;
+    resample_output = malloc(resample_output_max * 2 * sizeof(int16_t));
+    TEST_ASSERT_NOT_NULL(resample_output);
+
+    for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        int in_rate = rates[r];
+        size_t in_frames = in_rate * RESAMPLE_TEST_SECONDS;
+        int16_t *input = malloc(in_frames * sizeof(int16_t));
+        TEST_ASSERT_NOT_NULL(input);
+        for (size_t k = 0; k < in_frames; k++) {
+            input[k] = (int16_t)(16000 * sinf(2 * M_PI * RESAMPLE_TEST_TONE * k / in_rate));
+        }
+
+        audio_resample_t rs;
+        memset(&rs, 0, sizeof(rs));
+        TEST_ESP_OK(audio_resample_config(&rs, in_rate, 1, out_rate));
+        audio_gain_t gain = { 0 };
+        audio_gain_set(&gain, AUDIO_GAIN_UNITY, 0);
+
+        // mp3 sized blocks, the write callback only copies
+        resample_output_frames = 0;
+        uint32_t start = esp_cpu_get_cycle_count();
+        for (size_t k = 0; k < in_frames; k += 1152) {
+            size_t n = (in_frames - k < 1152) ? in_frames - k : 1152;
+            TEST_ESP_OK(audio_resample_write(&rs, input + k, n, &gain, resample_test_write));
+        }
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        size_t written = resample_output_frames;
+
+        // the drain brings the output up to the length of the input
+        TEST_ESP_OK(audio_resample_drain(&rs, &gain, resample_test_write));
+        TEST_ASSERT_INT_WITHIN(1, out_rate * RESAMPLE_TEST_SECONDS, resample_output_frames);
+
+        float thd_n = resample_thd_n(resample_output, resample_output_frames, RESAMPLE_TEST_TONE, out_rate);
+        ESP_LOGI(TAG, "%5d -> %d Hz: %u taps, THD+N %.1f dB, %lu cycles per output frame", in_rate, out_rate,
+                 (unsigned)rs.taps, thd_n, (unsigned long)(cycles / written));
+        TEST_ASSERT_LESS_THAN(-55, (int)thd_n);
+
+        // the SIMD kernel gives the same result as the portable one
+        int16_t *phase = rs.coef + (rs.phases / 2) * rs.taps;
+        int16_t *window = rs.hist;
+        for (size_t j = 0; j < rs.taps; j++) {
+            window[j] = input[j * 7 % in_frames];
+        }
+        TEST_ASSERT_INT_WITHIN(1, audio_resample_dot_ansi(window, phase, rs.taps),
+                               audio_resample_dot(window, phase, rs.taps));
+
+        audio_resample_free(&rs);
+        free(input);
+    }
+    free(resample_output);
+}
+#endif
+
+#define KERNEL_TEST_FRAMES  1152    // one mp3 frame
+
+static void kernel_test_fill(int16_t *samples, size_t count)
+{
+    uint32_t seed = 1;
+    for (size_t k = 0; k < count; k++) {
+        seed = seed * 1664525 + 1013904223;
+        samples[k] = (int16_t)(seed >> 16);
+    }
+}
+
+TEST_CASE("output kernels cycles per mp3 frame", "[audio player][kernels]")
+{
+    int16_t *buf = heap_caps_aligned_alloc(16, KERNEL_TEST_FRAMES * 2 * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    int16_t *ref = heap_caps_aligned_alloc(16, KERNEL_TEST_FRAMES * 2 * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    TEST_ASSERT_NOT_NULL(buf);
+    TEST_ASSERT_NOT_NULL(ref);
+    audio_gain_t gain = { 0 };
+    uint32_t start, cycles;
+
+    // mono -> stereo at 0 dB, against the sample by sample copy it replaces
+    kernel_test_fill(buf, KERNEL_TEST_FRAMES);
+    memcpy(ref, buf, KERNEL_TEST_FRAMES * sizeof(int16_t));
+    start = esp_cpu_get_cycle_count();
+    for (int k = KERNEL_TEST_FRAMES - 1; k >= 0; k--) {
+        ref[k * 2 + 1] = ref[k];
+        ref[k * 2] = ref[k];
+    }
+    cycles = esp_cpu_get_cycle_count() - start;
+    audio_gain_set(&gain, AUDIO_GAIN_UNITY, 0);
+    start = esp_cpu_get_cycle_count();
+    audio_kernel_output(buf, KERNEL_TEST_FRAMES, 1, &gain);
+    ESP_LOGI(TAG, "mono -> stereo: %lu cycles, copy loop %lu", (unsigned long)(esp_cpu_get_cycle_count() - start),
+             (unsigned long)cycles);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref, buf, KERNEL_TEST_FRAMES * 2);
+
+    // stereo at a constant gain, vector against portable, from an unaligned start
+    kernel_test_fill(buf, KERNEL_TEST_FRAMES * 2);
+    memcpy(ref, buf, KERNEL_TEST_FRAMES * 2 * sizeof(int16_t));
+    start = esp_cpu_get_cycle_count();
+    audio_kernel_gain_ansi(ref + 1, KERNEL_TEST_FRAMES * 2 - 1, 12345);
+    cycles = esp_cpu_get_cycle_count() - start;
+    start = esp_cpu_get_cycle_count();
+    audio_kernel_gain(buf + 1, KERNEL_TEST_FRAMES * 2 - 1, 12345);
+    ESP_LOGI(TAG, "stereo gain: %lu cycles, ANSI %lu", (unsigned long)(esp_cpu_get_cycle_count() - start),
+             (unsigned long)cycles);
+    for (size_t k = 0; k < KERNEL_TEST_FRAMES * 2; k++) {
+        TEST_ASSERT_INT_WITHIN(1, ref[k], buf[k]);
+    }
+
+    // mono -> stereo with a ramp over the whole frame ends on the target
+    kernel_test_fill(buf, KERNEL_TEST_FRAMES);
+    buf[KERNEL_TEST_FRAMES - 1] = INT16_MAX;
+    audio_gain_set(&gain, AUDIO_GAIN_UNITY, 0);
+    audio_gain_set(&gain, AUDIO_GAIN_UNITY / 4, KERNEL_TEST_FRAMES);
+    start = esp_cpu_get_cycle_count();
+    audio_kernel_output(buf, KERNEL_TEST_FRAMES, 1, &gain);
+    ESP_LOGI(TAG, "mono -> stereo with ramp: %lu cycles", (unsigned long)(esp_cpu_get_cycle_count() - start));
+    TEST_ASSERT_EQUAL_INT32(0, gain.step);
+    TEST_ASSERT_EQUAL_INT32(AUDIO_GAIN_UNITY / 4, gain.pos >> 15);
+    TEST_ASSERT_INT_WITHIN(32, INT16_MAX / 4, buf[KERNEL_TEST_FRAMES * 2 - 1]);
+
+    heap_caps_free(buf);
+    heap_caps_free(ref);
+}
+
+TEST_CASE("mp3 decode real-time factor", "[audio player][mp3]")
+{
+    extern const char mp3_start[] asm("_binary_gs_16b_1c_44100hz_mp3_start");
+    extern const char mp3_end[]   asm("_binary_gs_16b_1c_44100hz_mp3_end");
+    // cppcheck-suppress comparePointers
+    int left = (mp3_end - mp3_start) - 1;
+    unsigned char *read_ptr = (unsigned char *)mp3_start;
+
+    HMP3Decoder decoder = MP3InitDecoder();
+    TEST_ASSERT_NOT_NULL(decoder);
+    short *pcm = malloc(MAX_NCHAN * MAX_NGRAN * MAX_NSAMP * sizeof(short));
+    TEST_ASSERT_NOT_NULL(pcm);
+
+    // decoding only, straight from flash, no file or I2S in the way
+    MP3FrameInfo info = { 0 };
+    uint64_t audio_frames = 0;
+    int mp3_frames = 0;
+    int64_t start = esp_timer_get_time();
+    while (left > 0) {
+        int offset = MP3FindSyncWord(read_ptr, left);
+        if (offset < 0) {
+            break;
+        }
+        read_ptr += offset;
+        left -= offset;
+        int err = MP3Decode(decoder, &read_ptr, &left, pcm, 0);
+        if (err == ERR_MP3_INDATA_UNDERFLOW) {
+            break;
+        } else if (err) {
+            // skip the bad sync word
+            read_ptr++;
+            left--;
+            continue;
+        }
+        MP3GetLastFrameInfo(decoder, &info);
+        audio_frames += info.outputSamps / info.nChans;
+        mp3_frames++;
+    }
+    int64_t decode_us = esp_timer_get_time() - start;
+
+    TEST_ASSERT_NOT_EQUAL(0, info.samprate);
+    int64_t audio_us = audio_frames * 1000000 / info.samprate;
+    ESP_LOGI(TAG, "%d mp3 frames, %lld ms of %d Hz audio in %lld ms, real-time factor %.3f, %lu us per frame",
+             mp3_frames, audio_us / 1000, info.samprate, decode_us / 1000, (double)decode_us / audio_us,
+             (unsigned long)(decode_us / mp3_frames));
+    TEST_ASSERT_LESS_THAN(audio_us, decode_us);
+
+    free(pcm);
+    MP3FreeDecoder(decoder);
+}
+
+typedef struct {
+    const char *data;
+    size_t size;
+    size_t pos;
+} stream_test_cookie_t;
+
+static size_t stream_test_bytes;
+static QueueHandle_t stream_test_events;
+
+static ssize_t stream_test_read(void *cookie, char *buf, size_t size)
+{
+    stream_test_cookie_t *c = (stream_test_cookie_t *)cookie;
+    size_t n = (size < c->size - c->pos) ? size : c->size - c->pos;
+    memcpy(buf, c->data + c->pos, n);
+    c->pos += n;
+    return n;
+}
+
+static int stream_test_close(void *cookie)
+{
+    return 0;
+}
+
+static esp_err_t stream_test_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    stream_test_bytes += len;
+    *bytes_written = len;
+    return ESP_OK;
+}
+
+static esp_err_t stream_test_clk(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    return ESP_OK;
+}
+
+static void stream_test_callback(audio_player_cb_ctx_t *ctx)
+{
+    xQueueSend(stream_test_events, &(ctx->audio_event), 0);
+}
+
+/**
+ * A FILE without a seek function, like a network stream, the type is probed
+ * on the first bytes read
+ */
+static FILE *stream_test_open(stream_test_cookie_t *cookie)
+{
+    cookie_io_functions_t io = {
+        .read = stream_test_read,
+        .write = NULL,
+        .seek = NULL,
+        .close = stream_test_close,
+    };
+    return fopencookie(cookie, "rb", io);
+}
+
+static audio_player_callback_event_t stream_test_wait(audio_player_callback_event_t until)
+{
+    audio_player_callback_event_t event = AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN;
+    while (xQueueReceive(stream_test_events, &event, pdMS_TO_TICKS(20000)) == pdPASS) {
+        if (event == until || event == AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE) {
+            break;
+        }
+    }
+    return event;
+}
+
+#if CONFIG_AUDIO_PLAYER_ENABLE_OPUS
+/**
+ * One Ogg page holding packets of at most 254 bytes each, see RFC 3533. The CRC is
+ * left at 0, the player does not check it.
+ */
+static size_t ogg_test_page(char *dst, uint8_t type, uint32_t sequence, const uint8_t *packets,
+                            const uint8_t *sizes, uint8_t count)
+{
+    memset(dst, 0, 27);
+    memcpy(dst, "OggS", 4);
+    dst[5] = type;
+    memcpy(dst + 18, &sequence, 4);
+    dst[26] = count;
+    size_t body = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        dst[27 + i] = sizes[i];
+        body += sizes[i];
+    }
+    memcpy(dst + 27 + count, packets, body);
+    return 27 + count + body;
+}
+
+/** OpusHead, OpusTags and a second of 20 ms silence frames, mono */
+static size_t ogg_test_opus(char *dst, size_t size)
+{
+    static const uint8_t head[19] = { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, 1,
+                                      0x38, 0x01, 0x80, 0xBB, 0, 0, 0, 0, 0 };
+    static const uint8_t tags[20] = { 'O', 'p', 'u', 's', 'T', 'a', 'g', 's', 4, 0, 0, 0,
+                                      't', 'e', 's', 't', 0, 0, 0, 0 };
+    static const uint8_t silence[3] = { 0xF8, 0xFF, 0xFE };
+    uint8_t packets[25 * sizeof(silence)];
+    uint8_t sizes[25];
+    for (int i = 0; i < 25; i++) {
+        memcpy(packets + i * sizeof(silence), silence, sizeof(silence));
+        sizes[i] = sizeof(silence);
+    }
+
+    size_t len = 0;
+    uint8_t head_size = sizeof(head);
+    uint8_t tags_size = sizeof(tags);
+    len += ogg_test_page(dst + len, 0x02, 0, head, &head_size, 1);
+    len += ogg_test_page(dst + len, 0x00, 1, tags, &tags_size, 1);
+    len += ogg_test_page(dst + len, 0x00, 2, packets, sizes, 25);
+    len += ogg_test_page(dst + len, 0x04, 3, packets, sizes, 25);
+    TEST_ASSERT_LESS_OR_EQUAL(size, len);
+    return len;
+}
+#endif
+
+TEST_CASE("files are probed without seeking", "[audio player][probe]")
+{
+    extern const char mp3_start[] asm("_binary_gs_16b_1c_44100hz_mp3_start");
+    extern const char mp3_end[]   asm("_binary_gs_16b_1c_44100hz_mp3_end");
+
+    audio_player_config_t config = { .mute_fn = audio_mute_function,
+                                     .write_fn = stream_test_write,
+                                     .clk_set_fn = stream_test_clk,
+                                     .priority = 0,
+                                     .coreID = 0 };
+    TEST_ESP_OK(audio_player_new(config));
+    stream_test_events = xQueueCreate(8, sizeof(audio_player_callback_event_t));
+    TEST_ASSERT_NOT_NULL(stream_test_events);
+    TEST_ESP_OK(audio_player_callback_register(stream_test_callback, NULL));
+
+    // the whole mp3 decodes, the bytes read for the probe included
+    // cppcheck-suppress comparePointers
+    stream_test_cookie_t mp3 = { mp3_start, (mp3_end - mp3_start) - 1, 0 };
+    stream_test_bytes = 0;
+    TEST_ESP_OK(audio_player_play(stream_test_open(&mp3)));
+    TEST_ASSERT_EQUAL(AUDIO_PLAYER_CALLBACK_EVENT_IDLE, stream_test_wait(AUDIO_PLAYER_CALLBACK_EVENT_IDLE));
+    TEST_ASSERT_EQUAL(mp3.size, mp3.pos);
+    TEST_ASSERT_GREATER_THAN(0, stream_test_bytes);
+
+#if CONFIG_AUDIO_PLAYER_ENABLE_OPUS
+    // an Ogg Opus stream of silence frames decodes over pages read in order
+    static char ogg_opus[4096];
+    stream_test_cookie_t opus = { ogg_opus, ogg_test_opus(ogg_opus, sizeof(ogg_opus)), 0 };
+    stream_test_bytes = 0;
+    TEST_ESP_OK(audio_player_play(stream_test_open(&opus)));
+    TEST_ASSERT_EQUAL(AUDIO_PLAYER_CALLBACK_EVENT_IDLE, stream_test_wait(AUDIO_PLAYER_CALLBACK_EVENT_IDLE));
+    TEST_ASSERT_EQUAL(opus.size, opus.pos);
+    TEST_ASSERT_GREATER_THAN(0, stream_test_bytes);
+#endif
+
+    // a first page with OpusHead but nothing after it is rejected by name
+    static char ogg[64];
+    memcpy(ogg, "OggS", 4);
+    memcpy(ogg + 28, "OpusHead", 8);
+    stream_test_cookie_t truncated = { ogg, sizeof(ogg), 0 };
+    TEST_ESP_OK(audio_player_play(stream_test_open(&truncated)));
+    TEST_ASSERT_EQUAL(AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE, stream_test_wait(AUDIO_PLAYER_CALLBACK_EVENT_IDLE));
+
+    TEST_ESP_OK(audio_player_delete());
+    vQueueDelete(stream_test_events);
+}
@@ -420,27 +420,30 @@ static __inline Word64 SAR64(Word64 x, int n)
 
 typedef long long Word64;
 
+#if XCHAL_HAVE_MUL32_HIGH
+
+/* mull + mulsh give the two halves of the product, the carry out of the low add is the
+ * unsigned compare, as there is no carry flag. Exact, the polyphase filter relies on it.
+ */
 static __inline Word64 MADD64(Word64 sum64, int x, int y)
 {
-    return (sum64 + ((long long)x * y));
+    unsigned int lo, sumLo = (unsigned int)sum64;
+    int hi, sumHi = (int)(sum64 >> 32);
+
+    asm ("mull %0, %1, %2" : "=r" (lo) : "r" (x), "r" (y));
+    asm ("mulsh %0, %1, %2" : "=r" (hi) : "r" (x), "r" (y));
+    sumLo += lo;
+    sumHi += hi + (sumLo < lo);
+    return (Word64)(((unsigned long long)(unsigned int)sumHi << 32) | sumLo);
 }
 
-#if XCHAL_HAVE_MUL32_HIGH
-
 static __inline int MULSHIFT32(int x, int y)
 {
-    /* important rules for smull RdLo, RdHi, Rm, Rs:
-     *     RdHi and Rm can't be the same register
-     *     RdLo and Rm can't be the same register
-     *     RdHi and RdLo can't be the same register
-     * Note: Rs determines early termination (leading sign bits) so if you want to specify
-     *   which operand is Rs, put it in the SECOND argument (y)
-     * For inline assembly, x and y are not assumed to be R0, R1 so it shouldn't matter
-     *   which one is returned. (If this were a function call, returning y (R1) would
-     *   require an extra "mov r0, r1")
+    /* not volatile: no side effects, so the compiler may schedule it between the loads of
+     * the imdct and dct32 loops and drop unused results
      */
     int ret;
-    asm volatile ("mulsh %0, %1, %2" : "=r" (ret) : "r" (x), "r" (y));
+    asm ("mulsh %0, %1, %2" : "=r" (ret) : "r" (x), "r" (y));
     return ret;
 }
 
@@ -455,7 +458,7 @@ static __inline int MULSHIFT32(int x, int y)
 static __inline int FASTABS(int x)
 {
     int ret;
-    asm volatile ("abs %0, %1" : "=r" (ret) : "r" (x));
+    asm ("abs %0, %1" : "=r" (ret) : "r" (x));
     return ret;
 }
 
@@ -470,11 +473,25 @@ static __inline Word64 SAR64(Word64 x, int n)
     return x >> n;
 }
 
+#if XCHAL_HAVE_NSA
+
+/* nsau gives 32 for 0, __builtin_clz(0) is undefined and silent granules do pass 0 */
+static __inline int CLZ(int x)
+{
+    int ret;
+    asm ("nsau %0, %1" : "=r" (ret) : "r" (x));
+    return ret;
+}
+
+#else
+
 static __inline int CLZ(int x)
 {
-    return __builtin_clz(x);
+    return x ? __builtin_clz(x) : 32;
 }
 
+#endif
+
 #else
 
 #error Unsupported platform in assembly.h
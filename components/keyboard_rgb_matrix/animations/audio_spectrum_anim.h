@@ -0,0 +1,29 @@
+#ifdef CONFIG_ENABLE_RGB_MATRIX_AUDIO_SPECTRUM
+RGB_MATRIX_EFFECT(AUDIO_SPECTRUM)
+#    ifdef RGB_MATRIX_CUSTOM_EFFECT_IMPLS
+
+static rgb_matrix_audio_t spectrum_audio;
+
+// One column per band from low (left) to high (right) frequency, filled from the bottom row
+static HSV AUDIO_SPECTRUM_math(HSV hsv, uint8_t i, uint8_t time)
+{
+    uint8_t band   = (g_led_config.point[i].x * RGB_MATRIX_AUDIO_BANDS) / 225;
+    uint8_t height = g_led_config.point[i].y < 64 ? 64 - g_led_config.point[i].y : 0;
+    hsv.h += band * (256 / RGB_MATRIX_AUDIO_BANDS);
+    if ((uint16_t)height * 255 >= (uint16_t)spectrum_audio.band[band] * 65) {
+        hsv.v = 0;
+    }
+    return hsv;
+}
+
+bool AUDIO_SPECTRUM(effect_params_t* params)
+{
+    // Take one snapshot per frame so all iterations draw the same bands
+    if (params->iter == 0) {
+        rgb_matrix_audio_read(&spectrum_audio);
+    }
+    return effect_runner_i(params, &AUDIO_SPECTRUM_math);
+}
+
+#    endif // RGB_MATRIX_CUSTOM_EFFECT_IMPLS
+#endif     // CONFIG_ENABLE_RGB_MATRIX_AUDIO_SPECTRUM
@@ -0,0 +1,28 @@
+#ifdef CONFIG_ENABLE_RGB_MATRIX_AUDIO_VU_METER
+RGB_MATRIX_EFFECT(AUDIO_VU_METER)
+#    ifdef RGB_MATRIX_CUSTOM_EFFECT_IMPLS
+
+static rgb_matrix_audio_t vu_meter_audio;
+
+// Bar grows from the left edge with loudness, green at the left end to red at full scale
+static HSV AUDIO_VU_METER_math(HSV hsv, uint8_t i, uint8_t time)
+{
+    uint8_t x = g_led_config.point[i].x;
+    hsv.h     = 85 - (x * 85) / 224;
+    if ((uint16_t)x * 255 >= (uint16_t)vu_meter_audio.level * 225) {
+        hsv.v = 0;
+    }
+    return hsv;
+}
+
+bool AUDIO_VU_METER(effect_params_t* params)
+{
+    // Take one snapshot per frame so all iterations draw the same level
+    if (params->iter == 0) {
+        rgb_matrix_audio_read(&vu_meter_audio);
+    }
+    return effect_runner_i(params, &AUDIO_VU_METER_math);
+}
+
+#    endif // RGB_MATRIX_CUSTOM_EFFECT_IMPLS
+#endif     // CONFIG_ENABLE_RGB_MATRIX_AUDIO_VU_METER
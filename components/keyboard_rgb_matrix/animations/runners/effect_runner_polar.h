@@ -0,0 +1,16 @@
+#pragma once
+
+typedef HSV(*polar_f)(HSV hsv, uint8_t dist, uint8_t angle, uint8_t time);
+
+bool effect_runner_polar(effect_params_t* params, polar_f effect_func)
+{
+    RGB_MATRIX_USE_LIMITS(led_min, led_max);
+
+    uint8_t time = scale16by8(g_rgb_timer, rgb_matrix_config.speed / 2);
+    for (uint8_t i = led_min; i < led_max; i++) {
+        RGB_MATRIX_TEST_LED_FLAGS();
+        rgb_matrix_set_color_hsv(i, effect_func(rgb_matrix_config.hsv, g_led_polar.dist[i], g_led_polar.angle[i], time));
+    }
+    rgb_matrix_flush_hsv(led_min, led_max, params->flags);
+    return rgb_matrix_check_finished_leds(led_max);
+}
@@ -21,9 +21,9 @@ bool effect_runner_reactive(effect_params_t* params, reactive_f effect_func)
         }
 
         uint16_t offset = scale16by8(tick, qadd8(rgb_matrix_config.speed, 1));
-        RGB      rgb    = rgb_matrix_hsv_to_rgb(effect_func(rgb_matrix_config.hsv, offset));
-        rgb_matrix_set_color(i, rgb.r, rgb.g, rgb.b);
+        rgb_matrix_set_color_hsv(i, effect_func(rgb_matrix_config.hsv, offset));
     }
+    rgb_matrix_flush_hsv(led_min, led_max, params->flags);
     return rgb_matrix_check_finished_leds(led_max);
 }
 
@@ -9,10 +9,6 @@ RGB_MATRIX_EFFECT(TYPING_HEATMAP)
 #            define RGB_MATRIX_TYPING_HEATMAP_DECREASE_DELAY_MS 10
 #        endif
 
-#        ifndef RGB_MATRIX_TYPING_HEATMAP_SPREAD
-#            define RGB_MATRIX_TYPING_HEATMAP_SPREAD 40
-#        endif
-
 #        ifndef RGB_MATRIX_TYPING_HEATMAP_AREA_LIMIT
 #            define RGB_MATRIX_TYPING_HEATMAP_AREA_LIMIT 16
 #        endif
@@ -25,26 +21,17 @@ void process_rgb_matrix_typing_heatmap(uint8_t row, uint8_t col)
     if (g_led_config.matrix_co[row][col] == NO_LED) { // skip as pressed key doesn't have an led position
         return;
     }
-    for (uint8_t i_row = 0; i_row < CONFIG_MATRIX_ROWS; i_row++) {
-        for (uint8_t i_col = 0; i_col < CONFIG_MATRIX_COLS; i_col++) {
-            if (g_led_config.matrix_co[i_row][i_col] == NO_LED) { // skip as target key doesn't have an led position
-                continue;
-            }
-            if (i_row == row && i_col == col) {
-                g_rgb_frame_buffer[row][col] = qadd8(g_rgb_frame_buffer[row][col], RGB_MATRIX_TYPING_HEATMAP_INCREASE_STEP);
-            } else {
-#            define LED_DISTANCE(led_a, led_b) sqrt16(((int16_t)(led_a.x - led_b.x) * (int16_t)(led_a.x - led_b.x)) + ((int16_t)(led_a.y - led_b.y) * (int16_t)(led_a.y - led_b.y)))
-                uint8_t distance = LED_DISTANCE(g_led_config.point[g_led_config.matrix_co[row][col]], g_led_config.point[g_led_config.matrix_co[i_row][i_col]]);
-#            undef LED_DISTANCE
-                if (distance <= RGB_MATRIX_TYPING_HEATMAP_SPREAD) {
-                    uint8_t amount = qsub8(RGB_MATRIX_TYPING_HEATMAP_SPREAD, distance);
-                    if (amount > RGB_MATRIX_TYPING_HEATMAP_AREA_LIMIT) {
-                        amount = RGB_MATRIX_TYPING_HEATMAP_AREA_LIMIT;
-                    }
-                    g_rgb_frame_buffer[i_row][i_col] = qadd8(g_rgb_frame_buffer[i_row][i_col], amount);
-                }
-            }
+    g_rgb_frame_buffer[row][col] = qadd8(g_rgb_frame_buffer[row][col], RGB_MATRIX_TYPING_HEATMAP_INCREASE_STEP);
+
+    // Keys within RGB_MATRIX_TYPING_HEATMAP_SPREAD are precomputed by rgb_matrix_geometry_init()
+    uint16_t              count;
+    const led_neighbor_t* neighbor = rgb_matrix_key_neighbors(row, col, &count);
+    for (uint16_t i = 0; i < count; i++, neighbor++) {
+        uint8_t amount = qsub8(RGB_MATRIX_TYPING_HEATMAP_SPREAD, neighbor->dist);
+        if (amount > RGB_MATRIX_TYPING_HEATMAP_AREA_LIMIT) {
+            amount = RGB_MATRIX_TYPING_HEATMAP_AREA_LIMIT;
         }
+        g_rgb_frame_buffer[neighbor->row][neighbor->col] = qadd8(g_rgb_frame_buffer[neighbor->row][neighbor->col], amount);
     }
 #        endif
 }
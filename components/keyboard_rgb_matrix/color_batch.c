@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "color_batch.h"
+#include "led_tables.h"
+#include "progmem.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#    define COLOR_BATCH_HAS_SIMD 1
+// color_batch_esp32s3.S
+void color_batch_pqt_esp32s3(const uint8_t *s, const uint8_t *v, const uint8_t *rem, uint8_t *pqt, size_t count);
+void color_batch_scale8_esp32s3(uint8_t *data, const uint8_t *scale, size_t count);
+#else
+#    define COLOR_BATCH_HAS_SIMD 0
+#endif
+
+// Pixels converted per pass, keeps the scratch buffers below half a KiB of stack
+#define COLOR_BATCH_CHUNK (COLOR_BATCH_LANES * 4)
+
+static bool s_use_simd = COLOR_BATCH_HAS_SIMD;
+
+void color_batch_use_simd(bool enable)
+{
+    s_use_simd = enable && COLOR_BATCH_HAS_SIMD;
+}
+
+bool color_batch_simd_available(void)
+{
+    return COLOR_BATCH_HAS_SIMD;
+}
+
+static void color_batch_pqt_scalar(const uint8_t *s, const uint8_t *v, const uint8_t *rem, uint8_t *pqt, size_t count, size_t stride)
+{
+    uint8_t *p = pqt;
+    uint8_t *q = pqt + stride;
+    uint8_t *t = pqt + 2 * stride;
+
+    for (size_t i = 0; i < count; i++) {
+        p[i] = (v[i] * (255 - s[i])) >> 8;
+        q[i] = (v[i] * (255 - ((s[i] * rem[i]) >> 8))) >> 8;
+        t[i] = (v[i] * (255 - ((s[i] * (255 - rem[i])) >> 8))) >> 8;
+    }
+}
+
+void hsv_to_rgb_batch(const uint8_t *h, const uint8_t *s, const uint8_t *v, RGB *rgb, size_t count)
+{
+    uint8_t sat[COLOR_BATCH_CHUNK] __attribute__((aligned(16)));
+    uint8_t val[COLOR_BATCH_CHUNK] __attribute__((aligned(16)));
+    uint8_t rem[COLOR_BATCH_CHUNK] __attribute__((aligned(16)));
+    uint8_t pqt[COLOR_BATCH_CHUNK * 3] __attribute__((aligned(16)));
+    uint8_t region[COLOR_BATCH_CHUNK];
+
+    while (count) {
+        size_t n     = count < COLOR_BATCH_CHUNK ? count : COLOR_BATCH_CHUNK;
+        size_t lanes = COLOR_BATCH_ALIGN(n);
+
+        // Same region/remainder split as hsv_to_rgb_impl(), kept scalar since it is a table-free
+        // multiply by a constant. The trailing lanes of the last vector are don't-care.
+        for (size_t i = 0; i < n; i++) {
+            sat[i]    = s[i];
+#ifdef USE_CIE1931_CURVE
+            val[i]    = pgm_read_byte(&CIE1931_CURVE[v[i]]);
+#else
+            val[i]    = v[i];
+#endif
+            region[i] = h[i] * 6 / 255;
+            rem[i]    = (h[i] * 2 - region[i] * 85) * 3;
+        }
+
+#if COLOR_BATCH_HAS_SIMD
+        if (s_use_simd) {
+            color_batch_pqt_esp32s3(sat, val, rem, pqt, lanes);
+        } else
+#endif
+        {
+            color_batch_pqt_scalar(sat, val, rem, pqt, n, lanes);
+        }
+
+        const uint8_t *p = pqt;
+        const uint8_t *q = pqt + lanes;
+        const uint8_t *t = pqt + 2 * lanes;
+        for (size_t i = 0; i < n; i++) {
+            if (sat[i] == 0) {
+                rgb[i].r = rgb[i].g = rgb[i].b = val[i];
+                continue;
+            }
+            switch (region[i]) {
+            case 6:
+            case 0:
+                rgb[i].r = val[i];
+                rgb[i].g = t[i];
+                rgb[i].b = p[i];
+                break;
+            case 1:
+                rgb[i].r = q[i];
+                rgb[i].g = val[i];
+                rgb[i].b = p[i];
+                break;
+            case 2:
+                rgb[i].r = p[i];
+                rgb[i].g = val[i];
+                rgb[i].b = t[i];
+                break;
+            case 3:
+                rgb[i].r = p[i];
+                rgb[i].g = q[i];
+                rgb[i].b = val[i];
+                break;
+            case 4:
+                rgb[i].r = t[i];
+                rgb[i].g = p[i];
+                rgb[i].b = val[i];
+                break;
+            default:
+                rgb[i].r = val[i];
+                rgb[i].g = p[i];
+                rgb[i].b = q[i];
+                break;
+            }
+        }
+
+        h += n;
+        s += n;
+        v += n;
+        rgb += n;
+        count -= n;
+    }
+}
+
+void scale8_batch(uint8_t *data, uint8_t scale, size_t count)
+{
+    size_t done = 0;
+
+#if COLOR_BATCH_HAS_SIMD
+    if (s_use_simd && ((uintptr_t)data & (COLOR_BATCH_LANES - 1)) == 0) {
+        done = count & ~(size_t)(COLOR_BATCH_LANES - 1);
+        color_batch_scale8_esp32s3(data, &scale, done);
+    }
+#endif
+
+    for (size_t i = done; i < count; i++) {
+        data[i] = (data[i] * scale) >> 8;
+    }
+}
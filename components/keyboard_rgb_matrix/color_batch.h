@@ -0,0 +1,33 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "color.h"
+
+/* The batch kernels work on lanes of 16 bytes, one 128-bit PIE register on ESP32-S3.
+ * Channel arrays handed to them should be 16-byte aligned and padded to a multiple of
+ * COLOR_BATCH_LANES, otherwise the vector path falls back to the scalar one.
+ */
+#define COLOR_BATCH_LANES 16
+#define COLOR_BATCH_ALIGN(n) (((n) + COLOR_BATCH_LANES - 1) & ~(COLOR_BATCH_LANES - 1))
+
+/* Convert `count` pixels from struct-of-arrays HSV to packed RGB.
+ * Produces exactly the same values as hsv_to_rgb() for every pixel.
+ */
+void hsv_to_rgb_batch(const uint8_t *h, const uint8_t *s, const uint8_t *v, RGB *rgb, size_t count);
+
+/* In-place scale8() over a byte buffer, e.g. a whole RGB frame for brightness limiting. */
+void scale8_batch(uint8_t *data, uint8_t scale, size_t count);
+
+/* Select the vector kernels (true) or the portable scalar ones (false).
+ * Only has an effect on targets with PIE, used by the benchmark to compare both paths.
+ */
+void color_batch_use_simd(bool enable);
+bool color_batch_simd_available(void);
@@ -37,6 +37,54 @@ __attribute__((weak)) RGB rgb_matrix_hsv_to_rgb(HSV hsv)
     return hsv_to_rgb(hsv);
 }
 
+#ifdef CONFIG_RGB_MATRIX_HSV_BATCH
+hsv_frame_t g_rgb_hsv_frame;
+static bool hsv_batch_enabled = true;
+#endif // CONFIG_RGB_MATRIX_HSV_BATCH
+
+void rgb_matrix_set_hsv_batch(bool enable)
+{
+#ifdef CONFIG_RGB_MATRIX_HSV_BATCH
+    hsv_batch_enabled = enable;
+#endif
+}
+
+void rgb_matrix_set_color_hsv(int index, HSV hsv)
+{
+#ifdef CONFIG_RGB_MATRIX_HSV_BATCH
+    if (hsv_batch_enabled) {
+        g_rgb_hsv_frame.h[index] = hsv.h;
+        g_rgb_hsv_frame.s[index] = hsv.s;
+        g_rgb_hsv_frame.v[index] = hsv.v;
+        return;
+    }
+#endif
+    RGB rgb = rgb_matrix_hsv_to_rgb(hsv);
+    rgb_matrix_set_color(index, rgb.r, rgb.g, rgb.b);
+}
+
+void rgb_matrix_flush_hsv(uint8_t led_min, uint8_t led_max, led_flags_t flags)
+{
+#ifdef CONFIG_RGB_MATRIX_HSV_BATCH
+    if (!hsv_batch_enabled || led_min >= led_max) {
+        return;
+    }
+
+    // Convert whole vector lanes, the frame is padded so this never runs past its end
+    uint16_t start = led_min & ~(COLOR_BATCH_LANES - 1);
+    uint16_t end   = COLOR_BATCH_ALIGN(led_max); // 256 for led_max above 240
+    RGB      rgb[RGB_MATRIX_HSV_FRAME_LEN];
+    hsv_to_rgb_batch(&g_rgb_hsv_frame.h[start], &g_rgb_hsv_frame.s[start], &g_rgb_hsv_frame.v[start], rgb, end - start);
+
+    for (uint8_t i = led_min; i < led_max; i++) {
+        if (!HAS_ANY_FLAGS(g_led_config.flags[i], flags)) {
+            continue;
+        }
+        rgb_matrix_set_color(i, rgb[i - start].r, rgb[i - start].g, rgb[i - start].b);
+    }
+#endif // CONFIG_RGB_MATRIX_HSV_BATCH
+}
+
 // Generic effect runners
 #include "rgb_matrix_runners.inc"
 
@@ -295,35 +343,30 @@ static void rgb_task_start(void)
     rgb_task_state = RENDERING;
 }
 
-static void rgb_task_render(uint8_t effect)
+bool rgb_matrix_render_effect(uint8_t effect, effect_params_t *params)
 {
-    bool rendering         = false;
-    rgb_effect_params.init = (effect != rgb_last_effect) || (rgb_matrix_config.enable != rgb_last_enable);
-    if (rgb_effect_params.flags != rgb_matrix_config.flags) {
-        rgb_effect_params.flags = rgb_matrix_config.flags;
-        rgb_matrix_set_color_all(0, 0, 0);
-    }
+    bool rendering = false;
 
     // each effect can opt to do calculations
     // and/or request PWM buffer updates.
     switch (effect) {
     case RGB_MATRIX_NONE:
-        rendering = rgb_matrix_none(&rgb_effect_params);
+        rendering = rgb_matrix_none(params);
         break;
 
 // ---------------------------------------------
 // -----Begin rgb effect switch case macros-----
-#define RGB_MATRIX_EFFECT(name, ...)          \
-    case RGB_MATRIX_##name:                   \
-        rendering = name(&rgb_effect_params); \
+#define RGB_MATRIX_EFFECT(name, ...) \
+    case RGB_MATRIX_##name:          \
+        rendering = name(params);    \
         break;
 #include "rgb_matrix_effects.inc"
 #undef RGB_MATRIX_EFFECT
 
 #if defined(RGB_MATRIX_CUSTOM_KB) || defined(RGB_MATRIX_CUSTOM_USER)
-#    define RGB_MATRIX_EFFECT(name, ...)          \
-        case RGB_MATRIX_CUSTOM_##name:            \
-            rendering = name(&rgb_effect_params); \
+#    define RGB_MATRIX_EFFECT(name, ...)             \
+        case RGB_MATRIX_CUSTOM_##name:               \
+            rendering = name(params);                \
             printf("RGB_MATRIX_CUSTOM_%s\n", #name); \
             break;
 #    ifdef RGB_MATRIX_CUSTOM_KB
@@ -337,14 +380,31 @@ static void rgb_task_render(uint8_t effect)
     // -----End rgb effect switch case macros-------
     // ---------------------------------------------
 
+    default:
+        break;
+    }
+
+    return rendering;
+}
+
+static void rgb_task_render(uint8_t effect)
+{
+    bool rendering         = false;
+    rgb_effect_params.init = (effect != rgb_last_effect) || (rgb_matrix_config.enable != rgb_last_enable);
+    if (rgb_effect_params.flags != rgb_matrix_config.flags) {
+        rgb_effect_params.flags = rgb_matrix_config.flags;
+        rgb_matrix_set_color_all(0, 0, 0);
+    }
+
     // Factory default magic value
-    case UINT8_MAX: {
+    if (effect == UINT8_MAX) {
         rgb_matrix_test();
         rgb_task_state = FLUSHING;
-    }
-    return;
+        return;
     }
 
+    rendering = rgb_matrix_render_effect(effect, &rgb_effect_params);
+
     rgb_effect_params.iter++;
 
     // next task
@@ -500,6 +560,9 @@ void rgb_matrix_init(void)
     }
 #endif // RGB_MATRIX_KEYREACTIVE_ENABLED
 
+    rgb_matrix_geometry_init();
+    rgb_matrix_output_init();
+
     nvs_init_rgb_matrix();
     if (!rgb_matrix_config.mode) {
         printf("rgb_matrix_init_drivers rgb_matrix_config.mode = 0. Write default values to EEPROM.\n");
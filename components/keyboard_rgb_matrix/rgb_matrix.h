@@ -23,6 +23,9 @@
 #include "post_config.h"
 #include "rgb_matrix_types.h"
 #include "rgb_matrix_drivers.h"
+#include "rgb_matrix_geometry.h"
+#include "rgb_matrix_audio.h"
+#include "rgb_matrix_output.h"
 #include "color.h"
 #if defined(RGB_MATRIX_SPLIT)
 #include "keyboard.h"
@@ -89,6 +92,10 @@
 #    define RGB_MATRIX_LED_FLUSH_LIMIT 16
 #endif
 
+#ifndef RGB_MATRIX_TYPING_HEATMAP_SPREAD
+#    define RGB_MATRIX_TYPING_HEATMAP_SPREAD 40
+#endif
+
 #ifndef RGB_MATRIX_LED_PROCESS_LIMIT
 #    define RGB_MATRIX_LED_PROCESS_LIMIT ((CONFIG_MATRIX_LED_COUNT + 4) / 5)
 #endif
@@ -151,6 +158,15 @@ uint8_t rgb_matrix_map_row_column_to_led(uint8_t row, uint8_t column, uint8_t *l
 void rgb_matrix_set_color(int index, uint8_t red, uint8_t green, uint8_t blue);
 void rgb_matrix_set_color_all(uint8_t red, uint8_t green, uint8_t blue);
 
+// Set an LED from HSV. With CONFIG_RGB_MATRIX_HSV_BATCH the value is only stored in
+// g_rgb_hsv_frame and reaches the driver on the next rgb_matrix_flush_hsv() for its range.
+void rgb_matrix_set_color_hsv(int index, HSV hsv);
+void rgb_matrix_flush_hsv(uint8_t led_min, uint8_t led_max, led_flags_t flags);
+void rgb_matrix_set_hsv_batch(bool enable);
+
+// Render one iteration of an effect, returns true while more iterations are needed
+bool rgb_matrix_render_effect(uint8_t effect, effect_params_t *params);
+
 void process_rgb_matrix(uint8_t row, uint8_t col, bool pressed);
 
 void rgb_matrix_task(void);
@@ -274,6 +290,8 @@ static inline bool rgb_matrix_check_finished_leds(uint8_t led_idx)
 
 extern rgb_config_t rgb_matrix_config;
 
+extern const led_point_t k_rgb_matrix_center;
+
 extern uint32_t     g_rgb_timer;
 extern led_config_t g_led_config;
 #ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
@@ -282,3 +300,6 @@ extern last_hit_t g_last_hit_tracker;
 #ifdef RGB_MATRIX_FRAMEBUFFER_EFFECTS
 extern uint8_t g_rgb_frame_buffer[CONFIG_MATRIX_ROWS][CONFIG_MATRIX_COLS];
 #endif
+#ifdef CONFIG_RGB_MATRIX_HSV_BATCH
+extern hsv_frame_t g_rgb_hsv_frame;
+#endif
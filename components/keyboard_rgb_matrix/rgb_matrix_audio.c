@@ -0,0 +1,56 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "rgb_matrix_audio.h"
+#include "sync_timer.h"
+
+// Attempts before the reader gives up and keeps a silent frame, the writer publishes every few ms
+#define AUDIO_READ_RETRIES 4
+
+/* Sequence lock: the writer makes the counter odd while it updates the frame and even once
+ * done, a reader retries if the counter was odd or changed during its copy.
+ */
+static struct {
+    uint32_t           seq;
+    rgb_matrix_audio_t frame;
+} s_audio;
+
+void rgb_matrix_audio_publish(const rgb_matrix_audio_t *frame)
+{
+    uint32_t seq = __atomic_load_n(&s_audio.seq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&s_audio.seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&s_audio.frame, frame, sizeof(s_audio.frame));
+    s_audio.frame.timestamp = sync_timer_read32();
+    __atomic_store_n(&s_audio.seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+bool rgb_matrix_audio_read(rgb_matrix_audio_t *frame)
+{
+    for (int i = 0; i < AUDIO_READ_RETRIES; i++) {
+        uint32_t seq = __atomic_load_n(&s_audio.seq, __ATOMIC_ACQUIRE);
+        if (seq == 0) {
+            break; // nothing published yet
+        }
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(frame, &s_audio.frame, sizeof(*frame));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s_audio.seq, __ATOMIC_RELAXED) != seq) {
+            continue;
+        }
+        if (sync_timer_elapsed32(frame->timestamp) > RGB_MATRIX_AUDIO_TIMEOUT_MS) {
+            break;
+        }
+        return true;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+    return false;
+}
@@ -0,0 +1,40 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RGB_MATRIX_AUDIO_BANDS 16
+
+#ifndef RGB_MATRIX_AUDIO_TIMEOUT_MS
+#    define RGB_MATRIX_AUDIO_TIMEOUT_MS 200
+#endif
+
+typedef struct {
+    uint8_t  level;                        // overall loudness, 0 - 255 log scale
+    uint8_t  band[RGB_MATRIX_AUDIO_BANDS]; // band energies from low to high frequency, 0 - 255 log scale
+    uint32_t timestamp;                    // sync_timer_read32() at publish time
+} rgb_matrix_audio_t;
+
+/* Publish a new analysis frame. Single writer, never blocks, so it is safe to call
+ * from the audio feed task.
+ */
+void rgb_matrix_audio_publish(const rgb_matrix_audio_t *frame);
+
+/* Copy the latest frame. Never blocks the writer. Returns false and a silent frame when
+ * nothing was published for RGB_MATRIX_AUDIO_TIMEOUT_MS, e.g. while speech recognition is stopped.
+ */
+bool rgb_matrix_audio_read(rgb_matrix_audio_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,121 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_RGB_MATRIX_BENCHMARK
+
+#include <inttypes.h>
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "rgb_matrix.h"
+#include "rgb_matrix_bench.h"
+
+static const char *TAG = "rgb_matrix_bench";
+
+typedef struct {
+    uint8_t     effect;
+    const char *name;
+    bool        redraw; // render with init set on every frame
+} bench_effect_t;
+
+static const bench_effect_t bench_effects[] = {
+    {RGB_MATRIX_SOLID_COLOR, "solid color", false},
+#ifdef CONFIG_ENABLE_RGB_MATRIX_CYCLE_PINWHEEL
+    {RGB_MATRIX_CYCLE_PINWHEEL, "cycle pinwheel", false},
+#endif
+#ifdef CONFIG_ENABLE_RGB_MATRIX_RAINBOW_PINWHEELS
+    {RGB_MATRIX_RAINBOW_PINWHEELS, "rainbow pinwheels", false},
+#endif
+#ifdef CONFIG_ENABLE_RGB_MATRIX_CYCLE_SPIRAL
+    {RGB_MATRIX_CYCLE_SPIRAL, "cycle spiral", false},
+#endif
+#ifdef CONFIG_ENABLE_RGB_MATRIX_BAND_SPIRAL_VAL
+    {RGB_MATRIX_BAND_SPIRAL_VAL, "band spiral val", false},
+#endif
+#ifdef CONFIG_ENABLE_RGB_MATRIX_RAINDROPS
+    {RGB_MATRIX_RAINDROPS, "raindrops", true},
+#endif
+};
+
+static uint32_t bench_effect_cycles(const bench_effect_t *bench, uint16_t frames)
+{
+    effect_params_t params = {0, LED_FLAG_ALL, true};
+    uint32_t        total  = 0;
+
+    for (uint16_t frame = 0; frame < frames; frame++) {
+        g_rgb_timer += RGB_MATRIX_LED_FLUSH_LIMIT;
+        params.iter = 0;
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        while (rgb_matrix_render_effect(bench->effect, &params)) {
+            params.iter++;
+        }
+        total += esp_cpu_get_cycle_count() - start;
+
+        params.init = bench->redraw;
+    }
+    return total / frames;
+}
+
+static uint32_t bench_kernel_cycles(uint16_t frames)
+{
+    static uint8_t h[COLOR_BATCH_ALIGN(CONFIG_MATRIX_LED_COUNT)] __attribute__((aligned(16)));
+    static uint8_t s[COLOR_BATCH_ALIGN(CONFIG_MATRIX_LED_COUNT)] __attribute__((aligned(16)));
+    static uint8_t v[COLOR_BATCH_ALIGN(CONFIG_MATRIX_LED_COUNT)] __attribute__((aligned(16)));
+    static RGB     rgb[COLOR_BATCH_ALIGN(CONFIG_MATRIX_LED_COUNT)] __attribute__((aligned(16)));
+
+    for (int i = 0; i < CONFIG_MATRIX_LED_COUNT; i++) {
+        h[i] = i * 7;
+        s[i] = 255 - i;
+        v[i] = 128 + i;
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (uint16_t frame = 0; frame < frames; frame++) {
+        hsv_to_rgb_batch(h, s, v, rgb, CONFIG_MATRIX_LED_COUNT);
+        scale8_batch((uint8_t *)rgb, 200, CONFIG_MATRIX_LED_COUNT * sizeof(RGB));
+    }
+    return (esp_cpu_get_cycle_count() - start) / frames;
+}
+
+void rgb_matrix_benchmark_run(uint16_t frames)
+{
+    uint32_t timer = g_rgb_timer;
+
+    if (frames == 0) {
+        frames = 1;
+    }
+
+    ESP_LOGI(TAG, "cycles per frame, %d LEDs, %u frames (per-LED / batch scalar / batch simd)", CONFIG_MATRIX_LED_COUNT, frames);
+    for (size_t i = 0; i < sizeof(bench_effects) / sizeof(bench_effects[0]); i++) {
+        uint32_t cycles[3] = {0};
+
+        rgb_matrix_set_hsv_batch(false);
+        cycles[0] = bench_effect_cycles(&bench_effects[i], frames);
+
+        rgb_matrix_set_hsv_batch(true);
+        color_batch_use_simd(false);
+        cycles[1] = bench_effect_cycles(&bench_effects[i], frames);
+
+        if (color_batch_simd_available()) {
+            color_batch_use_simd(true);
+            cycles[2] = bench_effect_cycles(&bench_effects[i], frames);
+        }
+
+        ESP_LOGI(TAG, "%-20s %8" PRIu32 " %8" PRIu32 " %8" PRIu32, bench_effects[i].name, cycles[0], cycles[1], cycles[2]);
+    }
+
+    color_batch_use_simd(false);
+    uint32_t scalar = bench_kernel_cycles(frames);
+    color_batch_use_simd(true);
+    uint32_t simd = color_batch_simd_available() ? bench_kernel_cycles(frames) : 0;
+    ESP_LOGI(TAG, "%-20s %8s %8" PRIu32 " %8" PRIu32, "hsv->rgb + scale8", "-", scalar, simd);
+
+    g_rgb_timer = timer;
+}
+
+#endif // CONFIG_RGB_MATRIX_BENCHMARK
@@ -0,0 +1,16 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/* Render the heavy effects off-screen and log the average CPU cycles per frame for the
+ * per-LED, batched scalar and batched PIE conversion paths.
+ * Must be called from the task that runs rgb_matrix_task(), after rgb_matrix_init().
+ * Only built with CONFIG_RGB_MATRIX_BENCHMARK.
+ */
+void rgb_matrix_benchmark_run(uint16_t frames);
@@ -17,11 +17,15 @@
 #include "rgb_matrix_drivers.h"
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
 #include "led_strip.h"
 #if defined(RGB_MATRIX_ENABLE) && defined(RGB_MATRIX_SPLIT)
 #include "keyboard.h"
 #endif
 #include "color.h"
+#include "color_batch.h"
+#include "rgb_matrix_output.h"
 // #include "util.h"
 
 /* Each driver needs to define the struct
@@ -40,20 +44,45 @@ static led_strip_handle_t led_strip = NULL;
 static uint32_t led_count = 0;
 rgb_led_t *rgb_matrix_ws2812_array = NULL;
 bool      ws2812_dirty = false;
+// Frame after gamma and current limiting, rgb_matrix_ws2812_array keeps the rendered values
+static RGB led_output[COLOR_BATCH_ALIGN(CONFIG_MATRIX_LED_COUNT)] __attribute__((aligned(16)));
 
 static void init(void)
 {
     ws2812_dirty = false;
 }
 
+void rgb_matrix_driver_load_frame(const RGB *frame, uint16_t count)
+{
+    if (count > led_count) {
+        count = led_count;
+    }
+    rgb_matrix_output_apply(frame, led_output, count);
+    for (int i = 0; i < count; i++) {
+        led_strip_set_pixel(led_strip, i, led_output[i].r, led_output[i].g, led_output[i].b);
+    }
+}
+
+void rgb_matrix_driver_refresh(void)
+{
+    led_strip_refresh(led_strip);
+}
+
 static void flush(void)
 {
     if (ws2812_dirty) {
-        led_strip_refresh(led_strip);
+        rgb_matrix_driver_load_frame(rgb_matrix_ws2812_array, led_count);
+        rgb_matrix_driver_refresh();
         ws2812_dirty = false;
     }
 }
 
+void rgb_matrix_driver_redraw(void)
+{
+    ws2812_dirty = true;
+    flush();
+}
+
 // Set an led in the buffer to a color
 static inline void setled(int i, uint8_t r, uint8_t g, uint8_t b)
 {
@@ -70,8 +99,13 @@ static inline void setled(int i, uint8_t r, uint8_t g, uint8_t b)
     }
 #    endif
 
+    if (i >= led_count) {
+        return;
+    }
+    rgb_matrix_ws2812_array[i].r = r;
+    rgb_matrix_ws2812_array[i].g = g;
+    rgb_matrix_ws2812_array[i].b = b;
     ws2812_dirty                 = true;
-    led_strip_set_pixel(led_strip, i, r, g, b);
 
 #    ifdef RGBW
     convert_rgb_to_rgbw(&rgb_matrix_ws2812_array[i]);
@@ -94,7 +128,13 @@ const rgb_matrix_driver_t rgb_matrix_driver = {
 
 void rgb_matrix_driver_init(led_strip_handle_t handle, uint32_t strip_num)
 {
+    if (strip_num > CONFIG_MATRIX_LED_COUNT) {
+        strip_num = CONFIG_MATRIX_LED_COUNT;
+    }
     led_strip = handle;
-    led_count = strip_num;
-    rgb_matrix_ws2812_array = (rgb_led_t *)malloc(strip_num * sizeof(rgb_led_t));
+    // Called again when the strip moves to another backend, the frame survives the switch
+    if (!rgb_matrix_ws2812_array) {
+        rgb_matrix_ws2812_array = (rgb_led_t *)calloc(CONFIG_MATRIX_LED_COUNT, sizeof(rgb_led_t));
+    }
+    led_count = rgb_matrix_ws2812_array ? strip_num : 0;
 }
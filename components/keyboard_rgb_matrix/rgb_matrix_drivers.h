@@ -6,6 +6,7 @@
 #include <stdint.h>
 
 #include "led_strip.h"
+#include "color.h"
 
 typedef struct {
     /* Perform any initialisation required for the other driver functions to work. */
@@ -21,3 +22,13 @@ typedef struct {
 extern const rgb_matrix_driver_t rgb_matrix_driver;
 
 void rgb_matrix_driver_init(led_strip_handle_t handle, uint32_t strip_num);
+
+/* Put a complete frame from outside the effect pipeline, e.g. one streamed from a host, through
+ * the output stage into the strip encode buffer. rgb_matrix_driver_refresh() sends it out.
+ * Must not run concurrently with rgb_matrix_task().
+ */
+void rgb_matrix_driver_load_frame(const RGB *frame, uint16_t count);
+void rgb_matrix_driver_refresh(void);
+
+// Send the last rendered effect frame again, e.g. after a streamed frame replaced it
+void rgb_matrix_driver_redraw(void);
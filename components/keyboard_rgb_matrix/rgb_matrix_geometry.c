@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "rgb_matrix.h"
+#include "rgb_matrix_geometry.h"
+#include "lib8tion/lib8tion.h"
+
+#define KEY_COUNT (CONFIG_MATRIX_ROWS * CONFIG_MATRIX_COLS)
+
+static const char *TAG = "rgb_matrix_geometry";
+
+led_polar_t g_led_polar;
+
+#ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
+// Lower triangle of the LED to LED distance matrix, pair (a, b) with a < b at b * (b - 1) / 2 + a
+static uint8_t led_distance[CONFIG_MATRIX_LED_COUNT * (CONFIG_MATRIX_LED_COUNT - 1) / 2];
+#endif
+
+#if defined(RGB_MATRIX_FRAMEBUFFER_EFFECTS) && defined(CONFIG_ENABLE_RGB_MATRIX_TYPING_HEATMAP)
+// Neighbors of key k are neighbors[neighbor_start[k] .. neighbor_start[k + 1])
+static uint16_t        neighbor_start[KEY_COUNT + 1];
+static led_neighbor_t *neighbors = NULL;
+#endif
+
+static uint8_t led_point_distance(led_point_t a, led_point_t b)
+{
+    int16_t dx = a.x - b.x;
+    int16_t dy = a.y - b.y;
+    return sqrt16(dx * dx + dy * dy);
+}
+
+uint8_t rgb_matrix_led_distance(uint8_t led_a, uint8_t led_b)
+{
+    if (led_a == led_b) {
+        return 0;
+    }
+#ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
+    if (led_a > led_b) {
+        uint8_t tmp = led_a;
+        led_a       = led_b;
+        led_b       = tmp;
+    }
+    return led_distance[led_b * (led_b - 1) / 2 + led_a];
+#else
+    return led_point_distance(g_led_config.point[led_a], g_led_config.point[led_b]);
+#endif
+}
+
+#if defined(RGB_MATRIX_FRAMEBUFFER_EFFECTS) && defined(CONFIG_ENABLE_RGB_MATRIX_TYPING_HEATMAP)
+static uint16_t key_neighbors_scan(uint8_t row, uint8_t col, led_neighbor_t *out)
+{
+    uint8_t  led   = g_led_config.matrix_co[row][col];
+    uint16_t count = 0;
+
+    if (led == NO_LED) {
+        return 0;
+    }
+    for (uint8_t i_row = 0; i_row < CONFIG_MATRIX_ROWS; i_row++) {
+        for (uint8_t i_col = 0; i_col < CONFIG_MATRIX_COLS; i_col++) {
+            uint8_t other = g_led_config.matrix_co[i_row][i_col];
+            if (other == NO_LED || (i_row == row && i_col == col)) {
+                continue;
+            }
+            uint8_t dist = rgb_matrix_led_distance(led, other);
+            if (dist > RGB_MATRIX_TYPING_HEATMAP_SPREAD) {
+                continue;
+            }
+            if (out) {
+                out[count].row  = i_row;
+                out[count].col  = i_col;
+                out[count].dist = dist;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+static void geometry_build_neighbors(void)
+{
+    uint16_t total = 0;
+
+    free(neighbors);
+    neighbors = NULL;
+
+    for (uint8_t row = 0; row < CONFIG_MATRIX_ROWS; row++) {
+        for (uint8_t col = 0; col < CONFIG_MATRIX_COLS; col++) {
+            neighbor_start[row * CONFIG_MATRIX_COLS + col] = total;
+            total += key_neighbors_scan(row, col, NULL);
+        }
+    }
+    neighbor_start[KEY_COUNT] = total;
+
+    if (total) {
+        neighbors = malloc(total * sizeof(led_neighbor_t));
+    }
+    if (!neighbors) {
+        ESP_LOGE(TAG, "no memory for %d heatmap neighbors", total);
+        memset(neighbor_start, 0, sizeof(neighbor_start));
+        return;
+    }
+    for (uint8_t row = 0; row < CONFIG_MATRIX_ROWS; row++) {
+        for (uint8_t col = 0; col < CONFIG_MATRIX_COLS; col++) {
+            key_neighbors_scan(row, col, &neighbors[neighbor_start[row * CONFIG_MATRIX_COLS + col]]);
+        }
+    }
+    ESP_LOGI(TAG, "%d heatmap neighbors within %d", total, RGB_MATRIX_TYPING_HEATMAP_SPREAD);
+}
+#endif
+
+const led_neighbor_t *rgb_matrix_key_neighbors(uint8_t row, uint8_t col, uint16_t *count)
+{
+#if defined(RGB_MATRIX_FRAMEBUFFER_EFFECTS) && defined(CONFIG_ENABLE_RGB_MATRIX_TYPING_HEATMAP)
+    uint16_t key = row * CONFIG_MATRIX_COLS + col;
+    *count       = neighbor_start[key + 1] - neighbor_start[key];
+    return *count ? &neighbors[neighbor_start[key]] : NULL;
+#else
+    *count = 0;
+    return NULL;
+#endif
+}
+
+void rgb_matrix_geometry_init(void)
+{
+    for (uint8_t i = 0; i < CONFIG_MATRIX_LED_COUNT; i++) {
+        int16_t dx           = g_led_config.point[i].x - k_rgb_matrix_center.x;
+        int16_t dy           = g_led_config.point[i].y - k_rgb_matrix_center.y;
+        g_led_polar.dist[i]  = sqrt16(dx * dx + dy * dy);
+        g_led_polar.angle[i] = atan2_8(dy, dx);
+    }
+
+#ifdef RGB_MATRIX_KEYREACTIVE_ENABLED
+    for (uint8_t b = 1; b < CONFIG_MATRIX_LED_COUNT; b++) {
+        for (uint8_t a = 0; a < b; a++) {
+            led_distance[b * (b - 1) / 2 + a] = led_point_distance(g_led_config.point[a], g_led_config.point[b]);
+        }
+    }
+#endif
+
+#if defined(RGB_MATRIX_FRAMEBUFFER_EFFECTS) && defined(CONFIG_ENABLE_RGB_MATRIX_TYPING_HEATMAP)
+    geometry_build_neighbors();
+#endif
+}
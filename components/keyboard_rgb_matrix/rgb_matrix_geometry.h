@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "rgb_matrix_types.h"
+
+// Position of every LED relative to k_rgb_matrix_center
+typedef struct {
+    uint8_t dist[CONFIG_MATRIX_LED_COUNT];  // sqrt16(dx * dx + dy * dy)
+    uint8_t angle[CONFIG_MATRIX_LED_COUNT]; // atan2_8(dy, dx)
+} led_polar_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t row;
+    uint8_t col;
+    uint8_t dist;
+} led_neighbor_t;
+
+extern led_polar_t g_led_polar;
+
+/* Build the geometry tables from g_led_config, called once from rgb_matrix_init().
+ * Effects read them instead of running sqrt16()/atan2_8() for every LED on every frame.
+ */
+void rgb_matrix_geometry_init(void);
+
+// Distance between two LEDs, same value as sqrt16() over their points
+uint8_t rgb_matrix_led_distance(uint8_t led_a, uint8_t led_b);
+
+/* Other keys with an LED no further than RGB_MATRIX_TYPING_HEATMAP_SPREAD from the LED
+ * of the key at (row, col). Returns NULL and a count of 0 for keys without an LED.
+ */
+const led_neighbor_t *rgb_matrix_key_neighbors(uint8_t row, uint8_t col, uint16_t *count);
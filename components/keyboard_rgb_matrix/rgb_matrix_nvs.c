@@ -11,14 +11,31 @@
 #include "nvs.h"
 #include "rgb_matrix_types.h"
 #include "rgb_matrix.h"
+#include "rgb_matrix_nvs.h"
 
 #define NAME_SPACE "sys_param"
 #define KEY "rgb_matrix"
 
 static const char *TAG = "rgb_matrix_nvs";
 
+static const rgb_matrix_store_t *s_store = NULL;
+
+void rgb_matrix_nvs_set_store(const rgb_matrix_store_t *store)
+{
+    s_store = store;
+}
+
 esp_err_t nvs_init_rgb_matrix()
 {
+    if (s_store) {
+        esp_err_t ret = s_store->load(&rgb_matrix_config);
+        if (ESP_ERR_NOT_FOUND == ret) {
+            ESP_LOGW(TAG, "No stored config");
+            return ESP_OK;
+        }
+        return ret;
+    }
+
     nvs_handle_t my_handle = 0;
     esp_err_t ret = nvs_open(NAME_SPACE, NVS_READONLY, &my_handle);
     if (ESP_ERR_NVS_NOT_FOUND == ret) {
@@ -43,6 +60,9 @@ err:
 
 esp_err_t nvs_flush_rgb_matrix(bool if_flush)
 {
+    if (if_flush && s_store) {
+        return s_store->save(&rgb_matrix_config);
+    }
     if (if_flush) {
         ESP_LOGI(TAG, "Saving settings");
         nvs_handle_t my_handle = {0};
@@ -0,0 +1,34 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_log.h"
+#include "rgb_matrix_types.h"
+
+/* Storage for rgb_matrix_config supplied by the application, for example to keep it
+ * in one blob with other settings or to defer the flash writes.
+ */
+typedef struct {
+    // Read the stored config, ESP_ERR_NOT_FOUND if there is none
+    esp_err_t (*load)(rgb_config_t *config);
+    // Store the config, the write to flash may happen later
+    esp_err_t (*save)(const rgb_config_t *config);
+} rgb_matrix_store_t;
+
+// Use store instead of the "rgb_matrix" NVS key, call before rgb_matrix_init(). NULL restores NVS.
+void rgb_matrix_nvs_set_store(const rgb_matrix_store_t *store);
+
+esp_err_t nvs_init_rgb_matrix();
+
+esp_err_t nvs_flush_rgb_matrix(bool if_flush);
+
+#ifdef __cplusplus
+}
+#endif
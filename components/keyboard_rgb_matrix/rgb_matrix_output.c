@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include "sdkconfig.h"
+#include "rgb_matrix_output.h"
+#include "color_batch.h"
+
+static uint8_t  gamma_table[256];
+static uint32_t requested_current_ma;
+static uint32_t output_current_ma;
+
+void rgb_matrix_output_init(void)
+{
+    for (int i = 0; i < 256; i++) {
+#ifdef CONFIG_RGB_MATRIX_GAMMA
+        gamma_table[i] = lroundf(powf(i / 255.0f, CONFIG_RGB_MATRIX_GAMMA_X10 / 10.0f) * 255.0f);
+        // Keep the dimmest levels lit, otherwise fades end in a visible step to black
+        if (i && !gamma_table[i]) {
+            gamma_table[i] = 1;
+        }
+#else
+        gamma_table[i] = i;
+#endif
+    }
+}
+
+uint32_t rgb_matrix_output_apply(const RGB *in, RGB *out, uint16_t count)
+{
+    const uint8_t *src   = (const uint8_t *)in;
+    uint8_t       *dst   = (uint8_t *)out;
+    uint32_t       total = 0;
+
+    for (uint32_t i = 0; i < count * sizeof(RGB); i++) {
+        dst[i] = gamma_table[src[i]];
+        total += dst[i];
+    }
+
+    uint32_t idle_ma = count * CONFIG_RGB_MATRIX_LED_IDLE_MA;
+    requested_current_ma = idle_ma + total * CONFIG_RGB_MATRIX_LED_CHANNEL_MA / 255;
+    output_current_ma    = requested_current_ma;
+
+#if CONFIG_RGB_MATRIX_CURRENT_LIMIT_MA > 0
+    // All black (or channels drawing nothing) leaves only the idle current, there is nothing to scale
+    uint64_t channel_ma = (uint64_t)total * CONFIG_RGB_MATRIX_LED_CHANNEL_MA;
+    if (requested_current_ma > CONFIG_RGB_MATRIX_CURRENT_LIMIT_MA && channel_ma) {
+        uint32_t budget_ma = CONFIG_RGB_MATRIX_CURRENT_LIMIT_MA > idle_ma ? CONFIG_RGB_MATRIX_CURRENT_LIMIT_MA - idle_ma : 0;
+        // scale8() multiplies by scale / 256, round down so the result stays inside the budget
+        uint8_t scale = budget_ma ? (uint64_t)budget_ma * 255 * 256 / channel_ma : 0;
+
+        scale8_batch(dst, scale, count * sizeof(RGB));
+        output_current_ma = idle_ma + (total * scale >> 8) * CONFIG_RGB_MATRIX_LED_CHANNEL_MA / 255;
+    }
+#endif
+
+    return output_current_ma;
+}
+
+void rgb_matrix_output_get_current(uint32_t *requested_ma, uint32_t *output_ma)
+{
+    if (requested_ma) {
+        *requested_ma = requested_current_ma;
+    }
+    if (output_ma) {
+        *output_ma = output_current_ma;
+    }
+}
@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "color.h"
+
+/* Final stage between the rendered frame and the LED strip. Every channel goes through a
+ * gamma lookup table, then the whole frame is dimmed evenly when its estimated current is
+ * above CONFIG_RGB_MATRIX_CURRENT_LIMIT_MA.
+ */
+
+// Build the gamma table, called from rgb_matrix_init()
+void rgb_matrix_output_init(void);
+
+// Convert `count` pixels from `in` to `out`, returns the estimated current of `out` in mA
+uint32_t rgb_matrix_output_apply(const RGB *in, RGB *out, uint16_t count);
+
+// Estimated current of the last frame in mA, as rendered and as sent after limiting
+void rgb_matrix_output_get_current(uint32_t *requested_ma, uint32_t *output_ma);
@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "color.h"
+#include "color_batch.h"
 #include "sdkconfig.h"
 // #include "util.h"
 
@@ -77,6 +78,17 @@ typedef struct __attribute__((packed))
     uint8_t     flags[CONFIG_MATRIX_LED_COUNT];
 } led_config_t;
 
+#ifdef CONFIG_RGB_MATRIX_HSV_BATCH
+#    define RGB_MATRIX_HSV_FRAME_LEN COLOR_BATCH_ALIGN(CONFIG_MATRIX_LED_COUNT)
+
+// Struct-of-arrays HSV frame, each channel padded to whole vector lanes
+typedef struct {
+    uint8_t h[RGB_MATRIX_HSV_FRAME_LEN] __attribute__((aligned(16)));
+    uint8_t s[RGB_MATRIX_HSV_FRAME_LEN] __attribute__((aligned(16)));
+    uint8_t v[RGB_MATRIX_HSV_FRAME_LEN] __attribute__((aligned(16)));
+} hsv_frame_t;
+#endif // CONFIG_RGB_MATRIX_HSV_BATCH
+
 typedef union {
     uint64_t raw;
     struct __attribute__((packed)) {
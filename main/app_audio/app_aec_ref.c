@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "bsp_audio.h"
+#include "app_aec_ref.h"
+
+static const char *TAG = "app_aec_ref";
+
+// Frames, above the I2S DMA depth plus the largest block the player writes at once
+#define AEC_REF_SIZE (8192)
+
+static SemaphoreHandle_t s_lock = NULL;
+static int16_t *s_ring = NULL;
+static size_t s_tail;
+static size_t s_count;
+static uint32_t s_rate = 16000;
+static int s_bits = 16;
+static int s_channels = 2;
+// A run of playback starts s_mark frames into the queue, the reader places it in the capture
+// once bsp_i2s_tx_run_start() returns s_run_seq. Only the latest run is marked, an earlier one the
+// reader has not reached yet just continues the one before it.
+static bool s_run_marked = false;
+static size_t s_mark;
+static uint32_t s_run_seq;
+static uint32_t s_dropped;
+
+esp_err_t app_aec_ref_init(void)
+{
+    if (s_lock)
+    {
+        return ESP_OK;
+    }
+    s_ring = heap_caps_malloc(AEC_REF_SIZE * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_lock = s_ring ? xSemaphoreCreateMutex() : NULL;
+    if (s_lock == NULL)
+    {
+        ESP_LOGE(TAG, "No memory for the reference");
+        heap_caps_free(s_ring);
+        s_ring = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void app_aec_ref_set_format(uint32_t sample_rate, int bits, int channels)
+{
+    if (s_lock == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_rate = sample_rate;
+    s_bits = bits;
+    s_channels = channels < 1 ? 1 : channels;
+    s_count = 0;
+    s_run_marked = false;
+    xSemaphoreGive(s_lock);
+}
+
+static inline void aec_ref_push(int16_t sample)
+{
+    if (s_count == AEC_REF_SIZE)
+    {
+        s_dropped++;
+        return;
+    }
+    size_t head = s_tail + s_count;
+    s_ring[head < AEC_REF_SIZE ? head : head - AEC_REF_SIZE] = sample;
+    s_count++;
+}
+
+void app_aec_ref_write(const void *data, size_t len)
+{
+    if (s_lock == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t frames = len / (s_channels * s_bits / 8);
+    if (bsp_i2s_tx_idle())
+    {
+        // This block starts a run, the DMA output is contiguous from here on, so is the reference
+        uint32_t frame;
+        s_run_seq = bsp_i2s_tx_run_start(&frame) + 1;
+        s_mark = s_count;
+        s_run_marked = true;
+    }
+    if (s_bits == 16)
+    {
+        const int16_t *pcm = data;
+        for (size_t i = 0; i < frames; i++, pcm += s_channels)
+        {
+            aec_ref_push(s_channels > 1 ? (pcm[0] + pcm[1]) >> 1 : pcm[0]);
+        }
+    }
+    else if (s_bits == 32)
+    {
+        const int32_t *pcm = data;
+        for (size_t i = 0; i < frames; i++, pcm += s_channels)
+        {
+            aec_ref_push(s_channels > 1 ? ((pcm[0] >> 16) + (pcm[1] >> 16)) >> 1 : pcm[0] >> 16);
+        }
+    }
+    else
+    {
+        // Other widths are not mirrored, the frames still count for the alignment
+        for (size_t i = 0; i < frames; i++)
+        {
+            aec_ref_push(0);
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static inline void aec_ref_skip(size_t frames)
+{
+    frames = frames < s_count ? frames : s_count;
+    s_tail = s_tail + frames < AEC_REF_SIZE ? s_tail + frames : s_tail + frames - AEC_REF_SIZE;
+    s_count -= frames;
+}
+
+void app_aec_ref_read(int16_t *out, int samples, int stride)
+{
+    int n = 0;
+    uint32_t dropped = 0;
+    // Capture frame of out[0]
+    uint32_t position = bsp_i2s_rx_position() - samples;
+
+    if (s_lock)
+    {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        while (n < samples)
+        {
+            if (s_run_marked && s_mark == 0)
+            {
+                uint32_t frame;
+                if (bsp_i2s_tx_run_start(&frame) != s_run_seq)
+                {
+                    // Not sent yet, none of it is in this capture
+                    break;
+                }
+                int32_t ahead = (int32_t)(frame + AEC_REF_DELAY_MS * s_rate / 1000 - (position + n));
+                if (ahead > 0)
+                {
+                    // Captured before the run started
+                    for (int k = ahead < samples - n ? ahead : samples - n; k > 0; k--)
+                    {
+                        out[n++ * stride] = 0;
+                    }
+                    continue;
+                }
+                // Read before the run was sent, up to a descriptor of its start has no reference
+                aec_ref_skip(-ahead);
+                s_run_marked = false;
+                dropped = s_dropped;
+                s_dropped = 0;
+                continue;
+            }
+            if (s_count == 0)
+            {
+                break;
+            }
+            out[n++ * stride] = s_ring[s_tail];
+            s_tail = s_tail + 1 < AEC_REF_SIZE ? s_tail + 1 : 0;
+            s_count--;
+            if (s_run_marked)
+            {
+                s_mark--;
+            }
+        }
+        xSemaphoreGive(s_lock);
+    }
+    if (dropped)
+    {
+        ESP_LOGW(TAG, "%" PRIu32 " reference frames dropped, the feed task fell behind", dropped);
+    }
+    for (; n < samples; n++)
+    {
+        out[n * stride] = 0;
+    }
+}
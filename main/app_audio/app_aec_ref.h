@@ -0,0 +1,47 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Echo cancellation reference taken from the playback. Every block written to the I2S output
+ * is mixed to mono and queued, the feed task takes one sample per captured frame. Playback
+ * and capture share the I2S clock, so within a run of playback the queue stays frame aligned
+ * with the microphones, and reads return silence while nothing plays.
+ *
+ * Where a run starts is taken from the I2S TX on_sent callback, see bsp_i2s_tx_run_start(): the
+ * capture frame its first DMA descriptor went out with. That places the reference up to one
+ * descriptor, 4 ms, ahead of the sound leaving the codec, never behind it.
+ *
+ * app_aec_ref_write() is called from the playback side right before bsp_i2s_write(),
+ * app_aec_ref_read() from the feed task right after bsp_i2s_read().
+ */
+
+// Added to the measured start of a run, for the DAC, ADC and acoustic path. Left at 0, their
+// 1 to 2 ms stay inside the AEC filter with the reference a little ahead of the echo.
+#define AEC_REF_DELAY_MS (0)
+
+esp_err_t app_aec_ref_init(void);
+
+/**
+ * @brief Format of the I2S output, set before the first write. The queued reference is dropped.
+ */
+void app_aec_ref_set_format(uint32_t sample_rate, int bits, int channels);
+
+/**
+ * @brief Queue the reference for a block about to be written to the I2S output.
+ */
+void app_aec_ref_write(const void *data, size_t len);
+
+/**
+ * @brief Reference for the samples frames bsp_i2s_read() just returned, written to every
+ *        stride-th sample of out.
+ */
+void app_aec_ref_read(int16_t *out, int samples, int stride);
@@ -0,0 +1,250 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_record.h"
+#include "baidu_api.h"
+#include "app_asr.h"
+
+static const char *TAG = "app_asr";
+
+// Bytes per HTTP chunk, 64 ms of PCM
+#define ASR_CHUNK_SIZE        (2 * 1024)
+// How often a waiting upload checks for app_asr_cancel()
+#define ASR_POLL_MS           (100)
+// The feed task records every 32 ms, a longer gap means the recording stalled
+#define ASR_UNDERRUN_MS       (3000)
+#define ASR_RESULT_TIMEOUT_MS (10000)
+
+typedef struct
+{
+    app_record_cursor_t cursor;
+    SemaphoreHandle_t done;
+    volatile bool cancelled;
+    esp_err_t result;
+    char *text;
+    int refs;
+    // Benchmark, written by asr_task only
+    size_t sent_bytes;
+    int64_t upload_us;
+} asr_session_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static asr_session_t *s_session = NULL;
+
+static void asr_release(asr_session_t *session)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool last = --session->refs == 0;
+    xSemaphoreGive(s_lock);
+    if (last)
+    {
+        free(session->text);
+        vSemaphoreDelete(session->done);
+        free(session);
+    }
+}
+
+/* The throughput the upload reached. It is a lower bound, writes also wait for the microphone
+ * while the user speaks.
+ */
+static void asr_log_benchmark(const asr_session_t *session)
+{
+    if (session->sent_bytes == 0 || session->upload_us <= 0)
+    {
+        return;
+    }
+    int64_t audio_ms = (int64_t)session->sent_bytes * 1000 / (APP_RECORD_SAMPLE_RATE * sizeof(int16_t));
+    ESP_LOGI(TAG, "%lld ms of audio, %u bytes, upload %lld B/s, %lld ms in writes",
+             audio_ms, (unsigned)session->sent_bytes,
+             (int64_t)session->sent_bytes * 1000000 / session->upload_us, session->upload_us / 1000);
+}
+
+static esp_err_t asr_send(asr_session_t *session, baidu_asr_upload_t *upload, const void *data, size_t len)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = baidu_asr_upload_write(upload, data, len);
+    session->upload_us += esp_timer_get_time() - start_us;
+    session->sent_bytes += len;
+    return ret;
+}
+
+// Send recorded samples as they are in the recording buffer
+static esp_err_t asr_send_samples(asr_session_t *session, baidu_asr_upload_t *upload,
+                                  const int16_t *samples, size_t count)
+{
+    esp_err_t ret = ESP_OK;
+    size_t n;
+
+    for (size_t i = 0; ret == ESP_OK && !session->cancelled && i < count; i += n)
+    {
+        n = count - i < ASR_CHUNK_SIZE / sizeof(int16_t) ? count - i : ASR_CHUNK_SIZE / sizeof(int16_t);
+        ret = asr_send(session, upload, samples + i, n * sizeof(int16_t));
+    }
+    return ret;
+}
+
+// Follow the recording until it stops, ESP_OK once everything is sent
+static esp_err_t asr_upload(asr_session_t *session, baidu_asr_upload_t *upload)
+{
+    esp_err_t ret = ESP_OK;
+    int idle_ms = 0;
+
+    while (ret == ESP_OK && !session->cancelled)
+    {
+        const int16_t *samples;
+        size_t count;
+        ret = app_record_read(&session->cursor, &samples, &count, pdMS_TO_TICKS(ASR_POLL_MS));
+        if (ret == ESP_ERR_TIMEOUT)
+        {
+            idle_ms += ASR_POLL_MS;
+            ret = idle_ms < ASR_UNDERRUN_MS ? ESP_OK : ESP_ERR_TIMEOUT;
+            continue;
+        }
+        if (ret != ESP_OK || count == 0)
+        {
+            break;
+        }
+        idle_ms = 0;
+        ret = asr_send_samples(session, upload, samples, count);
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Recording not uploaded: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static void asr_task(void *arg)
+{
+    asr_session_t *session = arg;
+    esp_err_t ret = ESP_FAIL;
+    baidu_asr_upload_t *upload = baidu_asr_upload_open(APP_RECORD_SAMPLE_RATE);
+
+    if (upload)
+    {
+        ret = asr_upload(session, upload);
+        if (ret == ESP_OK && !session->cancelled)
+        {
+            asr_log_benchmark(session);
+            ret = baidu_asr_upload_finish(upload, &session->text);
+        }
+        else
+        {
+            baidu_asr_upload_abort(upload);
+        }
+    }
+
+    session->result = ret;
+    xSemaphoreGive(session->done);
+    asr_release(session);
+    vTaskDelete(NULL);
+}
+
+// Take the session out of s_session, called by the task that started it
+static asr_session_t *asr_detach(void)
+{
+    asr_session_t *session = s_session;
+    s_session = NULL;
+    return session;
+}
+
+esp_err_t app_asr_init(void)
+{
+    if (s_lock == NULL)
+    {
+        s_lock = xSemaphoreCreateMutex();
+    }
+    return s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t app_asr_begin(void)
+{
+    if (s_lock == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    app_asr_cancel();
+
+    asr_session_t *session = calloc(1, sizeof(asr_session_t));
+    if (session == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    app_record_cursor_next(&session->cursor);
+    session->done = xSemaphoreCreateBinary();
+    session->refs = 2; // the caller and asr_task
+    if (!session->done ||
+        xTaskCreate(asr_task, "asr_task", 6 * 1024, session, 4, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to start the upload");
+        if (session->done)
+        {
+            vSemaphoreDelete(session->done);
+        }
+        free(session);
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_session = session;
+    return ESP_OK;
+}
+
+esp_err_t app_asr_end(char **text)
+{
+    esp_err_t ret;
+
+    *text = NULL;
+    if (s_lock == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    asr_session_t *session = asr_detach();
+    if (session == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    if (xSemaphoreTake(session->done, pdMS_TO_TICKS(ASR_RESULT_TIMEOUT_MS)) == pdTRUE)
+    {
+        ret = session->result;
+        *text = session->text;
+        session->text = NULL;
+        ESP_LOGI(TAG, "%s %lld ms after the end of speech", ret == ESP_OK ? "Result" : "Upload failed",
+                 (esp_timer_get_time() - start_us) / 1000);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "No result after %d ms", ASR_RESULT_TIMEOUT_MS);
+        session->cancelled = true;
+        ret = ESP_ERR_TIMEOUT;
+    }
+    asr_release(session);
+    return ret;
+}
+
+void app_asr_cancel(void)
+{
+    if (s_lock == NULL)
+    {
+        return;
+    }
+    asr_session_t *session = asr_detach();
+    if (session)
+    {
+        session->cancelled = true;
+        asr_release(session);
+    }
+}
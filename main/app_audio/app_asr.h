@@ -0,0 +1,43 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Speech recognition with the upload running while the user speaks. app_asr_begin() connects
+ * at wake time, an upload task follows the next app_record recording and sends the samples as
+ * HTTP chunks straight from the recording buffer, so after the end of speech only the last
+ * chunk and the answer are left.
+ *
+ * app_asr_begin(), app_asr_end() and app_asr_cancel() must be called from one task.
+ */
+
+/**
+ * @brief Create the session lock, before the task using the calls below starts.
+ */
+esp_err_t app_asr_init(void);
+
+/**
+ * @brief Start a new upload of the next recording, one still running is cancelled.
+ */
+esp_err_t app_asr_begin(void);
+
+/**
+ * @brief End of speech, wait for the result.
+ *
+ * @param text the recognized text to free, NULL if nothing was recognized
+ * @return ESP_OK if the audio was recognized, otherwise the caller should upload the recording
+ *         with baidu_get_asr_result(). ESP_ERR_INVALID_STATE if no upload was started.
+ */
+esp_err_t app_asr_end(char **text);
+
+/**
+ * @brief Drop the upload without waiting for a result.
+ */
+void app_asr_cancel(void);
@@ -23,7 +23,15 @@
 #include "file_iterator.h"
 #include "bsp_keyboard.h"
 #include "app_sr.h"
+#include "app_aec_ref.h"
+#include "app_asr.h"
 #include "app_audio.h"
+#include "app_click.h"
+#include "app_mixer.h"
+#include "app_pcm.h"
+#include "app_prompt.h"
+#include "app_record.h"
+#include "app_tts.h"
 #include "app_wifi.h"
 #include "chatgpt_api.h"
 #include "baidu_api.h"
@@ -33,38 +41,76 @@ static const char *TAG = "app_audio";
 
 #define CONFIG_VOLUME_LEVEL 90
 
-bool record_flag = false;
-uint32_t record_total_len = 0;
-uint32_t file_total_len = 0;
-static uint8_t *record_audio_buffer = NULL;
-uint8_t *audio_rx_buffer = NULL;
 audio_play_finish_cb_t audio_play_finish_cb = NULL;
 
 extern sr_data_t *g_sr_data;
-extern int Cache_WriteBack_Addr(uint32_t addr, uint32_t size);
 
-static esp_err_t audio_mute_function(AUDIO_PLAYER_MUTE_SETTING setting)
+// 混音器有输出时取消静音, 全部声音播完才静音
+static void audio_output_active(bool active)
 {
-    bsp_codec_mute_set(setting == AUDIO_PLAYER_MUTE ? true : false);
+    bsp_codec_mute_set(!active);
     // restore the voice volume upon unmuting
-    if (setting == AUDIO_PLAYER_UNMUTE)
+    if (active)
     {
         bsp_codec_volume_set(CONFIG_VOLUME_LEVEL, NULL);
     }
+}
+
+// 静音由混音器统一控制, 播放器单首结束时不再静音, 以免切掉同时播放的提示音
+static esp_err_t audio_mute_function(AUDIO_PLAYER_MUTE_SETTING setting)
+{
     return ESP_OK;
 }
 
-static esp_err_t audio_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+// 播放器的格式转换状态, 采样率变化时只重设转换, 不再重开编解码器
+static app_pcm_t s_player_pcm;
+
+// 播放器和文件播放各占一路混音, 提示音播放时被压低
+static app_mixer_voice_t *s_player_voice = NULL;
+static app_mixer_voice_t *s_file_voice = NULL;
+
+// 回答在单独的任务中请求和合成, 处理任务随时能响应唤醒并打断它
+typedef struct
 {
-    esp_err_t ret = ESP_OK;
-    ret = bsp_codec_set_fs(rate, bits_cfg, ch);
+    char *question;      // 已识别的问题, 由回答任务释放
+    bool upload_wav;     // 边录边传失败, 整段上传录音
+    uint32_t generation; // chatgpt_generation(), 之后的唤醒取消这个问题
+} answer_item_t;
 
-    bsp_codec_mute_set(true);
-    bsp_codec_mute_set(false);
-    bsp_codec_volume_set(CONFIG_VOLUME_LEVEL, NULL);
-    vTaskDelay(pdMS_TO_TICKS(50));
+static QueueHandle_t s_answer_queue = NULL;
 
-    return ret;
+// The mixer output, the only I2S writer, so the echo reference sees every sample played
+static esp_err_t audio_i2s_write_block(void *audio_buffer, size_t len)
+{
+    size_t bytes_written;
+    app_aec_ref_write(audio_buffer, len);
+    return bsp_i2s_write(audio_buffer, len, &bytes_written, portMAX_DELAY);
+}
+
+// 转换后的16位双声道数据写入各自的混音通道
+static esp_err_t audio_player_voice_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    *bytes_written = len;
+    return app_mixer_voice_write(s_player_voice, audio_buffer, len / (2 * sizeof(int16_t)));
+}
+
+static esp_err_t audio_file_voice_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    *bytes_written = len;
+    return app_mixer_voice_write(s_file_voice, audio_buffer, len / (2 * sizeof(int16_t)));
+}
+
+// I2S时钟固定, 录音不中断; 播放数据按需转换为BSP_I2S_SAMPLE_RATE的16位双声道
+static esp_err_t audio_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    *bytes_written = len;
+    return app_pcm_write(&s_player_pcm, audio_buffer, len);
+}
+
+static esp_err_t audio_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    return app_pcm_init(&s_player_pcm, rate, bits_cfg, ch == I2S_SLOT_MODE_MONO ? 1 : 2, BSP_I2S_SAMPLE_RATE,
+                        audio_player_voice_write);
 }
 
 static void audio_player_cb(audio_player_cb_ctx_t *ctx)
@@ -73,7 +119,8 @@ static void audio_player_cb(audio_player_cb_ctx_t *ctx)
     {
     case AUDIO_PLAYER_CALLBACK_EVENT_IDLE:
         ESP_LOGI(TAG, "Player IDLE");
-        bsp_codec_set_fs(16000, 16, 2);
+        // 文件结束, 送出重采样器中剩余的数据
+        app_pcm_finish(&s_player_pcm);
         if (audio_play_finish_cb)
         {
             audio_play_finish_cb();
@@ -81,6 +128,7 @@ static void audio_player_cb(audio_player_cb_ctx_t *ctx)
         break;
     case AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT:
         ESP_LOGI(TAG, "Player NEXT");
+        app_pcm_finish(&s_player_pcm);
         break;
     case AUDIO_PLAYER_CALLBACK_EVENT_PLAYING:
         ESP_LOGI(TAG, "Player PLAYING");
@@ -96,31 +144,64 @@ static void audio_player_cb(audio_player_cb_ctx_t *ctx)
     }
 }
 
+static void answer_task(void *arg)
+{
+    answer_item_t item;
+
+    while (true)
+    {
+        xQueueReceive(s_answer_queue, &item, portMAX_DELAY);
+        app_wifi_lock(0);
+        if (item.upload_wav)
+        {
+            // 录音缓存在下次唤醒录音时被覆盖, 那时这个问题也已取消
+            size_t wav_len;
+            const uint8_t *wav = app_record_wav(&wav_len);
+            chatgpt_start((uint8_t *)wav, wav_len, item.generation);
+        }
+        else
+        {
+            chatgpt_answer(item.question, item.generation);
+        }
+        app_wifi_unlock();
+        free(item.question);
+    }
+}
+
 void audio_record_init()
 {
 #if DEBUG_SAVE_PCM
-    // 分配录音缓存
-    record_audio_buffer = heap_caps_calloc(1, RECORD_FILE_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    assert(record_audio_buffer);
-    printf("successfully created record_audio_buffer with a size: %zu\r\n", RECORD_FILE_SIZE);
-    // 分配语音合成缓存
-    audio_rx_buffer = heap_caps_calloc(1, MAX_FILE_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    assert(audio_rx_buffer);
-    printf("successfully created audio_rx_buffer with a size: %zu\r\n", MAX_FILE_SIZE);
-#endif
-
-    if (record_audio_buffer == NULL || audio_rx_buffer == NULL)
+    // 分配录音缓存, 包括唤醒前的预录音
+    if (app_record_init(RECORD_FILE_SIZE, RECORD_PREROLL_MS) != ESP_OK)
     {
         printf("Error: Failed to allocate memory for buffers\r\n");
         return;
     }
+#endif
+#if CONFIG_APP_SR_AEC_PLAYBACK
+    // 播放数据的副本作为回声消除的参考通道
+    app_aec_ref_init();
+    app_aec_ref_set_format(BSP_I2S_SAMPLE_RATE, BSP_I2S_BITS, BSP_I2S_TX_CHANNELS);
+#endif
+
+    // 混音器是唯一的I2S写入者, 提示音可叠加在回答上播放
+    ESP_ERROR_CHECK(app_mixer_init(audio_i2s_write_block, audio_output_active));
+    app_mixer_voice_config_t voice_config = {
+        .priority = 0,
+        .gain_db = 0.0f,
+        .duck_db = -12.0f,
+        .stream_frames = 2048,
+    };
+    s_player_voice = app_mixer_voice_new(&voice_config);
+    s_file_voice = app_mixer_voice_new(&voice_config);
+    assert(s_player_voice != NULL && s_file_voice != NULL);
 
     file_iterator_instance_t *file_iterator = file_iterator_new(BSP_SPIFFS_MOUNT_POINT);
     assert(file_iterator != NULL);
 
     audio_player_config_t config = {
         .mute_fn = audio_mute_function,
-        .write_fn = bsp_i2s_write,
+        .write_fn = audio_i2s_write,
         .clk_set_fn = audio_codec_set_fs,
         .priority = 5,
     };
@@ -128,36 +209,29 @@ void audio_record_init()
     audio_player_callback_register(audio_player_cb, NULL);
     ESP_LOGI(TAG, "audio_record_init -----> Audio player initialized");
     
+    // 提示音开机时解码到PSRAM, 之后播放不再读文件
+    app_prompt_init();
+#if CONFIG_APP_KEY_CLICK
+    // 按键音开机时合成, 按下时直接由混音器播放
+    app_click_init();
+#endif
+
+    // 按句合成和回答任务, 在处理任务收到第一个问题前启动
+    ESP_ERROR_CHECK(app_tts_init());
+    s_answer_queue = xQueueCreate(2, sizeof(answer_item_t));
+    assert(s_answer_queue != NULL);
+    BaseType_t ret_val = xTaskCreate(answer_task, "answer_task", 8 * 1024, NULL, 4, NULL);
+    assert(pdPASS == ret_val);
+
     // 开机音效
-    FILE *fp = fopen("/spiffs/powerOn.wav", "r");
-    if (fp)
-    {
-        audio_player_play(fp);
-    }
+    app_prompt_play(APP_PROMPT_POWER_ON, false);
 }
 
 void audio_record_save(int16_t *audio_buffer, int audio_chunksize)
 {
 #if DEBUG_SAVE_PCM
-    if (record_flag)
-    {
-        uint16_t *record_buff = (uint16_t *)(record_audio_buffer + sizeof(wav_header_t));
-        record_buff += record_total_len;
-        for (int i = 0; i < (audio_chunksize - 1); i++)
-        {
-            if (record_total_len < (MAX_FILE_SIZE - sizeof(wav_header_t)) / 2)
-            {
-#if PCM_ONE_CHANNEL
-                record_buff[i * 1 + 0] = audio_buffer[i * 3 + 0];
-                record_total_len += 1;
-#else
-                record_buff[i * 2 + 0] = audio_buffer[i * 3 + 0];
-                record_buff[i * 2 + 1] = audio_buffer[i * 3 + 1];
-                record_total_len += 2;
-#endif
-            }
-        }
-    }
+    // 不录音时也写入预录音环形缓存; 边录边上传直接读取录音缓存
+    app_record_feed(audio_buffer, audio_chunksize, 1);
 #endif
 }
 
@@ -169,64 +243,15 @@ void audio_register_play_finish_cb(audio_play_finish_cb_t cb)
 static void audio_record_start()
 {
 #if DEBUG_SAVE_PCM
-    ESP_LOGI(TAG, "### record Start");
-    audio_player_stop();
-    record_flag = true;
-    record_total_len = 0;
-    file_total_len = sizeof(wav_header_t);
+    app_record_start();
 #endif
 }
 
-static esp_err_t audio_record_stop()
+static void audio_record_stop()
 {
-    esp_err_t ret = ESP_OK;
 #if DEBUG_SAVE_PCM
-    record_flag = false;
-#if PCM_ONE_CHANNEL
-    record_total_len *= 1;
-#else
-    record_total_len *= 2;
-#endif
-    file_total_len += record_total_len;
-    ESP_LOGI(TAG, "### record Stop, %" PRIu32 " %" PRIu32 "K",
-             record_total_len,
-             record_total_len / 1024);
-
-    FILE *fp = fopen("/spiffs/echo_en_wake.wav", "r");
-    ESP_GOTO_ON_FALSE(NULL != fp, ESP_FAIL, err, TAG, "Failed create record file");
-
-    wav_header_t wav_head;
-    int len = fread(&wav_head, 1, sizeof(wav_header_t), fp);
-    ESP_GOTO_ON_FALSE(len > 0, ESP_FAIL, err, TAG, "Failed create record file");
-
-    wav_head.SampleRate = 16000;
-#if PCM_ONE_CHANNEL
-    wav_head.NumChannels = 1;
-#else
-    wav_head.NumChannels = 2;
-#endif
-    wav_head.BitsPerSample = 16;
-    wav_head.ChunkSize = file_total_len - 8;
-    wav_head.ByteRate  = wav_head.SampleRate * wav_head.BitsPerSample * wav_head.NumChannels / 8;
-    wav_head.Subchunk2ID[0] = 'd';
-    wav_head.Subchunk2ID[1] = 'a';
-    wav_head.Subchunk2ID[2] = 't';
-    wav_head.Subchunk2ID[3] = 'a';
-    wav_head.Subchunk2Size = record_total_len;
-    memcpy((void *)record_audio_buffer, &wav_head, sizeof(wav_header_t));
-    Cache_WriteBack_Addr((uint32_t)record_audio_buffer, record_total_len);
-    // 播放录音
-    // FILE *fp1 = NULL;
-    // fp1 = fmemopen((void *)record_audio_buffer, record_total_len, "rb");
-    // if (fp1)
-    //     audio_player_play(fp1);
+    app_record_stop();
 #endif
-err:
-    if (fp)
-    {
-        fclose(fp);
-    }
-    return ret;
 }
 
 esp_err_t audio_play_task(void *filepath)
@@ -237,7 +262,8 @@ esp_err_t audio_play_task(void *filepath)
 
     const size_t chunk_size = 4096;
     uint8_t *buffer = malloc(chunk_size);
-    ESP_GOTO_ON_FALSE(NULL != buffer, ESP_FAIL, EXIT, TAG, "buffer malloc failed");
+    app_pcm_t *pcm = calloc(1, sizeof(app_pcm_t));
+    ESP_GOTO_ON_FALSE(NULL != buffer && NULL != pcm, ESP_FAIL, EXIT, TAG, "buffer malloc failed");
 
     ESP_GOTO_ON_FALSE(-1 != stat(filepath, &file_stat), ESP_FAIL, EXIT, TAG, "Failed to stat file");
 
@@ -259,13 +285,10 @@ esp_err_t audio_play_task(void *filepath)
     }
 
     ESP_LOGI(TAG, "frame_rate= %" PRIi32 ", ch=%d, width=%d", wav_head.SampleRate, wav_head.NumChannels, wav_head.BitsPerSample);
-    bsp_codec_set_fs(wav_head.SampleRate, wav_head.BitsPerSample, I2S_SLOT_MODE_STEREO);
-
-    bsp_codec_mute_set(true);
-    bsp_codec_mute_set(false);
-    bsp_codec_volume_set(CONFIG_VOLUME_LEVEL, NULL);
+    ret = app_pcm_init(pcm, wav_head.SampleRate, wav_head.BitsPerSample, wav_head.NumChannels, BSP_I2S_SAMPLE_RATE,
+                       audio_file_voice_write);
+    ESP_GOTO_ON_ERROR(ret, EXIT, TAG, "Unsupported wav format");
 
-    size_t cnt, total_cnt = 0;
     do
     {
         /* Read file in chunks into the scratch buffer */
@@ -276,10 +299,10 @@ esp_err_t audio_play_task(void *filepath)
         }
         else if (len > 0)
         {
-            bsp_i2s_write(buffer, len, &cnt, portMAX_DELAY);
-            total_cnt += cnt;
+            app_pcm_write(pcm, buffer, len);
         }
     } while (1);
+    app_pcm_finish(pcm);
 
 EXIT:
     if (fp)
@@ -290,6 +313,11 @@ EXIT:
     {
         free(buffer);
     }
+    if (pcm)
+    {
+        app_pcm_free(pcm);
+        free(pcm);
+    }
     return ret;
 }
 
@@ -319,17 +347,19 @@ void sr_handler_task(void *pvParam)
         {
             ESP_LOGI(TAG, "ESP_MN_STATE_TIMEOUT");
             audio_record_stop();// 停止录音
-            FILE *fp = fopen("/spiffs/waitPlease.mp3", "r");
-            if (fp)
+            app_prompt_play(APP_PROMPT_WAIT, false);
+
+            // 录音时已在上传, 只需等待识别结果; 上传失败时再整段上传, 都交给回答任务
+            answer_item_t item = {
+                .question = NULL,
+                .generation = chatgpt_generation(),
+            };
+            item.upload_wav = app_asr_end(&item.question) != ESP_OK;
+            if (WIFI_STATUS_CONNECTED_OK != app_wifi_connected_already() ||
+                s_answer_queue == NULL || xQueueSend(s_answer_queue, &item, 0) != pdTRUE)
             {
-                audio_player_play(fp);
-            }
-            
-            if (WIFI_STATUS_CONNECTED_OK == app_wifi_connected_already())
-            {
-                app_wifi_lock(0);
-                chatgpt_start((uint8_t *)record_audio_buffer, record_total_len);
-                app_wifi_unlock();
+                ESP_LOGW(TAG, "Question dropped");
+                free(item.question);
             }
             continue;
         }
@@ -337,7 +367,17 @@ void sr_handler_task(void *pvParam)
         // 识别到唤醒词
         if (WAKENET_DETECTED == result.wakenet_mode)
         {
-            audio_play_task("/spiffs/echo_cn_wake.wav");
+            // 回声消除后播放时也能唤醒, 打断正在请求, 合成或播放的回答
+            chatgpt_cancel();
+            app_tts_cancel();
+            audio_player_stop();
+            app_mixer_voice_stop(s_player_voice);
+            // 先建立识别连接, 与提示音同时进行
+            if (WIFI_STATUS_CONNECTED_OK == app_wifi_connected_already())
+            {
+                app_asr_begin();
+            }
+            app_prompt_play(APP_PROMPT_WAKE, true);
             audio_record_start();// 开始录音
             continue;
         }
@@ -347,16 +387,25 @@ void sr_handler_task(void *pvParam)
         {
             ESP_LOGE(TAG, "STOP:%d", result.command_id);
             audio_record_stop();// 停止录音
-            audio_play_task("/spiffs/echo_cn_ok.wav");
-            if (WIFI_STATUS_CONNECTED_OK != app_wifi_connected_already())
+            app_prompt_play(APP_PROMPT_OK, true);
+            if (WIFI_STATUS_CONNECTED_OK != app_wifi_connected_already() || result.command_id != 0x55)
+            {
+                app_asr_cancel();
                 continue;
+            }
             switch (result.command_id)
             {
             case 0x55:
                 // 语音转文字
-                app_wifi_lock(0);
-                char *recognition_result = baidu_get_asr_result((uint8_t *)record_audio_buffer, record_total_len);
-                app_wifi_unlock();
+                char *recognition_result = NULL;
+                if (app_asr_end(&recognition_result) != ESP_OK)
+                {
+                    app_wifi_lock(0);
+                    size_t wav_len;
+                    const uint8_t *wav = app_record_wav(&wav_len);
+                    recognition_result = baidu_get_asr_result((uint8_t *)wav, wav_len);
+                    app_wifi_unlock();
+                }
                 if (recognition_result == NULL)
                 {
                     ESP_LOGE(TAG, "0. No text recognized");
@@ -6,10 +6,17 @@
 
 #pragma once
 
+#include "sdkconfig.h"
+
 #define DEBUG_SAVE_PCM      (1)
-#define PCM_ONE_CHANNEL     (1)
 #define RECORD_FILE_SIZE    (250 * 1024)
-#define MAX_FILE_SIZE       (1 * 1024 * 1024)
+// Audio kept from before the recording starts, speech that began during the wake prompt.
+// Only with echo cancellation, otherwise it would hold the prompt itself
+#if CONFIG_APP_SR_AEC_PLAYBACK || CONFIG_APP_SR_AEC_MIC3
+#define RECORD_PREROLL_MS   (500)
+#else
+#define RECORD_PREROLL_MS   (0)
+#endif
 
 typedef struct {
     // The "RIFF" chunk descriptor
@@ -34,11 +41,6 @@ typedef void (*audio_play_finish_cb_t)(void);
 
 void sr_handler_task(void *pvParam);
 
-/**
- * @brief The buffer to hold the recorded audio.
- */
-extern uint8_t *audio_rx_buffer;
-
 esp_err_t audio_play_task(void *filepath);
 
 void audio_record_init();
@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_random.h"
+
+#include "bsp_audio.h"
+#include "app_mixer.h"
+#include "app_click.h"
+
+static const char *TAG = "app_click";
+
+#define CLICK_GRAINS      (6)
+#define CLICK_FRAMES      (BSP_I2S_SAMPLE_RATE / 100) // 10 ms
+#define CLICK_FADE_FRAMES (32)
+#define CLICK_GAIN_DB     (-6.0f)
+
+// Internal RAM, the mixer reads a grain right after the press
+static int16_t s_grains[CLICK_GRAINS][CLICK_FRAMES * 2];
+static app_mixer_voice_t *s_voice = NULL;
+static uint32_t s_last;
+
+static inline float click_rand(uint32_t *state)
+{
+    // xorshift32, uniform in [-1, 1)
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return (int32_t)*state * (1.0f / 2147483648.0f);
+}
+
+/*
+ * A key click is a short broadband tick from the switch followed by a ring of the keycap and
+ * plate: differentiated noise with a ~1 ms decay plus a damped sine of 1.8 to 3.2 kHz. Pitch,
+ * decays, level and a slight pan differ per grain.
+ */
+static void click_synth(int16_t *grain, uint32_t seed)
+{
+    uint32_t state = seed | 1;
+    const float fs = BSP_I2S_SAMPLE_RATE;
+    float freq = 2500.0f + 700.0f * click_rand(&state);
+    float tick_decay = expf(-1.0f / (fs * (0.0008f + 0.0003f * click_rand(&state))));
+    float ring_decay = expf(-1.0f / (fs * (0.0025f + 0.0008f * click_rand(&state))));
+    float level = 0.25f * powf(10.0f, 2.0f * click_rand(&state) / 20.0f); // -12 dBFS, +-2 dB
+    float pan = 0.15f * click_rand(&state);
+
+    float tick = 1.0f;
+    float ring = 0.5f;
+    float phase = 0.0f;
+    float last = 0.0f;
+    for (int i = 0; i < CLICK_FRAMES; i++)
+    {
+        float noise = click_rand(&state);
+        float v = tick * (noise - last) * 0.5f + ring * sinf(phase);
+        last = noise;
+        tick *= tick_decay;
+        ring *= ring_decay;
+        phase += 2.0f * (float)M_PI * freq / fs;
+
+        if (i >= CLICK_FRAMES - CLICK_FADE_FRAMES)
+        {
+            v *= (float)(CLICK_FRAMES - i) / CLICK_FADE_FRAMES;
+        }
+        v *= level * 32767.0f;
+        grain[i * 2] = (int16_t)lrintf(v * (1.0f - pan));
+        grain[i * 2 + 1] = (int16_t)lrintf(v * (1.0f + pan));
+    }
+}
+
+esp_err_t app_click_init(void)
+{
+    if (s_voice)
+    {
+        return ESP_OK;
+    }
+    for (int i = 0; i < CLICK_GRAINS; i++)
+    {
+        click_synth(s_grains[i], esp_random());
+    }
+
+    // Lowest priority so it ducks nothing, and never ducked itself
+    app_mixer_voice_config_t config = {
+        .priority = -1,
+        .gain_db = CLICK_GAIN_DB,
+        .duck_db = 0.0f,
+        .stream_frames = 0,
+    };
+    s_voice = app_mixer_voice_new(&config);
+    ESP_RETURN_ON_FALSE(s_voice, ESP_ERR_NO_MEM, TAG, "No mixer voice");
+    return ESP_OK;
+}
+
+void app_click_play(void)
+{
+    if (s_voice == NULL)
+    {
+        return;
+    }
+    // Never the same grain twice in a row
+    s_last = (s_last + 1 + esp_random() % (CLICK_GRAINS - 1)) % CLICK_GRAINS;
+    app_mixer_voice_play(s_voice, s_grains[s_last], CLICK_FRAMES, false);
+}
@@ -0,0 +1,25 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+/**
+ * Key click feedback. A few click grains are synthesized at boot into internal RAM and played
+ * on their own mixer voice, a press costs a task notification, no file, decoder or codec
+ * access. Each press picks another grain, so fast typing does not sound like a loop.
+ */
+
+/**
+ * @brief Synthesize the grains and take a mixer voice, after app_mixer_init().
+ */
+esp_err_t app_click_init(void);
+
+/**
+ * @brief Play a click, replacing the one playing. Does nothing before app_click_init().
+ */
+void app_click_play(void);
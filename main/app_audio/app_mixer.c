@@ -0,0 +1,350 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "audio_kernels.h"
+#include "bsp_audio.h"
+#include "app_mixer.h"
+
+static const char *TAG = "app_mixer";
+
+#define MIXER_BLOCK_FRAMES (256) // frames mixed and written at once, 16 ms at 16 kHz
+#define MIXER_VOICES_MAX   (4)
+#define MIXER_RAMP_MS      (30)  // gain and ducking changes
+#define MIXER_FRAME_BYTES  (2 * sizeof(int16_t))
+#define MIXER_IDLE_HOLD_MS (2000) // output kept on after the last sound, short sounds skip the unmute
+
+struct app_mixer_voice
+{
+    int priority;
+    int32_t gain;        // Q15
+    int32_t duck;        // Q15, on top of gain while ducked
+    audio_gain_t ramp;   // mixer task only
+    // streaming voices
+    StreamBufferHandle_t stream;
+    size_t chunk_frames; // sent at once, so the stream only ever holds whole frames
+    SemaphoreHandle_t stream_lock;       // the mixer's receive against the producer's reset
+    volatile uint32_t generation;        // bumped by app_mixer_voice_stop()
+    volatile uint32_t write_generation;  // the producer caught up with it, the stream holds nothing older
+    // clip voices, under s_lock
+    const int16_t *clip; // NULL once done
+    size_t clip_frames;
+    size_t clip_pos;
+    TaskHandle_t waiter;
+};
+
+static app_mixer_voice_t s_voices[MIXER_VOICES_MAX];
+static int s_voice_count;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task = NULL;
+static app_mixer_write_fn s_write_fn;
+static app_mixer_active_fn s_active_fn;
+
+static int32_t s_acc[MIXER_BLOCK_FRAMES * 2];
+static int16_t s_voice_buf[MIXER_BLOCK_FRAMES * 2] __attribute__((aligned(16)));
+static int16_t s_out[MIXER_BLOCK_FRAMES * 2];
+
+static inline int32_t mixer_q15(float db)
+{
+    return db >= 0.0f ? AUDIO_GAIN_UNITY : (int32_t)lrintf(AUDIO_GAIN_UNITY * powf(10.0f, db / 20.0f));
+}
+
+static inline int16_t mixer_clip16(int32_t v)
+{
+    return (v > INT16_MAX) ? INT16_MAX : ((v < INT16_MIN) ? INT16_MIN : v);
+}
+
+static bool mixer_voice_pending(app_mixer_voice_t *voice)
+{
+    if (voice->stream)
+    {
+        return xStreamBufferBytesAvailable(voice->stream) > 0;
+    }
+    return voice->clip != NULL;
+}
+
+// Up to frames frames of the voice into dst, before the gain
+static size_t mixer_voice_read(app_mixer_voice_t *voice, int16_t *dst, size_t frames)
+{
+    if (voice->stream)
+    {
+        size_t n = 0;
+        xSemaphoreTake(voice->stream_lock, portMAX_DELAY);
+        if (voice->write_generation != voice->generation)
+        {
+            // Stopped, drop what was written before, which also frees a producer blocked on a full buffer
+            while (xStreamBufferReceive(voice->stream, dst, frames * MIXER_FRAME_BYTES, 0) > 0)
+            {
+            }
+        }
+        else
+        {
+            n = xStreamBufferReceive(voice->stream, dst, frames * MIXER_FRAME_BYTES, 0) / MIXER_FRAME_BYTES;
+        }
+        xSemaphoreGive(voice->stream_lock);
+        return n;
+    }
+
+    TaskHandle_t waiter = NULL;
+    taskENTER_CRITICAL(&s_lock);
+    const int16_t *clip = voice->clip;
+    size_t pos = voice->clip_pos;
+    size_t n = clip ? voice->clip_frames - pos : 0;
+    n = n < frames ? n : frames;
+    voice->clip_pos += n;
+    if (clip && voice->clip_pos == voice->clip_frames)
+    {
+        voice->clip = NULL;
+        waiter = voice->waiter;
+        voice->waiter = NULL;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    memcpy(dst, clip + pos * 2, n * MIXER_FRAME_BYTES);
+    if (waiter)
+    {
+        xTaskNotifyGive(waiter);
+    }
+    return n;
+}
+
+static void mixer_task(void *arg)
+{
+    bool active = false;
+    const uint32_t ramp_frames = MIXER_RAMP_MS * BSP_I2S_SAMPLE_RATE / 1000;
+
+    while (true)
+    {
+        // The highest priority with audio left ducks the others
+        int top = INT_MIN;
+        for (int i = 0; i < s_voice_count; i++)
+        {
+            if (mixer_voice_pending(&s_voices[i]) && s_voices[i].priority > top)
+            {
+                top = s_voices[i].priority;
+            }
+        }
+        if (top == INT_MIN)
+        {
+            if (!active)
+            {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            }
+            else if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MIXER_IDLE_HOLD_MS)) == 0)
+            {
+                if (s_active_fn)
+                {
+                    s_active_fn(false);
+                }
+                active = false;
+            }
+            continue;
+        }
+        if (!active && s_active_fn)
+        {
+            s_active_fn(true);
+        }
+        active = true;
+
+        // A single voice goes out as it is, more are summed in 32 bit and saturated once
+        size_t len = 0;
+        int mixed = 0;
+        for (int i = 0; i < s_voice_count; i++)
+        {
+            app_mixer_voice_t *voice = &s_voices[i];
+            int32_t target = voice->priority < top ? (voice->gain * voice->duck) >> 15 : voice->gain;
+            if (target != voice->ramp.target)
+            {
+                audio_gain_set(&voice->ramp, target, ramp_frames);
+            }
+
+            size_t n = mixer_voice_read(voice, s_voice_buf, MIXER_BLOCK_FRAMES);
+            if (n == 0)
+            {
+                continue;
+            }
+            audio_kernel_output(s_voice_buf, n, 2, &voice->ramp);
+
+            if (mixed == 0)
+            {
+                memcpy(s_out, s_voice_buf, n * MIXER_FRAME_BYTES);
+                len = n;
+            }
+            else
+            {
+                if (mixed == 1)
+                {
+                    for (size_t k = 0; k < len * 2; k++)
+                    {
+                        s_acc[k] = s_out[k];
+                    }
+                }
+                for (size_t k = len * 2; k < n * 2; k++)
+                {
+                    s_acc[k] = 0;
+                }
+                len = n > len ? n : len;
+                for (size_t k = 0; k < n * 2; k++)
+                {
+                    s_acc[k] += s_voice_buf[k];
+                }
+            }
+            mixed++;
+        }
+        if (mixed > 1)
+        {
+            for (size_t k = 0; k < len * 2; k++)
+            {
+                s_out[k] = mixer_clip16(s_acc[k]);
+            }
+        }
+        if (len)
+        {
+            s_write_fn(s_out, len * MIXER_FRAME_BYTES);
+        }
+    }
+}
+
+esp_err_t app_mixer_init(app_mixer_write_fn write_fn, app_mixer_active_fn active_fn)
+{
+    ESP_RETURN_ON_FALSE(write_fn, ESP_ERR_INVALID_ARG, TAG, "write_fn is required");
+    if (s_task)
+    {
+        return ESP_OK;
+    }
+    s_write_fn = write_fn;
+    s_active_fn = active_fn;
+    // Above the player, which only fills its voice
+    BaseType_t ret_val = xTaskCreate(mixer_task, "Mixer Task", 3 * 1024, NULL, 6, &s_task);
+    ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "Failed create mixer task");
+    return ESP_OK;
+}
+
+app_mixer_voice_t *app_mixer_voice_new(const app_mixer_voice_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(s_voice_count < MIXER_VOICES_MAX, NULL, TAG, "No voice left");
+    app_mixer_voice_t *voice = &s_voices[s_voice_count];
+    memset(voice, 0, sizeof(*voice));
+    voice->priority = config->priority;
+    voice->gain = mixer_q15(config->gain_db);
+    voice->duck = mixer_q15(config->duck_db);
+    audio_gain_set(&voice->ramp, voice->gain, 0);
+    if (config->stream_frames)
+    {
+        voice->stream = xStreamBufferCreate(config->stream_frames * MIXER_FRAME_BYTES, 1);
+        voice->stream_lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(voice->stream && voice->stream_lock, NULL, TAG, "No memory for %u frames", (unsigned)config->stream_frames);
+        voice->chunk_frames = config->stream_frames / 2;
+    }
+    // The mixer task only looks at voices below s_voice_count
+    s_voice_count++;
+    return voice;
+}
+
+// Empty the stream and let the mixer read it again, producer side only
+static void mixer_stream_reset(app_mixer_voice_t *voice, uint32_t generation)
+{
+    xSemaphoreTake(voice->stream_lock, portMAX_DELAY);
+    // Nothing blocks on the stream here: the mixer never waits in receive, the producer is us
+    xStreamBufferReset(voice->stream);
+    voice->write_generation = generation;
+    xSemaphoreGive(voice->stream_lock);
+}
+
+esp_err_t app_mixer_voice_write(app_mixer_voice_t *voice, const int16_t *pcm, size_t frames)
+{
+    ESP_RETURN_ON_FALSE(voice && voice->stream, ESP_ERR_INVALID_ARG, TAG, "Not a streaming voice");
+    uint32_t generation = voice->generation;
+    if (voice->write_generation != generation)
+    {
+        // First write after a stop
+        mixer_stream_reset(voice, generation);
+    }
+    while (frames)
+    {
+        size_t n = frames < voice->chunk_frames ? frames : voice->chunk_frames;
+        xStreamBufferSend(voice->stream, pcm, n * MIXER_FRAME_BYTES, portMAX_DELAY);
+        if (voice->generation != generation)
+        {
+            // Stopped while this was blocked or queued, take it back out before the mixer plays it
+            mixer_stream_reset(voice, voice->generation);
+            return ESP_ERR_INVALID_STATE;
+        }
+        xTaskNotifyGive(s_task);
+        pcm += n * 2;
+        frames -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_mixer_voice_play(app_mixer_voice_t *voice, const int16_t *pcm, size_t frames, bool wait)
+{
+    ESP_RETURN_ON_FALSE(voice && !voice->stream, ESP_ERR_INVALID_ARG, TAG, "Not a clip voice");
+    if (pcm == NULL || frames == 0)
+    {
+        return ESP_OK;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    TaskHandle_t replaced = voice->waiter;
+    voice->clip = pcm;
+    voice->clip_frames = frames;
+    voice->clip_pos = 0;
+    voice->waiter = wait ? xTaskGetCurrentTaskHandle() : NULL;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (replaced)
+    {
+        xTaskNotifyGive(replaced);
+    }
+    xTaskNotifyGive(s_task);
+    if (wait)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    return ESP_OK;
+}
+
+void app_mixer_voice_stop(app_mixer_voice_t *voice)
+{
+    if (voice->stream)
+    {
+        // The mixer drops the stream until the producer has seen the new generation
+        voice->generation++;
+        xTaskNotifyGive(s_task);
+        return;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    TaskHandle_t waiter = voice->waiter;
+    voice->clip = NULL;
+    voice->waiter = NULL;
+    taskEXIT_CRITICAL(&s_lock);
+    if (waiter)
+    {
+        xTaskNotifyGive(waiter);
+    }
+}
+
+esp_err_t app_mixer_voice_set_gain(app_mixer_voice_t *voice, float gain_db)
+{
+    ESP_RETURN_ON_FALSE(voice, ESP_ERR_INVALID_ARG, TAG, "No voice");
+    // Picked up by the mixer task and ramped to
+    voice->gain = mixer_q15(gain_db);
+    return ESP_OK;
+}
+
+bool app_mixer_voice_is_active(app_mixer_voice_t *voice)
+{
+    return mixer_voice_pending(voice);
+}
@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Software mixer, the only writer of the I2S output. Every source plays into a voice, the
+ * mixer task sums the active voices block by block in Q15 with saturation and hands the
+ * result to write_fn, which paces it.
+ *
+ * A voice either streams, the producer blocks in app_mixer_voice_write() while its buffer is
+ * full, or plays a clip from memory that stays valid until it is done. Each voice has a gain,
+ * and a duck gain it is ramped to while a voice of higher priority plays.
+ *
+ * All samples are in the output format, 16 bit stereo at the I2S rate.
+ */
+
+typedef struct app_mixer_voice app_mixer_voice_t;
+
+typedef struct
+{
+    int priority;         // a playing voice ducks every voice of lower priority
+    float gain_db;        // at most 0 dB
+    float duck_db;        // on top of gain_db while ducked, 0 for never
+    size_t stream_frames; // buffer of a streaming voice, 0 for a clip voice
+} app_mixer_voice_config_t;
+
+// Writes one mixed block in the I2S output format
+typedef esp_err_t (*app_mixer_write_fn)(void *data, size_t len);
+// Called from the mixer task when the output starts and stops, e.g. to unmute the codec
+typedef void (*app_mixer_active_fn)(bool active);
+
+esp_err_t app_mixer_init(app_mixer_write_fn write_fn, app_mixer_active_fn active_fn);
+
+app_mixer_voice_t *app_mixer_voice_new(const app_mixer_voice_config_t *config);
+
+/**
+ * @brief Queue frames on a streaming voice, blocks while its buffer is full.
+ *
+ * One producer task per voice.
+ *
+ * @return ESP_ERR_INVALID_STATE when app_mixer_voice_stop() came in while writing, nothing of the
+ *         call is played. The next call starts a new stream.
+ */
+esp_err_t app_mixer_voice_write(app_mixer_voice_t *voice, const int16_t *pcm, size_t frames);
+
+/**
+ * @brief Play a clip on a clip voice, replacing the one it plays.
+ *
+ * @param wait  return once the clip has been mixed, or replaced
+ */
+esp_err_t app_mixer_voice_play(app_mixer_voice_t *voice, const int16_t *pcm, size_t frames, bool wait);
+
+/**
+ * @brief Drop what the voice still has to play, including what a producer blocked in
+ *        app_mixer_voice_write() is about to queue.
+ */
+void app_mixer_voice_stop(app_mixer_voice_t *voice);
+
+esp_err_t app_mixer_voice_set_gain(app_mixer_voice_t *voice, float gain_db);
+
+/**
+ * @brief The voice has audio left to play.
+ */
+bool app_mixer_voice_is_active(app_mixer_voice_t *voice);
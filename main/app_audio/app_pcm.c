@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "app_pcm.h"
+
+static const char *TAG = "app_pcm";
+
+esp_err_t app_pcm_init(app_pcm_t *pcm, uint32_t rate, int bits, int channels, uint32_t out_rate,
+                       audio_player_write_fn write_fn)
+{
+    if ((bits != 8 && bits != 16 && bits != 32) || channels < 1 || channels > 2 || rate == 0)
+    {
+        ESP_LOGE(TAG, "Unsupported format %" PRIu32 " Hz, %d bit, %d ch", rate, bits, channels);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    pcm->bits = bits;
+    pcm->channels = channels;
+    pcm->write_fn = write_fn;
+    pcm->resample = rate != out_rate;
+    audio_gain_set(&pcm->gain, AUDIO_GAIN_UNITY, 0);
+    if (!pcm->resample)
+    {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(audio_resample_config(&pcm->rs, rate, channels, out_rate), TAG,
+                        "No resampler for %" PRIu32 " Hz", rate);
+    // A new clip starts on silence, not on the end of the previous one
+    audio_resample_reset(&pcm->rs);
+    return ESP_OK;
+}
+
+static void pcm_load(app_pcm_t *pcm, const uint8_t *in, size_t frames)
+{
+    size_t count = frames * pcm->channels;
+
+    switch (pcm->bits)
+    {
+    case 16:
+        memcpy(pcm->block, in, count * sizeof(int16_t));
+        break;
+    case 32:
+        for (size_t k = 0; k < count; k++)
+        {
+            pcm->block[k] = ((const int32_t *)in)[k] >> 16;
+        }
+        break;
+    default:
+        // 8 bit WAV is unsigned
+        for (size_t k = 0; k < count; k++)
+        {
+            pcm->block[k] = (int16_t)((in[k] - 128) << 8);
+        }
+        break;
+    }
+}
+
+esp_err_t app_pcm_write(app_pcm_t *pcm, const void *data, size_t len)
+{
+    size_t frame_size = pcm->channels * pcm->bits / 8;
+    size_t frames = len / frame_size;
+    const uint8_t *in = data;
+    size_t written;
+    esp_err_t ret = ESP_OK;
+
+    if (!pcm->resample && pcm->bits == 16 && pcm->channels == 2)
+    {
+        // Already the output format
+        return pcm->write_fn((void *)data, frames * frame_size, &written, portMAX_DELAY);
+    }
+    while (frames && ret == ESP_OK)
+    {
+        size_t n = frames < APP_PCM_BLOCK ? frames : APP_PCM_BLOCK;
+        pcm_load(pcm, in, n);
+        if (pcm->resample)
+        {
+            // The resampler also does mono -> stereo
+            ret = audio_resample_write(&pcm->rs, pcm->block, n, &pcm->gain, pcm->write_fn);
+        }
+        else
+        {
+            audio_kernel_output(pcm->block, n, pcm->channels, &pcm->gain);
+            ret = pcm->write_fn(pcm->block, n * 2 * sizeof(int16_t), &written, portMAX_DELAY);
+        }
+        in += n * frame_size;
+        frames -= n;
+    }
+    return ret;
+}
+
+esp_err_t app_pcm_finish(app_pcm_t *pcm)
+{
+    if (!pcm->resample)
+    {
+        return ESP_OK;
+    }
+    return audio_resample_drain(&pcm->rs, &pcm->gain, pcm->write_fn);
+}
+
+void app_pcm_free(app_pcm_t *pcm)
+{
+    audio_resample_free(&pcm->rs);
+}
@@ -0,0 +1,59 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_resample.h"
+
+/**
+ * Converts a clip to the fixed I2S output format, 16 bit stereo at the duplex rate, so the
+ * codec never has to be reopened for a clip. 8 and 32 bit samples are brought to 16 bit here,
+ * other rates go through the polyphase resampler of esp-audio-player. Its history carries over
+ * between blocks, so a clip can be converted in pieces of any size.
+ *
+ * Each writer owns its own state, the output goes to its write_fn in blocks.
+ */
+
+#define APP_PCM_BLOCK (256) // input frames converted per step
+
+typedef struct
+{
+    int bits;
+    int channels;
+    bool resample;      // the rate differs from the output rate
+    audio_resample_t rs;
+    audio_gain_t gain;  // unity, the volume is set by the mixer
+    audio_player_write_fn write_fn;
+    int16_t block[APP_PCM_BLOCK * 2];
+} app_pcm_t;
+
+/**
+ * @brief Start a clip of the given format. The state is zeroed before the first call, the
+ *        resampler tables are only rebuilt when the rates or the channel count change.
+ * @return ESP_ERR_NOT_SUPPORTED for other than 8, 16 or 32 bit, one or two channels
+ */
+esp_err_t app_pcm_init(app_pcm_t *pcm, uint32_t rate, int bits, int channels, uint32_t out_rate,
+                       audio_player_write_fn write_fn);
+
+/**
+ * @brief Convert the whole frames in len bytes and pass them to write_fn.
+ * @return the first error of write_fn, the rest of the data is dropped then
+ */
+esp_err_t app_pcm_write(app_pcm_t *pcm, const void *data, size_t len);
+
+/**
+ * @brief Push the end of the clip out of the resampler, once the last block is written.
+ */
+esp_err_t app_pcm_finish(app_pcm_t *pcm);
+
+/**
+ * @brief Free the resampler tables.
+ */
+void app_pcm_free(app_pcm_t *pcm);
@@ -0,0 +1,235 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mp3dec.h"
+
+#include "bsp_audio.h"
+#include "app_audio.h"
+#include "app_mixer.h"
+#include "app_pcm.h"
+#include "app_prompt.h"
+
+static const char *TAG = "app_prompt";
+
+// Clip buffers grow by this many frames while decoding, trimmed at the end
+#define PROMPT_GROW_FRAMES  (8192)
+
+static const char *const s_paths[APP_PROMPT_MAX] = {
+    [APP_PROMPT_POWER_ON] = "/spiffs/powerOn.wav",
+    [APP_PROMPT_POWER_OFF] = "/spiffs/powerOff.wav",
+    [APP_PROMPT_WAKE] = "/spiffs/echo_cn_wake.wav",
+    [APP_PROMPT_OK] = "/spiffs/echo_cn_ok.wav",
+    [APP_PROMPT_WAIT] = "/spiffs/waitPlease.mp3",
+};
+
+typedef struct
+{
+    int16_t *pcm;    // 16 bit stereo at BSP_I2S_SAMPLE_RATE
+    size_t frames;
+    size_t capacity; // frames, while decoding
+} prompt_clip_t;
+
+static prompt_clip_t s_clips[APP_PROMPT_MAX];
+static app_mixer_voice_t *s_voice = NULL;
+
+// Converter of the clip being decoded, the resampler tables are freed once every prompt is loaded
+static app_pcm_t s_pcm;
+static prompt_clip_t *s_loading = NULL;
+
+static esp_err_t prompt_clip_append(prompt_clip_t *clip, const int16_t *pcm, size_t frames)
+{
+    if (clip->frames + frames > clip->capacity)
+    {
+        size_t capacity = clip->frames + frames + PROMPT_GROW_FRAMES;
+        int16_t *grown = heap_caps_realloc(clip->pcm, capacity * 2 * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        ESP_RETURN_ON_FALSE(grown, ESP_ERR_NO_MEM, TAG, "No memory for %u frames", (unsigned)capacity);
+        clip->pcm = grown;
+        clip->capacity = capacity;
+    }
+    memcpy(clip->pcm + clip->frames * 2, pcm, frames * 2 * sizeof(int16_t));
+    clip->frames += frames;
+    return ESP_OK;
+}
+
+// write_fn of s_pcm, appends the converted samples to the clip being decoded
+static esp_err_t prompt_clip_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    *bytes_written = len;
+    return prompt_clip_append(s_loading, audio_buffer, len / (2 * sizeof(int16_t)));
+}
+
+static esp_err_t prompt_decode_wav(const uint8_t *file, size_t size)
+{
+    const wav_header_t *head = (const wav_header_t *)file;
+    ESP_RETURN_ON_FALSE(size > sizeof(wav_header_t), ESP_ERR_INVALID_SIZE, TAG, "WAV too short");
+    ESP_RETURN_ON_ERROR(app_pcm_init(&s_pcm, head->SampleRate, head->BitsPerSample, head->NumChannels,
+                                     BSP_I2S_SAMPLE_RATE, prompt_clip_write), TAG, "Unsupported WAV format");
+
+    size_t len = size - sizeof(wav_header_t);
+    if (head->Subchunk2Size > 0 && (size_t)head->Subchunk2Size < len)
+    {
+        len = head->Subchunk2Size;
+    }
+    return app_pcm_write(&s_pcm, file + sizeof(wav_header_t), len);
+}
+
+static esp_err_t prompt_decode_mp3(const uint8_t *file, size_t size)
+{
+    HMP3Decoder decoder = MP3InitDecoder();
+    int16_t *pcm = malloc(MAX_NCHAN * MAX_NGRAN * MAX_NSAMP * sizeof(int16_t));
+    esp_err_t ret = ESP_OK;
+    ESP_GOTO_ON_FALSE(decoder && pcm, ESP_ERR_NO_MEM, EXIT, TAG, "No memory for the MP3 decoder");
+
+    unsigned char *read_ptr = (unsigned char *)file;
+    int left = size;
+    int rate = 0;
+    MP3FrameInfo info;
+    while (left > 0)
+    {
+        int offset = MP3FindSyncWord(read_ptr, left);
+        if (offset < 0)
+        {
+            break;
+        }
+        read_ptr += offset;
+        left -= offset;
+        int err = MP3Decode(decoder, &read_ptr, &left, pcm, 0);
+        if (err == ERR_MP3_INDATA_UNDERFLOW)
+        {
+            break;
+        }
+        else if (err)
+        {
+            // not a frame after all, look for the next sync word
+            read_ptr++;
+            left--;
+            continue;
+        }
+        MP3GetLastFrameInfo(decoder, &info);
+        if (info.samprate != rate)
+        {
+            rate = info.samprate;
+            ret = app_pcm_init(&s_pcm, rate, info.bitsPerSample, info.nChans, BSP_I2S_SAMPLE_RATE, prompt_clip_write);
+            ESP_GOTO_ON_ERROR(ret, EXIT, TAG, "Unsupported MP3 format");
+        }
+        ret = app_pcm_write(&s_pcm, pcm, info.outputSamps * sizeof(int16_t));
+        ESP_GOTO_ON_ERROR(ret, EXIT, TAG, "feed");
+    }
+    ESP_GOTO_ON_FALSE(rate, ESP_ERR_INVALID_RESPONSE, EXIT, TAG, "No MP3 frame found");
+
+EXIT:
+    free(pcm);
+    if (decoder)
+    {
+        MP3FreeDecoder(decoder);
+    }
+    return ret;
+}
+
+static esp_err_t prompt_load(prompt_clip_t *clip, const char *path)
+{
+    struct stat file_stat;
+    uint8_t *file = NULL;
+    FILE *fp = NULL;
+    esp_err_t ret = ESP_OK;
+
+    ESP_GOTO_ON_FALSE(-1 != stat(path, &file_stat) && file_stat.st_size > 0, ESP_ERR_NOT_FOUND, EXIT, TAG, "Failed to stat %s", path);
+    file = heap_caps_malloc(file_stat.st_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    fp = fopen(path, "r");
+    ESP_GOTO_ON_FALSE(file && fp, ESP_FAIL, EXIT, TAG, "Failed to open %s", path);
+    ESP_GOTO_ON_FALSE(fread(file, 1, file_stat.st_size, fp) == file_stat.st_size, ESP_FAIL, EXIT, TAG, "Failed to read %s", path);
+
+    s_loading = clip;
+    if (0 == memcmp(file, "RIFF", 4) && 0 == memcmp(file + 8, "WAVE", 4))
+    {
+        ret = prompt_decode_wav(file, file_stat.st_size);
+    }
+    else
+    {
+        ret = prompt_decode_mp3(file, file_stat.st_size);
+    }
+    if (ret == ESP_OK)
+    {
+        // The last frames are still in the resampler
+        ret = app_pcm_finish(&s_pcm);
+    }
+
+    if (ret == ESP_OK && clip->frames < clip->capacity)
+    {
+        // Give back what the last growth step did not use
+        int16_t *trimmed = heap_caps_realloc(clip->pcm, clip->frames * 2 * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (trimmed)
+        {
+            clip->pcm = trimmed;
+            clip->capacity = clip->frames;
+        }
+    }
+
+EXIT:
+    if (fp)
+    {
+        fclose(fp);
+    }
+    heap_caps_free(file);
+    if (ret != ESP_OK)
+    {
+        heap_caps_free(clip->pcm);
+        memset(clip, 0, sizeof(*clip));
+    }
+    return ret;
+}
+
+esp_err_t app_prompt_init(void)
+{
+    if (s_voice)
+    {
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    size_t bytes = 0;
+    for (int id = 0; id < APP_PROMPT_MAX; id++)
+    {
+        if (prompt_load(&s_clips[id], s_paths[id]) == ESP_OK)
+        {
+            bytes += s_clips[id].frames * 2 * sizeof(int16_t);
+        }
+    }
+    app_pcm_free(&s_pcm);
+    ESP_LOGI(TAG, "Prompts decoded in %" PRId64 " ms, %u bytes of PSRAM", (esp_timer_get_time() - start) / 1000, (unsigned)bytes);
+
+    // Above the players, which it ducks, and never ducked itself
+    app_mixer_voice_config_t config = {
+        .priority = 1,
+        .gain_db = 0.0f,
+        .duck_db = 0.0f,
+        .stream_frames = 0,
+    };
+    s_voice = app_mixer_voice_new(&config);
+    ESP_RETURN_ON_FALSE(s_voice, ESP_ERR_NO_MEM, TAG, "No mixer voice");
+    return ESP_OK;
+}
+
+esp_err_t app_prompt_play(app_prompt_id_t id, bool wait)
+{
+    ESP_RETURN_ON_FALSE(id < APP_PROMPT_MAX, ESP_ERR_INVALID_ARG, TAG, "Unknown prompt %d", id);
+    ESP_RETURN_ON_FALSE(s_voice, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    return app_mixer_voice_play(s_voice, s_clips[id].pcm, s_clips[id].frames, wait);
+}
+
+bool app_prompt_is_playing(void)
+{
+    return s_voice && app_mixer_voice_is_active(s_voice);
+}
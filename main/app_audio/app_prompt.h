@@ -0,0 +1,45 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * Prompt sounds decoded once at boot into PSRAM, already in the I2S output format, 16 bit
+ * stereo at BSP_I2S_SAMPLE_RATE. They play on their own mixer voice over whatever else plays,
+ * no file access, allocation or format conversion on the way.
+ */
+
+typedef enum
+{
+    APP_PROMPT_POWER_ON = 0,
+    APP_PROMPT_POWER_OFF,
+    APP_PROMPT_WAKE,
+    APP_PROMPT_OK,
+    APP_PROMPT_WAIT,
+    APP_PROMPT_MAX,
+} app_prompt_id_t;
+
+/**
+ * @brief Decode every prompt from SPIFFS and take a mixer voice, after app_mixer_init(). A
+ *        prompt that fails to load is logged and stays silent, the others still play.
+ */
+esp_err_t app_prompt_init(void);
+
+/**
+ * @brief Play a prompt, ducking the players under it. It replaces the prompt playing.
+ *
+ * @param wait  return once the prompt has been mixed, or replaced
+ */
+esp_err_t app_prompt_play(app_prompt_id_t id, bool wait);
+
+/**
+ * @brief A prompt is still playing.
+ */
+bool app_prompt_is_playing(void);
@@ -0,0 +1,243 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "app_audio.h"
+#include "app_record.h"
+
+static const char *TAG = "app_record";
+
+#define RECORD_MS(samples) ((unsigned)((samples) * 1000 / APP_RECORD_SAMPLE_RATE))
+
+// Two samples stored at once, the int16_t buffers are accessed through it
+typedef uint32_t __attribute__((may_alias)) record_pair_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static SemaphoreHandle_t s_data = NULL; // given when the recording grows or stops
+static uint8_t *s_wav = NULL;           // WAV header, then the recording
+static int16_t *s_samples = NULL;
+static size_t s_capacity;               // samples
+static int16_t *s_ring = NULL;          // pre-roll between recordings
+static size_t s_ring_size;
+static size_t s_ring_head;
+static size_t s_ring_filled;
+static bool s_recording = false;
+static uint32_t s_generation = 0;
+static size_t s_length = 0;             // samples of the current or last recording
+static size_t s_preroll;
+static size_t s_lost;
+
+/* Copy every stride-th sample. dst is in PSRAM behind the cache, two samples are packed into
+ * one 32 bit store, which halves the stores compared to one sample at a time.
+ */
+static void record_copy(int16_t *dst, const int16_t *src, size_t samples, int stride)
+{
+    size_t n = 0;
+
+    if (((uintptr_t)dst & 3) && samples)
+    {
+        dst[n++] = src[0];
+    }
+    record_pair_t *out = (record_pair_t *)(dst + n);
+    for (; n + 4 <= samples; n += 4)
+    {
+        out[0] = (uint16_t)src[n * stride] | (uint32_t)(uint16_t)src[(n + 1) * stride] << 16;
+        out[1] = (uint16_t)src[(n + 2) * stride] | (uint32_t)(uint16_t)src[(n + 3) * stride] << 16;
+        out += 2;
+    }
+    for (; n < samples; n++)
+    {
+        dst[n] = src[n * stride];
+    }
+}
+
+static void record_wav_header(void)
+{
+    uint32_t data_len = s_length * sizeof(int16_t);
+    wav_header_t head = {
+        .ChunkID = {'R', 'I', 'F', 'F'},
+        .ChunkSize = sizeof(wav_header_t) - 8 + data_len,
+        .Format = {'W', 'A', 'V', 'E'},
+        .Subchunk1ID = {'f', 'm', 't', ' '},
+        .Subchunk1Size = 16,
+        .AudioFormat = 1,
+        .NumChannels = 1,
+        .SampleRate = APP_RECORD_SAMPLE_RATE,
+        .ByteRate = APP_RECORD_SAMPLE_RATE * sizeof(int16_t),
+        .BlockAlign = sizeof(int16_t),
+        .BitsPerSample = 16,
+        .Subchunk2ID = {'d', 'a', 't', 'a'},
+        .Subchunk2Size = data_len,
+    };
+    memcpy(s_wav, &head, sizeof(head));
+}
+
+esp_err_t app_record_init(size_t capacity, int preroll_ms)
+{
+    s_capacity = (capacity - sizeof(wav_header_t)) / sizeof(int16_t);
+    s_ring_size = preroll_ms * APP_RECORD_SAMPLE_RATE / 1000;
+    s_wav = heap_caps_calloc(1, sizeof(wav_header_t) + s_capacity * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_ring = s_ring_size ? heap_caps_malloc(s_ring_size * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+    s_lock = xSemaphoreCreateMutex();
+    s_data = xSemaphoreCreateBinary();
+    if (!s_wav || (s_ring_size && !s_ring) || !s_lock || !s_data)
+    {
+        ESP_LOGE(TAG, "No memory for %u bytes of recording", (unsigned)capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    s_samples = (int16_t *)(s_wav + sizeof(wav_header_t));
+    record_wav_header();
+    ESP_LOGI(TAG, "%u ms of recording, %d ms pre-roll", RECORD_MS(s_capacity), preroll_ms);
+    return ESP_OK;
+}
+
+void app_record_feed(const int16_t *data, int samples, int stride)
+{
+    if (s_lock == NULL || samples <= 0)
+    {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_recording)
+    {
+        size_t n = s_capacity - s_length < (size_t)samples ? s_capacity - s_length : (size_t)samples;
+        record_copy(s_samples + s_length, data, n, stride);
+        s_length += n;
+        s_lost += samples - n;
+        xSemaphoreGive(s_data);
+    }
+    else if (s_ring_size)
+    {
+        // Only the newest s_ring_size samples matter
+        size_t skip = (size_t)samples > s_ring_size ? samples - s_ring_size : 0;
+        size_t n = samples - skip;
+        size_t first = s_ring_size - s_ring_head < n ? s_ring_size - s_ring_head : n;
+        record_copy(s_ring + s_ring_head, data + skip * stride, first, stride);
+        record_copy(s_ring, data + (skip + first) * stride, n - first, stride);
+        s_ring_head = (s_ring_head + n) % s_ring_size;
+        s_ring_filled = s_ring_filled + n < s_ring_size ? s_ring_filled + n : s_ring_size;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void app_record_start(void)
+{
+    if (s_lock == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // The oldest pre-roll sample is s_ring_filled samples before the head
+    size_t preroll = s_ring_filled < s_capacity ? s_ring_filled : s_capacity;
+    if (preroll)
+    {
+        size_t tail = (s_ring_head + s_ring_size - preroll) % s_ring_size;
+        size_t first = s_ring_size - tail < preroll ? s_ring_size - tail : preroll;
+        memcpy(s_samples, s_ring + tail, first * sizeof(int16_t));
+        memcpy(s_samples + first, s_ring, (preroll - first) * sizeof(int16_t));
+    }
+    s_length = preroll;
+    s_preroll = preroll;
+    s_lost = 0;
+    s_recording = true;
+    s_generation++;
+    xSemaphoreGive(s_lock);
+    xSemaphoreGive(s_data);
+    ESP_LOGI(TAG, "### record Start");
+}
+
+void app_record_stop(void)
+{
+    if (s_lock == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool was_recording = s_recording;
+    if (was_recording)
+    {
+        s_recording = false;
+        // The pre-roll of the next recording starts after this one
+        s_ring_filled = 0;
+        record_wav_header();
+    }
+    xSemaphoreGive(s_lock);
+    if (was_recording)
+    {
+        xSemaphoreGive(s_data);
+        ESP_LOGI(TAG, "### record Stop, %u ms with %u ms pre-roll, %u ms lost", RECORD_MS(s_length),
+                 RECORD_MS(s_preroll), RECORD_MS(s_lost));
+    }
+}
+
+const uint8_t *app_record_wav(size_t *len)
+{
+    *len = s_wav ? sizeof(wav_header_t) + s_length * sizeof(int16_t) : 0;
+    return s_wav;
+}
+
+void app_record_cursor_next(app_record_cursor_t *cursor)
+{
+    cursor->generation = 1;
+    cursor->offset = 0;
+    if (s_lock == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cursor->generation = s_recording ? s_generation : s_generation + 1;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t app_record_read(app_record_cursor_t *cursor, const int16_t **samples, size_t *count, TickType_t wait)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    *count = 0;
+    if (s_lock == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    while (true)
+    {
+        esp_err_t ret = ESP_ERR_TIMEOUT;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if ((int32_t)(s_generation - cursor->generation) > 0)
+        {
+            ret = ESP_ERR_INVALID_STATE;
+        }
+        else if (s_generation == cursor->generation)
+        {
+            if (cursor->offset < s_length)
+            {
+                *samples = s_samples + cursor->offset;
+                *count = s_length - cursor->offset;
+                cursor->offset = s_length;
+                ret = ESP_OK;
+            }
+            else if (!s_recording)
+            {
+                ret = ESP_OK;
+            }
+        }
+        xSemaphoreGive(s_lock);
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (ret != ESP_ERR_TIMEOUT || elapsed >= wait)
+        {
+            return ret;
+        }
+        xSemaphoreTake(s_data, wait - elapsed);
+    }
+}
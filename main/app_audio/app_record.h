@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+/**
+ * The microphone recording, the AFE output at 16 kHz 16 bit mono after echo cancellation, kept
+ * in PSRAM. app_record_feed() runs for every block: between recordings it fills a pre-roll
+ * ring, while recording it appends to a linear buffer placed right after an in-memory WAV
+ * header, so the finished recording is a complete WAV file without moving the samples.
+ *
+ * Consumers read the samples in place: the upload follows the recording with a cursor while
+ * it grows, app_record_wav() hands the whole file to an upload after the recording stopped.
+ */
+
+#define APP_RECORD_SAMPLE_RATE (16000)
+
+typedef struct
+{
+    uint32_t generation; // recording the cursor belongs to
+    size_t offset;       // samples already read
+} app_record_cursor_t;
+
+/**
+ * @brief Allocate the buffers, capacity bytes of recording including the WAV header.
+ */
+esp_err_t app_record_init(size_t capacity, int preroll_ms);
+
+/**
+ * @brief Store every stride-th sample of a block, called from the detect task for every fetch.
+ */
+void app_record_feed(const int16_t *data, int samples, int stride);
+
+/**
+ * @brief Start a recording with the pre-roll captured before the call in front.
+ */
+void app_record_start(void);
+
+/**
+ * @brief Stop the recording and complete the WAV header.
+ */
+void app_record_stop(void);
+
+/**
+ * @brief The last recording as a WAV file, valid until the next app_record_start().
+ */
+const uint8_t *app_record_wav(size_t *len);
+
+/**
+ * @brief Point the cursor at the next recording, also one already started.
+ */
+void app_record_cursor_next(app_record_cursor_t *cursor);
+
+/**
+ * @brief Samples of the cursor's recording not read yet, in place, and move the cursor past them.
+ * Only one task may wait at a time.
+ *
+ * @param wait how long to wait for the recording to start or grow
+ * @return ESP_OK with *count 0 once the recording stopped and everything was read,
+ *         ESP_ERR_TIMEOUT if nothing new arrived in time,
+ *         ESP_ERR_INVALID_STATE if a later recording replaced the cursor's one
+ */
+esp_err_t app_record_read(app_record_cursor_t *cursor, const int16_t **samples, size_t *count, TickType_t wait);
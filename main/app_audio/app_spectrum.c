@@ -0,0 +1,248 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <math.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "rgb_matrix.h"
+#include "app_spectrum.h"
+
+static const char *TAG = "app_spectrum";
+
+#define SPECTRUM_FFT_BITS       (8)
+#define SPECTRUM_FFT_SIZE       (1 << SPECTRUM_FFT_BITS)
+// log2 of the power (3 fractional bits) that maps to 0, just above the idle mic noise
+#define SPECTRUM_BAND_FLOOR_Q3  (4 * 8)
+#define SPECTRUM_LEVEL_FLOOR_Q3 (10 * 8)
+// Output steps per Q3 log2 unit, 16 steps per 3 dB of power
+#define SPECTRUM_GAIN           (2)
+// Peak hold release per block, a full bar falls in about one second at 32 ms blocks
+#define SPECTRUM_RELEASE        (8)
+
+static int16_t s_window[SPECTRUM_FFT_SIZE];
+static int16_t s_cos[SPECTRUM_FFT_SIZE / 2];
+static int16_t s_sin[SPECTRUM_FFT_SIZE / 2];
+static uint8_t s_bitrev[SPECTRUM_FFT_SIZE];
+// FFT bins of band i are [s_band_start[i], s_band_start[i + 1])
+static uint8_t s_band_start[RGB_MATRIX_AUDIO_BANDS + 1];
+static int32_t s_re[SPECTRUM_FFT_SIZE];
+static int32_t s_im[SPECTRUM_FFT_SIZE];
+static rgb_matrix_audio_t s_frame;
+// Newest samples of a block. The feed task fills s_fill, the spectrum task reads its own buffer,
+// the latest complete block is handed between them by swapping pointers with s_ready
+static int16_t s_input[3][SPECTRUM_FFT_SIZE];
+static int16_t *s_fill = s_input[0];
+static int16_t *s_ready = s_input[1];
+static int s_ready_len; // 0 once the spectrum task took it
+static portMUX_TYPE s_input_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task = NULL;
+
+static void spectrum_task(void *arg);
+
+void app_spectrum_init(int sample_rate)
+{
+    for (int n = 0; n < SPECTRUM_FFT_SIZE; n++)
+    {
+        // Hann window in Q15
+        s_window[n] = lroundf(32767.0f * 0.5f * (1.0f - cosf(2.0f * (float)M_PI * n / (SPECTRUM_FFT_SIZE - 1))));
+
+        uint8_t rev = 0;
+        for (int bit = 0; bit < SPECTRUM_FFT_BITS; bit++)
+        {
+            rev |= ((n >> bit) & 1) << (SPECTRUM_FFT_BITS - 1 - bit);
+        }
+        s_bitrev[n] = rev;
+    }
+    for (int k = 0; k < SPECTRUM_FFT_SIZE / 2; k++)
+    {
+        s_cos[k] = lroundf(32767.0f * cosf(2.0f * (float)M_PI * k / SPECTRUM_FFT_SIZE));
+        s_sin[k] = lroundf(32767.0f * sinf(2.0f * (float)M_PI * k / SPECTRUM_FFT_SIZE));
+    }
+
+    // Log spaced band edges, every band gets at least one bin
+    float ratio = powf((float)SPECTRUM_MAX_HZ / SPECTRUM_MIN_HZ, 1.0f / RGB_MATRIX_AUDIO_BANDS);
+    float freq = SPECTRUM_MIN_HZ;
+    int last = 0;
+    for (int i = 0; i <= RGB_MATRIX_AUDIO_BANDS; i++)
+    {
+        int bin = lroundf(freq * SPECTRUM_FFT_SIZE / sample_rate);
+        int max = SPECTRUM_FFT_SIZE / 2 - (RGB_MATRIX_AUDIO_BANDS - i);
+        bin = bin <= last ? last + 1 : bin;
+        bin = bin > max ? max : bin;
+        s_band_start[i] = bin;
+        last = bin;
+        freq *= ratio;
+    }
+
+    memset(&s_frame, 0, sizeof(s_frame));
+    ESP_LOGI(TAG, "%d bands, %d - %d Hz, %d point FFT", RGB_MATRIX_AUDIO_BANDS, SPECTRUM_MIN_HZ, SPECTRUM_MAX_HZ, SPECTRUM_FFT_SIZE);
+
+    // Below the audio tasks, a late spectrum only delays the LEDs
+    if (s_task == NULL && xTaskCreate(spectrum_task, "spectrum_task", 3 * 1024, NULL, 2, &s_task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create the spectrum task");
+    }
+}
+
+static bool spectrum_wanted(void)
+{
+    if (!rgb_matrix_is_enabled())
+    {
+        return false;
+    }
+    switch (rgb_matrix_get_mode())
+    {
+#ifdef CONFIG_ENABLE_RGB_MATRIX_AUDIO_VU_METER
+    case RGB_MATRIX_AUDIO_VU_METER:
+        return true;
+#endif
+#ifdef CONFIG_ENABLE_RGB_MATRIX_AUDIO_SPECTRUM
+    case RGB_MATRIX_AUDIO_SPECTRUM:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+// Radix-2 DIT FFT in place on s_re/s_im, scaled by 1/2 per stage so it cannot overflow
+static void spectrum_fft(void)
+{
+    for (int len = 2; len <= SPECTRUM_FFT_SIZE; len <<= 1)
+    {
+        int half = len >> 1;
+        int step = SPECTRUM_FFT_SIZE / len;
+        for (int i = 0; i < SPECTRUM_FFT_SIZE; i += len)
+        {
+            for (int j = 0; j < half; j++)
+            {
+                int32_t wr = s_cos[j * step];
+                int32_t wi = -s_sin[j * step];
+                int a = i + j;
+                int b = a + half;
+                int32_t tr = ((int64_t)s_re[b] * wr - (int64_t)s_im[b] * wi) >> 15;
+                int32_t ti = ((int64_t)s_re[b] * wi + (int64_t)s_im[b] * wr) >> 15;
+                s_re[b] = (s_re[a] - tr) >> 1;
+                s_im[b] = (s_im[a] - ti) >> 1;
+                s_re[a] = (s_re[a] + tr) >> 1;
+                s_im[a] = (s_im[a] + ti) >> 1;
+            }
+        }
+    }
+}
+
+// log2(x) with 3 fractional bits, mantissa linearly interpolated
+static int32_t log2_q3(uint64_t x)
+{
+    if (x == 0)
+    {
+        return 0;
+    }
+    int msb = 63 - __builtin_clzll(x);
+    int frac = msb >= 3 ? (x >> (msb - 3)) & 7 : (x << (3 - msb)) & 7;
+    return msb * 8 + frac;
+}
+
+static uint8_t spectrum_scale(int32_t power_q3, int32_t floor_q3, uint8_t last)
+{
+    int32_t value = (power_q3 - floor_q3) * SPECTRUM_GAIN;
+    if (value < 0)
+    {
+        value = 0;
+    }
+    else if (value > 255)
+    {
+        value = 255;
+    }
+    // Fast attack, slow release
+    if (value < (int32_t)last - SPECTRUM_RELEASE)
+    {
+        value = last - SPECTRUM_RELEASE;
+    }
+    return value;
+}
+
+static void spectrum_analyse(const int16_t *data, int samples)
+{
+    uint64_t energy = 0;
+
+    for (int n = 0; n < samples; n++)
+    {
+        int32_t x = data[n];
+        energy += x * x;
+    }
+
+    // Zero padded if the block was short
+    for (int n = 0; n < SPECTRUM_FFT_SIZE; n++)
+    {
+        int32_t x = n < samples ? data[n] : 0;
+        s_re[s_bitrev[n]] = (x * s_window[n]) >> 15;
+        s_im[s_bitrev[n]] = 0;
+    }
+    spectrum_fft();
+
+    s_frame.level = spectrum_scale(log2_q3(energy / samples), SPECTRUM_LEVEL_FLOOR_Q3, s_frame.level);
+    for (int i = 0; i < RGB_MATRIX_AUDIO_BANDS; i++)
+    {
+        uint64_t power = 0;
+        for (int k = s_band_start[i]; k < s_band_start[i + 1]; k++)
+        {
+            power += (int64_t)s_re[k] * s_re[k] + (int64_t)s_im[k] * s_im[k];
+        }
+        s_frame.band[i] = spectrum_scale(log2_q3(power), SPECTRUM_BAND_FLOOR_Q3, s_frame.band[i]);
+    }
+    rgb_matrix_audio_publish(&s_frame);
+}
+
+static void spectrum_task(void *arg)
+{
+    int16_t *block = s_input[2];
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        portENTER_CRITICAL(&s_input_lock);
+        int samples = s_ready_len;
+        if (samples > 0)
+        {
+            int16_t *ready = s_ready;
+            s_ready = block;
+            block = ready;
+            s_ready_len = 0;
+        }
+        portEXIT_CRITICAL(&s_input_lock);
+        if (samples > 0)
+        {
+            spectrum_analyse(block, samples);
+        }
+    }
+}
+
+void app_spectrum_feed(const int16_t *data, int samples, int stride)
+{
+    if (samples <= 0 || s_task == NULL || !spectrum_wanted())
+    {
+        return;
+    }
+
+    // Only the copy runs in the feed task, a block the spectrum task missed is replaced
+    int offset = samples > SPECTRUM_FFT_SIZE ? samples - SPECTRUM_FFT_SIZE : 0;
+    int len = samples - offset;
+    for (int n = 0; n < len; n++)
+    {
+        s_fill[n] = data[(n + offset) * stride];
+    }
+    portENTER_CRITICAL(&s_input_lock);
+    int16_t *ready = s_ready;
+    s_ready = s_fill;
+    s_fill = ready;
+    s_ready_len = len;
+    portEXIT_CRITICAL(&s_input_lock);
+    xTaskNotifyGive(s_task);
+}
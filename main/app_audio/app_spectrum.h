@@ -0,0 +1,32 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define SPECTRUM_SAMPLE_RATE    (16000)
+#define SPECTRUM_MIN_HZ         (60)
+#define SPECTRUM_MAX_HZ         (6000)
+
+/**
+ * @brief Build the FFT tables and band edges for the RGB matrix audio bands and start the
+ * low priority task that analyses the blocks.
+ */
+void app_spectrum_init(int sample_rate);
+
+/**
+ * @brief Hand one block of microphone samples to the spectrum task, which publishes the band
+ * energies to the RGB matrix.
+ *
+ * Copies the newest 256 samples of the first channel of an interleaved buffer, the FFT runs
+ * outside the caller. Returns immediately unless an audio reactive effect is selected.
+ *
+ * @param data     interleaved 16 bit samples
+ * @param samples  samples per channel
+ * @param stride   number of interleaved channels
+ */
+void app_spectrum_feed(const int16_t *data, int samples, int stride);
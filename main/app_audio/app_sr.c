@@ -28,7 +28,10 @@
 
 #include "bsp_keyboard.h"
 #include "app_sr.h"
+#include "app_aec_ref.h"
+#include "app_asr.h"
 #include "app_audio.h"
+#include "app_spectrum.h"
 #include "app_wifi.h"
 #include "function_keys.h"
 
@@ -40,11 +43,6 @@ static bool manul_detect_flag = false;
 
 sr_data_t *g_sr_data = NULL;
 
-#define I2S_CHANNEL_NUM 2
-
-extern bool record_flag;
-extern uint32_t record_total_len;
-
 static void audio_feed_task(void *arg)
 {
     ESP_LOGI(TAG, "Feed Task");
@@ -58,6 +56,7 @@ static void audio_feed_task(void *arg)
     int16_t *audio_buffer = heap_caps_malloc(audio_chunksize * sizeof(int16_t) * feed_channel, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
     assert(audio_buffer);
     g_sr_data->afe_in_buffer = audio_buffer;
+    app_spectrum_init(SPECTRUM_SAMPLE_RATE);
 
     while (true)
     {
@@ -69,22 +68,28 @@ static void audio_feed_task(void *arg)
         }
 
         /* Read audio data from I2S bus */
-        bsp_i2s_read((char *)audio_buffer, audio_chunksize * I2S_CHANNEL_NUM * sizeof(int16_t), &bytes_read, portMAX_DELAY);
+        bsp_i2s_read((char *)audio_buffer, audio_chunksize * BSP_I2S_RX_CHANNELS * sizeof(int16_t), &bytes_read, portMAX_DELAY);
 
+#if BSP_I2S_RX_CHANNELS < 3
         // AFE需要3通道数据, 将第3通道（参考回路）置0
-        // 如不需要AEC功能, 只需两通道mic数据即可
+        // TDM模式下DMA已按AFE的通道顺序写入, 无需这一步
         for (int i = audio_chunksize - 1; i >= 0; i--)
         {
             audio_buffer[i * 3 + 2] = 0;
             audio_buffer[i * 3 + 1] = audio_buffer[i * 2 + 1];
             audio_buffer[i * 3 + 0] = audio_buffer[i * 2 + 0];
         }
+#endif
+#if CONFIG_APP_SR_AEC_PLAYBACK
+        // 参考通道为同一I2S时钟下播放的数据, 与采集逐帧对齐
+        app_aec_ref_read(&audio_buffer[2], audio_chunksize, feed_channel);
+#endif
 
         /* Feed samples of an audio stream to the AFE_SR */
         afe_handle->feed(afe_data, audio_buffer);
 
-        // 保存音频数据
-        audio_record_save(audio_buffer, audio_chunksize);
+        // 灯效频谱分析, 只在选中音频灯效时复制数据, 由低优先级任务计算
+        app_spectrum_feed(audio_buffer, audio_chunksize, feed_channel);
     }
 
     ESP_LOGI(TAG, "Feed Task Delete");
@@ -120,6 +125,9 @@ static void audio_detect_task(void *arg)
             continue;
         }
 
+        // 保存回声消除后的音频, 唤醒提示音不会进入预录音
+        audio_record_save(res->data, res->data_size / sizeof(int16_t));
+
         // 手动检测
         if (getRecKey())
         {
@@ -252,7 +260,12 @@ esp_err_t app_sr_start(void)
     afe_config_t afe_config = AFE_CONFIG_DEFAULT();
 
     afe_config.wakenet_model_name = esp_srmodel_filter(models, ESP_WN_PREFIX, NULL);
+#if CONFIG_APP_SR_AEC_PLAYBACK || CONFIG_APP_SR_AEC_MIC3
+    // 回声消除后播放时也能唤醒
+    afe_config.aec_init = true;
+#else
     afe_config.aec_init = false;
+#endif
 
     esp_afe_sr_data_t *afe_data = afe_handle->create_from_config(&afe_config);
     g_sr_data->afe_handle = afe_handle;
@@ -262,6 +275,13 @@ esp_err_t app_sr_start(void)
     ret = app_sr_set_language(SR_LANG_CN);
     ESP_GOTO_ON_FALSE(ESP_OK == ret, ESP_FAIL, err, TAG, "Failed to set language");
 
+    // 识别上传的锁在处理任务启动前创建
+    ret = app_asr_init();
+    ESP_GOTO_ON_FALSE(ESP_OK == ret, ESP_ERR_NO_MEM, err, TAG, "Failed to init asr");
+
+    // 录音缓存, 回声参考和混音器在采集和处理任务启动前就绪, 任务第一次运行时就会用到
+    audio_record_init();
+
     // 采集音频数据
     ret_val = xTaskCreatePinnedToCore(&audio_feed_task, "Feed Task", 8 * 1024, (void *)afe_data, 5, &g_sr_data->feed_task, 0);
     ESP_GOTO_ON_FALSE(pdPASS == ret_val, ESP_FAIL, err, TAG, "Failed create audio feed task");
@@ -272,8 +292,6 @@ esp_err_t app_sr_start(void)
     ret_val = xTaskCreatePinnedToCore(&sr_handler_task, "SR Handler Task", 8 * 1024, NULL, configMAX_PRIORITIES - 1, &g_sr_data->handle_task, 0);
     ESP_GOTO_ON_FALSE(pdPASS == ret_val, ESP_FAIL, err, TAG, "Failed create audio handler task");
 
-    audio_record_init();
-
     return ESP_OK;
 err:
     app_sr_stop();
@@ -0,0 +1,302 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "audio_stream.h"
+#include "baidu_api.h"
+#include "app_tts.h"
+
+static const char *TAG = "app_tts";
+
+// Shorter sentences are joined with the next one, every request costs a round trip
+#define TTS_MIN_CHUNK       (12)
+// The first chunk may end at a comma once it is this long, it decides the time to first audio
+#define TTS_FIRST_CHUNK     (24)
+// Longer text is cut at the last comma, or at a character boundary without one
+#define TTS_MAX_CHUNK       (300)
+#define TTS_QUEUE_LEN       (16)
+// The next sentence is synthesized while the current one plays, allow for a slow request
+#define TTS_UNDERRUN_MS     (10000)
+
+typedef struct
+{
+    audio_stream_t *stream;
+    volatile bool aborted;
+    uint32_t generation;
+    int chunks;
+    int64_t start_us;
+} tts_session_t;
+
+typedef struct
+{
+    tts_session_t *session;
+    char *text; // NULL ends the session
+} tts_item_t;
+
+static const char *const s_sentence_ends[] = {"。", "！", "？", "；", "…", "!", "?", ";", "\n"};
+static const char *const s_clause_ends[] = {"，", "、", "：", ",", ":"};
+
+static QueueHandle_t s_queue = NULL;
+static tts_session_t *s_session = NULL;
+static volatile uint32_t s_generation = 0; // sessions begun before the last app_tts_cancel() are dropped
+static SemaphoreHandle_t s_active_lock = NULL;
+static tts_session_t *s_active = NULL;     // session of the sentence being synthesized
+static char *s_text = NULL;
+static size_t s_text_len = 0;
+static size_t s_text_cap = 0;
+
+static size_t tts_match(const char *text, size_t len, const char *const *ends, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t end_len = strlen(ends[i]);
+        if (end_len <= len && memcmp(text, ends[i], end_len) == 0)
+        {
+            return end_len;
+        }
+    }
+    return 0;
+}
+
+// Length of the next chunk in s_text, 0 if more text is needed
+static size_t tts_find_chunk(bool first, bool flush)
+{
+    size_t clause = 0;
+
+    for (size_t i = 0; i < s_text_len; i++)
+    {
+        size_t n = tts_match(s_text + i, s_text_len - i, s_sentence_ends, sizeof(s_sentence_ends) / sizeof(s_sentence_ends[0]));
+        // A period ends a sentence only before white space, not inside 3.14 or a URL
+        if (!n && s_text[i] == '.' && i + 1 < s_text_len && (s_text[i + 1] == ' ' || s_text[i + 1] == '\n'))
+        {
+            n = 1;
+        }
+        if (n && i + n >= TTS_MIN_CHUNK)
+        {
+            return i + n;
+        }
+
+        size_t c = tts_match(s_text + i, s_text_len - i, s_clause_ends, sizeof(s_clause_ends) / sizeof(s_clause_ends[0]));
+        if (c && i + c <= TTS_MAX_CHUNK)
+        {
+            clause = i + c;
+            if (first && clause >= TTS_FIRST_CHUNK)
+            {
+                return clause;
+            }
+        }
+        if (i >= TTS_MAX_CHUNK)
+        {
+            if (clause)
+            {
+                return clause;
+            }
+            // Back up to the start of a UTF-8 character
+            size_t cut = TTS_MAX_CHUNK;
+            while (cut > 0 && (s_text[cut] & 0xc0) == 0x80)
+            {
+                cut--;
+            }
+            return cut;
+        }
+    }
+    return flush ? s_text_len : 0;
+}
+
+static void tts_queue_chunk(size_t len)
+{
+    const char *start = s_text;
+    size_t n = len;
+
+    while (n && (*start == ' ' || *start == '\n' || *start == '\r' || *start == '\t'))
+    {
+        start++;
+        n--;
+    }
+    while (n && (start[n - 1] == ' ' || start[n - 1] == '\n' || start[n - 1] == '\r' || start[n - 1] == '\t'))
+    {
+        n--;
+    }
+
+    if (n)
+    {
+        tts_item_t item = {.session = s_session, .text = strndup(start, n)};
+        if (item.text)
+        {
+            s_session->chunks++;
+            xQueueSend(s_queue, &item, portMAX_DELAY);
+        }
+    }
+
+    s_text_len -= len;
+    memmove(s_text, s_text + len, s_text_len);
+}
+
+static void tts_task(void *arg)
+{
+    tts_item_t item;
+
+    while (1)
+    {
+        xQueueReceive(s_queue, &item, portMAX_DELAY);
+        tts_session_t *session = item.session;
+
+        if (item.text)
+        {
+            // Checked under the lock, a later app_tts_cancel() aborts the stream instead
+            xSemaphoreTake(s_active_lock, portMAX_DELAY);
+            if (session->generation != s_generation)
+            {
+                session->aborted = true;
+            }
+            s_active = session->aborted ? NULL : session;
+            xSemaphoreGive(s_active_lock);
+            if (!session->aborted)
+            {
+                ESP_LOGI(TAG, "Synthesizing: %s", item.text);
+                esp_err_t err = baidu_tts_stream(item.text, strlen(item.text), session->stream);
+                xSemaphoreTake(s_active_lock, portMAX_DELAY);
+                s_active = NULL;
+                xSemaphoreGive(s_active_lock);
+                if (err == ESP_ERR_INVALID_STATE)
+                {
+                    // The player closed the stream or the answer was cancelled
+                    ESP_LOGW(TAG, "Playback stopped, dropping the rest of the answer");
+                    session->aborted = true;
+                }
+                else if (err != ESP_OK)
+                {
+                    ESP_LOGE(TAG, "Sentence skipped: %s", esp_err_to_name(err));
+                }
+            }
+            free(item.text);
+            continue;
+        }
+
+        ESP_LOGI(TAG, "%d sentences synthesized in %" PRIi64 " ms%s", session->chunks,
+                 (esp_timer_get_time() - session->start_us) / 1000, session->aborted ? ", aborted" : "");
+        audio_stream_finish(session->stream);
+        free(session);
+    }
+}
+
+esp_err_t app_tts_init(void)
+{
+    if (s_queue)
+    {
+        return ESP_OK;
+    }
+    s_active_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_active_lock, ESP_ERR_NO_MEM, TAG, "Failed to create the lock");
+    s_queue = xQueueCreate(TTS_QUEUE_LEN, sizeof(tts_item_t));
+    ESP_RETURN_ON_FALSE(s_queue, ESP_ERR_NO_MEM, TAG, "Failed to create the queue");
+    if (xTaskCreate(tts_task, "tts_task", 6 * 1024, NULL, 4, NULL) != pdPASS)
+    {
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        ESP_LOGE(TAG, "Failed to create the task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_tts_begin(void)
+{
+    ESP_RETURN_ON_FALSE(s_queue, ESP_ERR_INVALID_STATE, TAG, "app_tts_init() not called");
+
+    if (s_session)
+    {
+        s_session->aborted = true;
+        s_text_len = 0;
+        app_tts_end();
+    }
+
+    tts_session_t *session = calloc(1, sizeof(tts_session_t));
+    ESP_RETURN_ON_FALSE(session, ESP_ERR_NO_MEM, TAG, "Failed to allocate the session");
+    audio_stream_config_t config = AUDIO_STREAM_DEFAULT_CONFIG();
+    config.underrun_timeout_ms = TTS_UNDERRUN_MS;
+    session->stream = audio_stream_new(&config);
+    if (!session->stream)
+    {
+        free(session);
+        return ESP_ERR_NO_MEM;
+    }
+    session->start_us = esp_timer_get_time();
+    session->generation = s_generation;
+    s_session = session;
+    s_text_len = 0;
+    return ESP_OK;
+}
+
+esp_err_t app_tts_feed(const char *text, size_t len)
+{
+    ESP_RETURN_ON_FALSE(s_session, ESP_ERR_INVALID_STATE, TAG, "app_tts_begin() not called");
+    if (s_session->generation != s_generation)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (s_text_len + len > s_text_cap)
+    {
+        size_t cap = s_text_len + len + TTS_MAX_CHUNK;
+        char *grown = realloc(s_text, cap);
+        ESP_RETURN_ON_FALSE(grown, ESP_ERR_NO_MEM, TAG, "Failed to grow the text buffer");
+        s_text = grown;
+        s_text_cap = cap;
+    }
+    memcpy(s_text + s_text_len, text, len);
+    s_text_len += len;
+
+    size_t chunk;
+    while ((chunk = tts_find_chunk(s_session->chunks == 0, false)) > 0)
+    {
+        tts_queue_chunk(chunk);
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_tts_end(void)
+{
+    ESP_RETURN_ON_FALSE(s_session, ESP_ERR_INVALID_STATE, TAG, "app_tts_begin() not called");
+
+    size_t chunk;
+    while (s_text_len && (chunk = tts_find_chunk(s_session->chunks == 0, true)) > 0)
+    {
+        tts_queue_chunk(chunk);
+    }
+
+    tts_item_t item = {.session = s_session, .text = NULL};
+    xQueueSend(s_queue, &item, portMAX_DELAY);
+    s_session = NULL;
+    return ESP_OK;
+}
+
+void app_tts_cancel(void)
+{
+    s_generation++;
+    if (s_active_lock == NULL)
+    {
+        return;
+    }
+    // The sentence being downloaded would otherwise start playback once it is prebuffered
+    xSemaphoreTake(s_active_lock, portMAX_DELAY);
+    if (s_active)
+    {
+        audio_stream_abort(s_active->stream);
+    }
+    xSemaphoreGive(s_active_lock);
+}
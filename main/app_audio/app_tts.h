@@ -0,0 +1,47 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * Sentence pipelined text to speech. The text of an answer is split at sentence ends, every
+ * sentence is synthesized on its own while the previous ones play, and all clips go into one
+ * audio stream so they play back to back without gaps.
+ *
+ * app_tts_begin(), app_tts_feed() and app_tts_end() must be called from one task,
+ * app_tts_cancel() from any.
+ */
+
+/**
+ * @brief Start the synthesis task, once at startup before the calls below.
+ */
+esp_err_t app_tts_init(void);
+
+/**
+ * @brief Start a new answer, the one still playing or being synthesized is dropped.
+ */
+esp_err_t app_tts_begin(void);
+
+/**
+ * @brief Append text, complete sentences are queued for synthesis right away.
+ * The text may end anywhere, also inside a UTF-8 character.
+ */
+esp_err_t app_tts_feed(const char *text, size_t len);
+
+/**
+ * @brief Queue the rest of the text, the stream ends after its last sentence.
+ * Returns without waiting for the synthesis.
+ */
+esp_err_t app_tts_end(void);
+
+/**
+ * @brief Drop every answer begun so far, sentences not synthesized yet are skipped and text
+ * still fed to them is ignored. Stop the player as well for the audio already playing.
+ */
+void app_tts_cancel(void);
@@ -0,0 +1,322 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "audio_player.h"
+#include "audio_stream.h"
+
+static const char *TAG = "audio_stream";
+
+#define STREAM_DATA_BIT  BIT0
+#define STREAM_SPACE_BIT BIT1
+#define STREAM_MIN_SIZE  (2 * 1024)
+
+struct audio_stream
+{
+    uint8_t *buf;
+    size_t size;
+    size_t prebuffer;
+    TickType_t underrun_timeout;
+    // Absolute stream positions, the buffer holds [tail, head)
+    uint32_t head;
+    uint32_t tail;
+    bool finished;
+    bool opened; // a reader was opened, playback started
+    bool closed;
+    int64_t created_us;
+    int refs;
+    audio_stream_stats_t stats;
+    SemaphoreHandle_t lock;
+    EventGroupHandle_t events;
+};
+
+static void stream_release(audio_stream_t *s)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    bool last = --s->refs == 0;
+    xSemaphoreGive(s->lock);
+    if (!last)
+    {
+        return;
+    }
+    ESP_LOGI(TAG, "Stream done, %" PRIu32 " bytes written, %" PRIu32 " read, %" PRIu32 " underruns, %" PRIu32 " dropped",
+             s->stats.written, s->stats.read, s->stats.underruns, s->stats.dropped);
+    vEventGroupDelete(s->events);
+    vSemaphoreDelete(s->lock);
+    heap_caps_free(s->buf);
+    free(s);
+}
+
+// Wait with the lock held until pos is buffered or the writer finished, false on timeout
+static bool stream_wait_data(audio_stream_t *s, uint32_t pos)
+{
+    bool counted = false;
+    while (s->head < pos && !s->finished)
+    {
+        if (!counted && s->tail > 0)
+        {
+            s->stats.underruns++;
+            counted = true;
+        }
+        xSemaphoreGive(s->lock);
+        EventBits_t bits = xEventGroupWaitBits(s->events, STREAM_DATA_BIT, pdTRUE, pdFALSE, s->underrun_timeout);
+        xSemaphoreTake(s->lock, portMAX_DELAY);
+        if (!(bits & STREAM_DATA_BIT) && s->head < pos && !s->finished)
+        {
+            ESP_LOGW(TAG, "No data for %" PRIu32 " ms at %" PRIu32 ", ending playback",
+                     pdTICKS_TO_MS(s->underrun_timeout), s->tail);
+            return false;
+        }
+    }
+    return true;
+}
+
+static ssize_t stream_read(void *cookie, char *buf, size_t size)
+{
+    audio_stream_t *s = cookie;
+
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    if (!stream_wait_data(s, s->tail + 1))
+    {
+        xSemaphoreGive(s->lock);
+        return 0;
+    }
+    size_t n = s->head - s->tail;
+    n = n < size ? n : size;
+    size_t at = s->tail % s->size;
+    size_t first = n < s->size - at ? n : s->size - at;
+    memcpy(buf, s->buf + at, first);
+    memcpy(buf + first, s->buf, n - first);
+    s->tail += n;
+    s->stats.read += n;
+    xSemaphoreGive(s->lock);
+
+    xEventGroupSetBits(s->events, STREAM_SPACE_BIT);
+    return n;
+}
+
+static int stream_seek(void *cookie, off_t *offset, int whence)
+{
+    audio_stream_t *s = cookie;
+    int ret = 0;
+
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    int64_t pos = *offset;
+    if (whence == SEEK_CUR)
+    {
+        pos += s->tail;
+    }
+    else if (whence == SEEK_END)
+    {
+        // Only known once the download is complete
+        pos = s->finished ? pos + s->head : -1;
+    }
+
+    // Forward seeks wait for the data, the player reads the stream once and never seeks back
+    if (pos < s->tail || pos > UINT32_MAX || !stream_wait_data(s, pos) || pos > s->head)
+    {
+        ret = -1;
+    }
+    else
+    {
+        s->tail = pos;
+        *offset = pos;
+    }
+    xSemaphoreGive(s->lock);
+
+    xEventGroupSetBits(s->events, STREAM_SPACE_BIT);
+    return ret;
+}
+
+static int stream_close(void *cookie)
+{
+    audio_stream_t *s = cookie;
+
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    s->closed = true;
+    xSemaphoreGive(s->lock);
+    // Wake a writer blocked on a full buffer
+    xEventGroupSetBits(s->events, STREAM_SPACE_BIT);
+    stream_release(s);
+    return 0;
+}
+
+audio_stream_t *audio_stream_new(const audio_stream_config_t *config)
+{
+    audio_stream_t *s = calloc(1, sizeof(audio_stream_t));
+    if (!s)
+    {
+        return NULL;
+    }
+    s->size = config->size > STREAM_MIN_SIZE ? config->size : STREAM_MIN_SIZE;
+    s->prebuffer = config->prebuffer < s->size ? config->prebuffer : s->size;
+    s->underrun_timeout = pdMS_TO_TICKS(config->underrun_timeout_ms);
+    s->refs = 1;
+    s->created_us = esp_timer_get_time();
+    s->buf = heap_caps_malloc(s->size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s->lock = xSemaphoreCreateMutex();
+    s->events = xEventGroupCreate();
+    if (!s->buf || !s->lock || !s->events)
+    {
+        ESP_LOGE(TAG, "Failed to allocate a %u byte stream", (unsigned)s->size);
+        if (s->events)
+        {
+            vEventGroupDelete(s->events);
+        }
+        if (s->lock)
+        {
+            vSemaphoreDelete(s->lock);
+        }
+        heap_caps_free(s->buf);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+FILE *audio_stream_open_reader(audio_stream_t *stream)
+{
+    cookie_io_functions_t io = {
+        .read = stream_read,
+        .write = NULL,
+        .seek = stream_seek,
+        .close = stream_close,
+    };
+
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    stream->refs++;
+    stream->opened = true;
+    xSemaphoreGive(stream->lock);
+
+    FILE *fp = fopencookie(stream, "rb", io);
+    if (!fp)
+    {
+        stream_release(stream);
+        return NULL;
+    }
+    // The ring buffer already buffers, and unbuffered seeks map directly to stream_seek()
+    setvbuf(fp, NULL, _IONBF, 0);
+    return fp;
+}
+
+esp_err_t audio_stream_write(audio_stream_t *stream, const void *data, size_t len, TickType_t timeout)
+{
+    audio_stream_t *s = stream;
+    const uint8_t *src = data;
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    while (len)
+    {
+        if (s->closed)
+        {
+            ret = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        size_t space = s->size - (s->head - s->tail);
+        if (space == 0)
+        {
+            xSemaphoreGive(s->lock);
+            EventBits_t bits = xEventGroupWaitBits(s->events, STREAM_SPACE_BIT, pdTRUE, pdFALSE, timeout);
+            xSemaphoreTake(s->lock, portMAX_DELAY);
+            if (!(bits & STREAM_SPACE_BIT) && s->size == s->head - s->tail)
+            {
+                ret = ESP_ERR_TIMEOUT;
+                break;
+            }
+            continue;
+        }
+
+        size_t n = len < space ? len : space;
+        size_t at = s->head % s->size;
+        size_t first = n < s->size - at ? n : s->size - at;
+        memcpy(s->buf + at, src, first);
+        memcpy(s->buf, src + first, n - first);
+        s->head += n;
+        s->stats.written += n;
+        src += n;
+        len -= n;
+        xEventGroupSetBits(s->events, STREAM_DATA_BIT);
+    }
+    s->stats.dropped += len;
+    xSemaphoreGive(s->lock);
+    return ret;
+}
+
+bool audio_stream_ready(audio_stream_t *stream)
+{
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    bool ready = stream->finished || stream->head >= stream->prebuffer;
+    xSemaphoreGive(stream->lock);
+    return ready;
+}
+
+esp_err_t audio_stream_start_playback(audio_stream_t *stream)
+{
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    bool opened = stream->opened;
+    bool closed = stream->closed;
+    xSemaphoreGive(stream->lock);
+    if (opened)
+    {
+        return ESP_OK;
+    }
+    if (closed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    FILE *fp = audio_stream_open_reader(stream);
+    if (!fp)
+    {
+        ESP_LOGE(TAG, "Failed to open the stream reader");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = audio_player_play(fp);
+    if (ret != ESP_OK)
+    {
+        fclose(fp);
+        return ret;
+    }
+    ESP_LOGI(TAG, "Playback started %" PRIi64 " ms after the stream was created", (esp_timer_get_time() - stream->created_us) / 1000);
+    return ESP_OK;
+}
+
+void audio_stream_abort(audio_stream_t *stream)
+{
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    stream->closed = true;
+    xSemaphoreGive(stream->lock);
+    // Wake a writer blocked on a full buffer
+    xEventGroupSetBits(stream->events, STREAM_SPACE_BIT);
+}
+
+void audio_stream_get_stats(audio_stream_t *stream, audio_stream_stats_t *stats)
+{
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    *stats = stream->stats;
+    xSemaphoreGive(stream->lock);
+}
+
+void audio_stream_finish(audio_stream_t *stream)
+{
+    xSemaphoreTake(stream->lock, portMAX_DELAY);
+    stream->finished = true;
+    xSemaphoreGive(stream->lock);
+    xEventGroupSetBits(stream->events, STREAM_DATA_BIT);
+    stream_release(stream);
+}
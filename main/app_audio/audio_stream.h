@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+/**
+ * A ring buffer between a network download and the audio player. The writer appends the
+ * encoded audio as it arrives, the player reads it through a FILE opened with
+ * audio_stream_open_reader(), so decoding starts before the download is complete.
+ */
+typedef struct audio_stream audio_stream_t;
+
+typedef struct
+{
+    size_t size;                  // ring buffer size in bytes, allocated in PSRAM
+    size_t prebuffer;             // bytes buffered before audio_stream_ready() reports true
+    uint32_t underrun_timeout_ms; // a reader waiting longer than this for data sees end of file
+} audio_stream_config_t;
+
+#define AUDIO_STREAM_DEFAULT_CONFIG() \
+    {                                 \
+        .size = 64 * 1024,            \
+        .prebuffer = 2 * 1024,        \
+        .underrun_timeout_ms = 5000,  \
+    }
+
+typedef struct
+{
+    uint32_t written;   // bytes accepted from the writer
+    uint32_t read;      // bytes handed to the reader
+    uint32_t underruns; // times the reader ran dry after playback started
+    uint32_t dropped;   // bytes discarded because the reader was gone or too slow
+} audio_stream_stats_t;
+
+/**
+ * @brief Create a stream, the caller holds the writer reference.
+ */
+audio_stream_t *audio_stream_new(const audio_stream_config_t *config);
+
+/**
+ * @brief Open the read side as a FILE for audio_player_play(), fclose() releases it.
+ * Only one reader may be open at a time.
+ */
+FILE *audio_stream_open_reader(audio_stream_t *stream);
+
+/**
+ * @brief Append data, blocks while the ring buffer is full.
+ *
+ * @return ESP_ERR_INVALID_STATE once the reader is closed, ESP_ERR_TIMEOUT if the reader did
+ *         not make room in time. The data not written is counted as dropped.
+ */
+esp_err_t audio_stream_write(audio_stream_t *stream, const void *data, size_t len, TickType_t timeout);
+
+/**
+ * @brief True once prebuffer bytes are buffered or the writer has finished.
+ */
+bool audio_stream_ready(audio_stream_t *stream);
+
+/**
+ * @brief Open the reader and hand it to audio_player_play(), once per stream.
+ * Later calls return ESP_OK without doing anything.
+ */
+esp_err_t audio_stream_start_playback(audio_stream_t *stream);
+
+/**
+ * @brief Refuse the rest of the data and never start playback, callable from another task
+ * while the writer holds its reference. A reader already open reads what is buffered.
+ */
+void audio_stream_abort(audio_stream_t *stream);
+
+/**
+ * @brief Statistics so far, the final ones are logged when the stream is freed.
+ */
+void audio_stream_get_stats(audio_stream_t *stream, audio_stream_stats_t *stats);
+
+/**
+ * @brief No more data, the reader sees end of file after the buffered data.
+ * Releases the writer reference, the stream must not be used by the writer afterwards.
+ */
+void audio_stream_finish(audio_stream_t *stream);
@@ -0,0 +1,436 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_crt_bundle.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/netdb.h"
+
+#include "app_http.h"
+
+static const char *TAG = "app_http";
+
+// Kept clients, one TLS connection holds about 10 KB with the dynamic mbedTLS buffers
+#define HTTP_POOL_SIZE      (4)
+// Servers drop idle keep-alive connections, close ours before a request would find it dead
+#define HTTP_IDLE_MS        (30000)
+#define HTTP_MAX_HEADERS    (8)
+#define HTTP_KEY_LEN        (96)
+// Big enough for the TTS audio chunks and the ASR request, the same for every client
+#define HTTP_BUFFER_SIZE    (4096)
+#define HTTP_BUFFER_SIZE_TX (4096)
+
+typedef struct
+{
+    esp_http_client_handle_t client;
+    char key[HTTP_KEY_LEN]; // scheme://host:port
+    bool pooled;            // false for a client made because all slots were busy
+    bool busy;
+    bool connected;
+    int64_t idle_since_us;
+    http_event_handle_cb handler;
+    void *user_data;
+    char *headers[HTTP_MAX_HEADERS];
+    int header_count;
+    // Timestamps of the current request, 0 until the step happens
+    int64_t start_us;
+    int64_t dns_us;
+    int64_t connected_us;
+    int64_t sent_us;
+    int64_t first_byte_us;
+    int64_t finish_us;
+    uint32_t received;
+    bool reused;
+} http_conn_t;
+
+static http_conn_t s_pool[HTTP_POOL_SIZE];
+static SemaphoreHandle_t s_lock = NULL;
+
+// "https://tsn.baidu.com/text2audio?a=b" -> "https://tsn.baidu.com", false if it does not fit
+static bool http_url_key(const char *url, char *key)
+{
+    const char *host = strstr(url, "://");
+    host = host ? host + 3 : url;
+    size_t len = host - url + strcspn(host, "/?#");
+    if (len >= HTTP_KEY_LEN)
+    {
+        return false;
+    }
+    memcpy(key, url, len);
+    key[len] = '\0';
+    return true;
+}
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    http_conn_t *conn = evt->user_data;
+    int64_t now = esp_timer_get_time();
+
+    switch (evt->event_id)
+    {
+    case HTTP_EVENT_ON_CONNECTED:
+        conn->connected = true;
+        conn->connected_us = now;
+        break;
+    case HTTP_EVENT_HEADER_SENT:
+        conn->sent_us = now;
+        break;
+    case HTTP_EVENT_ON_HEADER:
+        if (!conn->first_byte_us)
+        {
+            conn->first_byte_us = now;
+        }
+        break;
+    case HTTP_EVENT_ON_DATA:
+        if (!conn->first_byte_us)
+        {
+            conn->first_byte_us = now;
+        }
+        conn->received += evt->data_len;
+        break;
+    case HTTP_EVENT_ON_FINISH:
+        conn->finish_us = now;
+        break;
+    case HTTP_EVENT_DISCONNECTED:
+        conn->connected = false;
+        break;
+    default:
+        break;
+    }
+
+    if (conn->handler)
+    {
+        evt->user_data = conn->user_data;
+        conn->handler(evt);
+        evt->user_data = conn;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t http_conn_init(http_conn_t *conn, const char *url)
+{
+    esp_http_client_config_t config = {
+        .url = url,
+        .event_handler = http_event_handler,
+        .user_data = conn,
+        .buffer_size = HTTP_BUFFER_SIZE,
+        .buffer_size_tx = HTTP_BUFFER_SIZE_TX,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .keep_alive_enable = true,
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        // Reconnects resume the TLS session instead of a full handshake
+        .save_client_session = true,
+#endif
+    };
+    conn->client = esp_http_client_init(&config);
+    conn->connected = false;
+    return conn->client ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t app_http_init(void)
+{
+    if (s_lock == NULL)
+    {
+        s_lock = xSemaphoreCreateMutex();
+    }
+    return s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_http_client_handle_t app_http_acquire(const char *url, http_event_handle_cb event_handler, void *user_data)
+{
+    char key[HTTP_KEY_LEN];
+    http_conn_t *conn = NULL;
+    http_conn_t *oldest = NULL;
+    bool keyed = http_url_key(url, key);
+    int64_t now = esp_timer_get_time();
+
+    if (s_lock == NULL)
+    {
+        ESP_LOGE(TAG, "app_http_init() was not called");
+        return NULL;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; keyed && i < HTTP_POOL_SIZE; i++)
+    {
+        http_conn_t *slot = &s_pool[i];
+        if (slot->busy)
+        {
+            continue;
+        }
+        if (slot->client && strcmp(slot->key, key) == 0)
+        {
+            conn = slot;
+            break;
+        }
+        // An empty slot, or else the client idle for longest, is given to a new host
+        if (!oldest || (oldest->client && (!slot->client || slot->idle_since_us < oldest->idle_since_us)))
+        {
+            oldest = slot;
+        }
+    }
+    if (!conn && oldest)
+    {
+        conn = oldest;
+        if (conn->client)
+        {
+            ESP_LOGI(TAG, "Closing %s for %s", conn->key, key);
+            esp_http_client_cleanup(conn->client);
+            conn->client = NULL;
+        }
+        strcpy(conn->key, key);
+    }
+    if (conn)
+    {
+        conn->busy = true;
+        conn->pooled = true;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (!conn)
+    {
+        // All slots busy, this client is closed on release
+        conn = calloc(1, sizeof(http_conn_t));
+        if (!conn)
+        {
+            return NULL;
+        }
+        snprintf(conn->key, sizeof(conn->key), "%s", keyed ? key : "?");
+    }
+
+    if (conn->client)
+    {
+        esp_http_client_set_url(conn->client, url);
+        if (conn->connected && now - conn->idle_since_us > HTTP_IDLE_MS * 1000LL)
+        {
+            esp_http_client_close(conn->client);
+        }
+    }
+    else if (http_conn_init(conn, url) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create a client for %s", conn->key);
+        if (conn->pooled)
+        {
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            conn->busy = false;
+            xSemaphoreGive(s_lock);
+        }
+        else
+        {
+            free(conn);
+        }
+        return NULL;
+    }
+    conn->handler = event_handler;
+    conn->user_data = user_data;
+    return conn->client;
+}
+
+esp_err_t app_http_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    http_conn_t *conn = NULL;
+    esp_http_client_get_user_data(client, (void **)&conn);
+
+    bool known = false;
+    for (int i = 0; i < conn->header_count && !known; i++)
+    {
+        known = strcasecmp(conn->headers[i], key) == 0;
+    }
+    if (!known && conn->header_count < HTTP_MAX_HEADERS)
+    {
+        conn->headers[conn->header_count] = strdup(key);
+        if (conn->headers[conn->header_count])
+        {
+            conn->header_count++;
+        }
+    }
+    return esp_http_client_set_header(client, key, value);
+}
+
+// Time the name lookup when the request will connect. The resolver caches the answer, so the
+// lookup of the transport right after it costs nothing.
+static void http_request_begin(http_conn_t *conn)
+{
+    conn->start_us = esp_timer_get_time();
+    conn->dns_us = 0;
+    conn->connected_us = 0;
+    conn->sent_us = 0;
+    conn->first_byte_us = 0;
+    conn->finish_us = 0;
+    conn->received = 0;
+    conn->reused = conn->connected;
+    if (conn->connected)
+    {
+        return;
+    }
+
+    char host[HTTP_KEY_LEN];
+    const char *start = strstr(conn->key, "://");
+    start = start ? start + 3 : conn->key;
+    snprintf(host, sizeof(host), "%s", start);
+    host[strcspn(host, ":")] = '\0';
+
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, NULL, &hints, &res) == 0)
+    {
+        freeaddrinfo(res);
+    }
+    conn->dns_us = esp_timer_get_time();
+}
+
+// A kept connection the server already closed fails before any response arrives
+static bool http_stale(http_conn_t *conn, esp_err_t err)
+{
+    if (err == ESP_OK || !conn->reused || conn->first_byte_us)
+    {
+        return false;
+    }
+    ESP_LOGW(TAG, "Kept connection to %s failed (%s), reconnecting", conn->key, esp_err_to_name(err));
+    esp_http_client_close(conn->client);
+    conn->connected = false;
+    return true;
+}
+
+esp_err_t app_http_perform(esp_http_client_handle_t client)
+{
+    http_conn_t *conn = NULL;
+    esp_http_client_get_user_data(client, (void **)&conn);
+
+    http_request_begin(conn);
+    esp_err_t err = esp_http_client_perform(client);
+    if (http_stale(conn, err))
+    {
+        http_request_begin(conn);
+        err = esp_http_client_perform(client);
+    }
+    return err;
+}
+
+esp_err_t app_http_open(esp_http_client_handle_t client, int write_len)
+{
+    http_conn_t *conn = NULL;
+    esp_http_client_get_user_data(client, (void **)&conn);
+
+    http_request_begin(conn);
+    esp_err_t err = esp_http_client_open(client, write_len);
+    if (http_stale(conn, err))
+    {
+        http_request_begin(conn);
+        err = esp_http_client_open(client, write_len);
+    }
+    return err;
+}
+
+// Every step up to the response headers fails the same way on a stale connection
+static esp_err_t http_send(esp_http_client_handle_t client, const char *body, int len)
+{
+    esp_err_t err = esp_http_client_open(client, len);
+    if (err == ESP_OK && len > 0 && esp_http_client_write(client, body, len) != len)
+    {
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK && esp_http_client_fetch_headers(client) < 0)
+    {
+        err = ESP_FAIL;
+    }
+    return err;
+}
+
+esp_err_t app_http_send(esp_http_client_handle_t client, const char *body, int len)
+{
+    http_conn_t *conn = NULL;
+    esp_http_client_get_user_data(client, (void **)&conn);
+
+    http_request_begin(conn);
+    esp_err_t err = http_send(client, body, len);
+    if (http_stale(conn, err))
+    {
+        http_request_begin(conn);
+        err = http_send(client, body, len);
+    }
+    return err;
+}
+
+static uint32_t http_span(int64_t from, int64_t to)
+{
+    return from && to > from ? to - from : 0;
+}
+
+void app_http_release(esp_http_client_handle_t client, app_http_timing_t *timing)
+{
+    http_conn_t *conn = NULL;
+    int64_t now = esp_timer_get_time();
+    app_http_timing_t t;
+
+    if (client == NULL)
+    {
+        return;
+    }
+    esp_http_client_get_user_data(client, (void **)&conn);
+
+    int64_t end_us = conn->finish_us ? conn->finish_us : now;
+    int64_t ready_us = conn->connected_us ? conn->connected_us : conn->start_us;
+    t.dns_us = http_span(conn->start_us, conn->dns_us);
+    t.connect_us = http_span(conn->dns_us ? conn->dns_us : conn->start_us, conn->connected_us);
+    t.ttfb_us = http_span(conn->sent_us ? conn->sent_us : ready_us, conn->first_byte_us);
+    t.transfer_us = http_span(conn->first_byte_us, end_us);
+    t.total_us = http_span(conn->start_us, end_us);
+    t.received = conn->received;
+    t.reused = conn->reused;
+    if (conn->start_us)
+    {
+        ESP_LOGI(TAG, "%s %d: dns %" PRIu32 " ms, connect %" PRIu32 " ms, ttfb %" PRIu32 " ms, transfer %" PRIu32 " ms, total %" PRIu32 " ms, %" PRIu32 " bytes%s",
+                 conn->key, esp_http_client_get_status_code(client), t.dns_us / 1000, t.connect_us / 1000, t.ttfb_us / 1000,
+                 t.transfer_us / 1000, t.total_us / 1000, t.received, t.reused ? ", reused" : "");
+    }
+    if (timing)
+    {
+        *timing = t;
+    }
+
+    if (!conn->pooled)
+    {
+        esp_http_client_cleanup(client);
+        for (int i = 0; i < conn->header_count; i++)
+        {
+            free(conn->headers[i]);
+        }
+        free(conn);
+        return;
+    }
+
+    // The next request must not see this one's headers and body
+    for (int i = 0; i < conn->header_count; i++)
+    {
+        esp_http_client_delete_header(client, conn->headers[i]);
+        free(conn->headers[i]);
+    }
+    conn->header_count = 0;
+    esp_http_client_delete_header(client, "Transfer-Encoding");
+    esp_http_client_set_post_field(client, NULL, 0);
+    // Unread response data would be taken for the next response
+    if (conn->connected && !esp_http_client_is_complete_data_received(client))
+    {
+        esp_http_client_close(client);
+        conn->connected = false;
+    }
+    conn->handler = NULL;
+    conn->user_data = NULL;
+    conn->start_us = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    conn->idle_since_us = now;
+    conn->busy = false;
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+/**
+ * Keep-alive HTTP clients shared by the Baidu and ChatGPT requests. A released client stays
+ * connected and the next request to the same host reuses it, so only the first request pays
+ * for the TCP and TLS handshakes. A connection the server dropped is reopened on the next
+ * request, with a cached TLS session ticket when the server issued one.
+ *
+ * A client is used by one task between app_http_acquire() and app_http_release(), with the
+ * usual esp_http_client calls except for the ones wrapped here.
+ */
+
+typedef struct
+{
+    uint32_t dns_us;      // name lookup, 0 on a reused connection
+    uint32_t connect_us;  // TCP connect and TLS handshake, 0 on a reused connection
+    uint32_t ttfb_us;     // request headers sent to first response byte, includes the request body
+    uint32_t transfer_us; // first response byte to the end of the response
+    uint32_t total_us;
+    uint32_t received;    // response body bytes
+    bool reused;          // sent over a connection kept from an earlier request
+} app_http_timing_t;
+
+/**
+ * @brief Create the pool lock, once at startup before any task makes a request.
+ */
+esp_err_t app_http_init(void);
+
+/**
+ * @brief Get a client for url, a connected one to the same host if one is idle.
+ *
+ * @param event_handler called with user_data in evt->user_data, may be NULL
+ * @return NULL if out of memory
+ */
+esp_http_client_handle_t app_http_acquire(const char *url, http_event_handle_cb event_handler, void *user_data);
+
+/**
+ * @brief Set a request header, it is removed again by app_http_release().
+ */
+esp_err_t app_http_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+
+/**
+ * @brief esp_http_client_perform(), retried once on a new connection if a kept one was stale.
+ */
+esp_err_t app_http_perform(esp_http_client_handle_t client);
+
+/**
+ * @brief esp_http_client_open(), retried once on a new connection if a kept one was stale.
+ * A negative write_len sends the body with chunked transfer encoding.
+ */
+esp_err_t app_http_open(esp_http_client_handle_t client, int write_len);
+
+/**
+ * @brief Open the request, send len bytes of body and read the response headers, retried once
+ * on a new connection if a kept one was stale. The body is then read with
+ * esp_http_client_read(), a caller that stops early leaves the connection to be closed.
+ */
+esp_err_t app_http_send(esp_http_client_handle_t client, const char *body, int len);
+
+/**
+ * @brief Give the client back and log the timing of the request.
+ * The connection is kept if the response was read completely.
+ *
+ * @param timing timing of the request, may be NULL
+ */
+void app_http_release(esp_http_client_handle_t client, app_http_timing_t *timing);
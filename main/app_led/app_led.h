@@ -1,9 +1,32 @@
 #ifndef APP_LED_H_
 #define APP_LED_H_
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "led_strip.h"
+
+typedef enum
+{
+    APP_LED_BACKEND_SPI = 0, // SPI3 with DMA
+    APP_LED_BACKEND_RMT,     // RMT, with DMA if CONFIG_APP_LED_RMT_WITH_DMA
+} appLedBackend_t;
 
 void appLedStart(void);
 esp_err_t bspWs2812Enable(bool enable);
 
+/**
+ * @brief Move the strip to another peripheral at runtime, keeps the current one on failure.
+ * Call from the LED task, it must not run concurrently with rgb_matrix_task().
+ */
+esp_err_t bspWs2812SetBackend(appLedBackend_t backend);
+appLedBackend_t bspWs2812GetBackend(void);
+led_strip_handle_t bspWs2812GetStrip(void);
+
+/**
+ * @brief Log encode time, bus time, CPU time and interrupts per frame for each backend.
+ * Runs in the LED task at boot with CONFIG_APP_LED_BACKEND_BENCHMARK.
+ */
+void appLedBackendBenchmark(uint16_t frames);
+
 #endif /* APP_LED_H_ */
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "sdkconfig.h"
+
+#ifdef CONFIG_APP_LED_BACKEND_BENCHMARK
+
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_led.h"
+#include "led_strip.h"
+
+static const char *TAG = "app_led_bench";
+
+#define BENCH_CPU_MHZ       CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+// A probe loop iteration takes a few dozen cycles, anything longer means it was preempted
+#define BENCH_GAP_CYCLES    200
+#define BENCH_BASELINE_MS   500
+#define BENCH_TASK_PRIORITY 3
+
+typedef struct
+{
+    volatile bool stop;
+    uint32_t gaps;     // times the probe lost the CPU
+    uint64_t stolen;   // cycles spent away from the probe
+    int64_t elapsed;   // us
+    TaskHandle_t owner;
+} benchProbe_t;
+
+typedef struct
+{
+    uint16_t frames;
+    BaseType_t core;
+    TaskHandle_t caller;
+} benchArgs_t;
+
+static benchProbe_t s_probe;
+
+/* Runs below the benchmark task on the same core. Everything else that runs on the core,
+ * interrupts, the benchmark task and the driver, shows up as a gap in its cycle count.
+ */
+static void IRAM_ATTR benchProbeTask(void *arg)
+{
+    int64_t start = esp_timer_get_time();
+    uint32_t last = esp_cpu_get_cycle_count();
+    uint32_t gaps = 0;
+    uint64_t stolen = 0;
+
+    while (!s_probe.stop)
+    {
+        uint32_t now = esp_cpu_get_cycle_count();
+        uint32_t delta = now - last;
+        if (delta > BENCH_GAP_CYCLES)
+        {
+            gaps++;
+            stolen += delta;
+        }
+        last = now;
+    }
+
+    s_probe.gaps = gaps;
+    s_probe.stolen = stolen;
+    s_probe.elapsed = esp_timer_get_time() - start;
+    xTaskNotifyGive(s_probe.owner);
+    vTaskDelete(NULL);
+}
+
+static void benchProbeStart(BaseType_t core)
+{
+    s_probe.stop = false;
+    s_probe.owner = xTaskGetCurrentTaskHandle();
+    xTaskCreatePinnedToCore(benchProbeTask, "ledBenchProbe", 2048, NULL, 1, NULL, core);
+    // Let the probe take its first timestamp before the measurement starts
+    vTaskDelay(1);
+}
+
+static void benchProbeStop(void)
+{
+    s_probe.stop = true;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+static void benchBackend(led_strip_handle_t strip, uint16_t frames, BaseType_t core,
+                         double baseline_gaps_per_us, double baseline_stolen_per_us)
+{
+    int64_t encode = 0;
+    int64_t refresh = 0;
+    int64_t refresh_max = 0;
+
+    benchProbeStart(core);
+    for (uint16_t frame = 0; frame < frames; frame++)
+    {
+        int64_t t0 = esp_timer_get_time();
+        for (uint32_t i = 0; i < CONFIG_MATRIX_LED_COUNT; i++)
+        {
+            uint8_t v = (i * 8 + frame) & 0x3f;
+            led_strip_set_pixel(strip, i, v, 0x3f - v, frame & 0x3f);
+        }
+        int64_t t1 = esp_timer_get_time();
+        led_strip_refresh(strip);
+        int64_t t2 = esp_timer_get_time();
+
+        encode += t1 - t0;
+        refresh += t2 - t1;
+        refresh_max = t2 - t1 > refresh_max ? t2 - t1 : refresh_max;
+    }
+    benchProbeStop();
+
+    double gaps = s_probe.gaps - baseline_gaps_per_us * s_probe.elapsed;
+    double cpu_us = (s_probe.stolen - baseline_stolen_per_us * s_probe.elapsed) / BENCH_CPU_MHZ;
+    ESP_LOGI(TAG, "%-3s %8" PRId64 " %8" PRId64 " %8" PRId64 " %8.1f %6.1f%% %8.1f",
+             bspWs2812GetBackend() == APP_LED_BACKEND_RMT ? "RMT" : "SPI",
+             encode / frames, refresh / frames, refresh_max, cpu_us / frames,
+             100.0 * cpu_us / s_probe.elapsed, gaps / frames);
+}
+
+static void benchTask(void *arg)
+{
+    benchArgs_t *args = (benchArgs_t *)arg;
+    appLedBackend_t original = bspWs2812GetBackend();
+    // The current backend goes last so nothing has to be restored
+    appLedBackend_t order[2] = {
+        original == APP_LED_BACKEND_SPI ? APP_LED_BACKEND_RMT : APP_LED_BACKEND_SPI,
+        original,
+    };
+
+    // Background load of the core: tick, other interrupts
+    benchProbeStart(args->core);
+    vTaskDelay(pdMS_TO_TICKS(BENCH_BASELINE_MS));
+    benchProbeStop();
+    double baseline_gaps_per_us = (double)s_probe.gaps / s_probe.elapsed;
+    double baseline_stolen_per_us = (double)s_probe.stolen / s_probe.elapsed;
+
+    ESP_LOGI(TAG, "%d LEDs, %u frames on core %d, baseline %.1f preemptions/ms",
+             CONFIG_MATRIX_LED_COUNT, args->frames, args->core, baseline_gaps_per_us * 1000);
+    ESP_LOGI(TAG, "    encode us  bus us    max us   cpu us    cpu    preempt/frame");
+    for (int i = 0; i < 2; i++)
+    {
+        // Recreated here so the driver interrupt is allocated on the measured core
+        if (bspWs2812SetBackend(order[i]) != ESP_OK)
+        {
+            continue;
+        }
+        benchBackend(bspWs2812GetStrip(), args->frames, args->core, baseline_gaps_per_us, baseline_stolen_per_us);
+    }
+
+    xTaskNotifyGive(args->caller);
+    vTaskDelete(NULL);
+}
+
+void appLedBackendBenchmark(uint16_t frames)
+{
+    benchArgs_t args = {
+        .frames = frames ? frames : 1,
+        .core = xPortGetCoreID(),
+        .caller = xTaskGetCurrentTaskHandle(),
+    };
+
+    if (!bspWs2812GetStrip())
+    {
+        ESP_LOGW(TAG, "LED strip not initialized");
+        return;
+    }
+
+    // Both tasks are pinned, the probe only sees what runs on its own core
+    xTaskCreatePinnedToCore(benchTask, "ledBench", 4096, &args, BENCH_TASK_PRIORITY, NULL, args.core);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+#endif // CONFIG_APP_LED_BACKEND_BENCHMARK
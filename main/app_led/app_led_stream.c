@@ -0,0 +1,146 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "app_led_stream.h"
+#include "app_tusb_hid.h"
+
+#include "rgb_matrix.h"
+
+static const char *TAG = "app_led_stream";
+
+// Frame assembled from PIXELS reports and the SHOW state below, only touched with s_frameLock held
+static RGB s_frame[CONFIG_MATRIX_LED_COUNT];
+static bool s_showPending = false;
+static uint8_t s_showSeq = 0;
+static int64_t s_lastReportUs = 0;
+static SemaphoreHandle_t s_frameLock = NULL;
+static TaskHandle_t s_ledTask = NULL;
+
+static volatile bool s_active = false;
+
+void appLedStreamInit(TaskHandle_t ledTask)
+{
+    if (!s_frameLock)
+    {
+        s_frameLock = xSemaphoreCreateMutex();
+    }
+    s_ledTask = ledTask;
+}
+
+static void appLedStreamPixels(const uint8_t *data, uint16_t len)
+{
+    uint8_t first = data[1];
+    uint8_t count = data[2];
+
+    if (count > APP_LED_STREAM_PIXELS_MAX || len < 4 + count * 3 || first + count > CONFIG_MATRIX_LED_COUNT)
+    {
+        ESP_LOGW(TAG, "bad pixels report, first %d count %d", first, count);
+        return;
+    }
+
+    xSemaphoreTake(s_frameLock, portMAX_DELAY);
+    for (int i = 0; i < count; i++)
+    {
+        s_frame[first + i].r = data[4 + i * 3];
+        s_frame[first + i].g = data[5 + i * 3];
+        s_frame[first + i].b = data[6 + i * 3];
+    }
+    xSemaphoreGive(s_frameLock);
+}
+
+void appLedStreamReceive(const uint8_t *data, uint16_t len)
+{
+    if (!s_frameLock || !s_ledTask || len < 2)
+    {
+        return;
+    }
+
+    // The timestamp is 64 bits wide and the LED task reads it, so it is written under the lock
+    xSemaphoreTake(s_frameLock, portMAX_DELAY);
+    s_lastReportUs = esp_timer_get_time();
+    xSemaphoreGive(s_frameLock);
+
+    switch (data[0])
+    {
+    case APP_LED_STREAM_CMD_PIXELS:
+        appLedStreamPixels(data, len);
+        break;
+    case APP_LED_STREAM_CMD_SHOW:
+        xSemaphoreTake(s_frameLock, portMAX_DELAY);
+        s_showSeq = data[1];
+        s_showPending = true;
+        xSemaphoreGive(s_frameLock);
+        xTaskNotifyGive(s_ledTask);
+        break;
+    case APP_LED_STREAM_CMD_STOP:
+        s_active = false;
+        xTaskNotifyGive(s_ledTask);
+        return;
+    default:
+        return;
+    }
+
+    if (!s_active)
+    {
+        ESP_LOGI(TAG, "host stream started");
+        s_active = true;
+    }
+}
+
+bool appLedStreamActive(void)
+{
+    int64_t lastReportUs = 0;
+
+    if (!s_active)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(s_frameLock, portMAX_DELAY);
+    lastReportUs = s_lastReportUs;
+    xSemaphoreGive(s_frameLock);
+
+    if (esp_timer_get_time() - lastReportUs > APP_LED_STREAM_TIMEOUT_MS * 1000LL)
+    {
+        ESP_LOGI(TAG, "host stream timed out");
+        s_active = false;
+    }
+    return s_active;
+}
+
+void appLedStreamShow(void)
+{
+    uint8_t ack[APP_LED_STREAM_REPORT_SIZE] = {0};
+    uint32_t requestedMa = 0;
+    uint32_t outputMa = 0;
+
+    if (!s_frameLock)
+    {
+        return;
+    }
+
+    // The flag, the sequence number and the frame are taken together, so the ack always matches the pixels shown.
+    // The lock only covers the output stage, the bus transfer runs while the next frame arrives
+    xSemaphoreTake(s_frameLock, portMAX_DELAY);
+    if (!s_showPending)
+    {
+        xSemaphoreGive(s_frameLock);
+        return;
+    }
+    s_showPending = false;
+    ack[1] = s_showSeq;
+    rgb_matrix_driver_load_frame(s_frame, CONFIG_MATRIX_LED_COUNT);
+    xSemaphoreGive(s_frameLock);
+    rgb_matrix_driver_refresh();
+
+    rgb_matrix_output_get_current(&requestedMa, &outputMa);
+    ack[0] = APP_LED_STREAM_ACK | APP_LED_STREAM_CMD_SHOW;
+    ack[2] = outputMa & 0xFF;
+    ack[3] = outputMa >> 8;
+    ack[4] = requestedMa & 0xFF;
+    ack[5] = requestedMa >> 8;
+    app_tusb_hid_send_raw(ack, sizeof(ack));
+}
@@ -0,0 +1,50 @@
+#ifndef APP_LED_STREAM_H_
+#define APP_LED_STREAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Host LED streaming over the raw HID interface, 64 byte reports without report ID.
+ *
+ * PIXELS  0x01 first count 0x00 r g b ...  up to 20 LEDs starting at LED `first`
+ * SHOW    0x02 seq                         show the frame, answered with an ACK
+ * STOP    0x03                             hand the LEDs back to the local effect
+ * ACK     0x82 seq out_mA(le16) req_mA(le16), sent once the frame left the data line
+ *
+ * A frame is any number of PIXELS reports followed by SHOW. LEDs that are not sent keep their
+ * last value, so a host can send full frames or only the LEDs that changed. The first report
+ * takes the LEDs over from the local effect, which resumes after STOP or when no report
+ * arrived for APP_LED_STREAM_TIMEOUT_MS.
+ */
+#define APP_LED_STREAM_REPORT_SIZE  64
+#define APP_LED_STREAM_CMD_PIXELS   0x01
+#define APP_LED_STREAM_CMD_SHOW     0x02
+#define APP_LED_STREAM_CMD_STOP     0x03
+#define APP_LED_STREAM_ACK          0x80
+#define APP_LED_STREAM_PIXELS_MAX   ((APP_LED_STREAM_REPORT_SIZE - 4) / 3)
+#define APP_LED_STREAM_TIMEOUT_MS   1000
+
+/**
+ * @brief Set the task that shows the streamed frames, it is notified on every SHOW
+ */
+void appLedStreamInit(TaskHandle_t ledTask);
+
+/**
+ * @brief Handle one report from the host, called from the TinyUSB task
+ */
+void appLedStreamReceive(const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Whether the host currently owns the LEDs, ends the stream on timeout
+ */
+bool appLedStreamActive(void);
+
+/**
+ * @brief Send the pending streamed frame to the strip and acknowledge it, called from the LED task
+ */
+void appLedStreamShow(void);
+
+#endif /* APP_LED_STREAM_H_ */
@@ -0,0 +1,39 @@
+#include "rgb_matrix.h"
+
+/* Key matrix to LED layout of the keyboard, kept free of IDF dependencies so
+ * tools/rgb_matrix_host can render the effects with the same geometry.
+ */
+
+// https://docs.qmk.fm/features/rgb_matrix
+// x = 224 / (NUMBER_OF_COLS - 1) * COL_POSITION [0,15]
+// y =  64 / (NUMBER_OF_ROWS - 1) * ROW_POSITION [0,5]
+
+led_config_t g_led_config = {
+    {
+        // Key Matrix to LED Index
+        {0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 80, 89, 90},
+        {26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 81, 91},
+        {27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 82, 92},
+        {53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 83, 88, 93},
+        {54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 74, 75, 76, 94},
+        {73, 72, 71, 70, 69, 68, 67, 66, 79, 78, 77, 84, 85, 86, 87, 95},
+    },
+    {
+        // LED Index to Physical Position
+        {0, 0}, {15, 0}, {30, 0}, {45, 0}, {60, 0}, {75, 0}, {90, 0}, {105, 0}, {119, 0}, {134, 0}, {149, 0}, {164, 0}, {179, 0}, {194, 0}, {209, 0}, {224, 0}, // 0-15
+        {0, 13},{15, 13},{30, 13},{45, 13},{60, 13},{75, 13},{90, 13},{105, 13},{119, 13},{134, 13},{149, 13},{164, 13},{179, 13},{194, 13},{209, 13},{224, 13},// 16-31
+        {0, 26},{15, 26},{30, 26},{45, 26},{60, 26},{75, 26},{90, 26},{105, 26},{119, 26},{134, 26},{149, 26},{164, 26},{179, 26},{194, 26},{209, 26},{224, 26},// 32-47
+        {0, 39},{15, 39},{30, 39},{45, 39},{60, 39},{75, 39},{90, 39},{105, 39},{119, 39},{134, 39},{149, 39},{164, 39},{179, 39},{194, 39},{209, 39},{224, 39},// 48-63
+        {0, 52},{15, 52},{30, 52},{45, 52},{60, 52},{75, 52},{90, 52},{105, 52},{119, 52},{134, 52},{149, 52},{164, 52},{179, 52},{194, 52},{209, 52},{224, 52},// 64-79
+        {0, 64},{15, 64},{30, 64},{45, 64},{60, 64},{75, 64},{90, 64},{105, 64},{119, 64},{134, 64},{149, 64},{164, 64},{179, 64},{194, 64},{209, 64},{224, 64},// 80-95
+    },
+    {
+        // LED Index to Flag
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,// 0-15
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,// 16-31
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,// 32-47
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,// 48-63
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,// 64-79
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,// 80-95
+    }
+};
@@ -1,10 +1,42 @@
 #ifndef BAIDU_API_H
 #define BAIDU_API_H
 
+#include "audio_stream.h"
+
 void baidu_update_access_token(void);
 char *baidu_get_access_token(void);
 char *baidu_get_cuid_by_mac(void);
 char *baidu_get_asr_result(uint8_t *audio_data, int audio_len);
+
+/**
+ * Speech recognition with the audio uploaded while it is recorded, as a chunked POST.
+ * The connection is opened at wake time, the result arrives one round trip after the last chunk.
+ */
+typedef struct baidu_asr_upload baidu_asr_upload_t;
+
+/**
+ * @brief Connect and send the request headers, NULL on failure.
+ */
+baidu_asr_upload_t *baidu_asr_upload_open(int sample_rate);
+/**
+ * @brief Send mono 16 bit PCM as one chunk, blocks until it is written to the socket.
+ */
+esp_err_t baidu_asr_upload_write(baidu_asr_upload_t *upload, const void *pcm, int len);
+/**
+ * @brief End the upload, wait for the result and free the upload.
+ * @return ESP_OK if the server processed the audio, *text is NULL when no speech was recognized.
+ *         ESP_FAIL if it was not accepted, the audio should be sent again with baidu_get_asr_result().
+ */
+esp_err_t baidu_asr_upload_finish(baidu_asr_upload_t *upload, char **text);
+/**
+ * @brief Drop the upload without waiting for a result.
+ */
+void baidu_asr_upload_abort(baidu_asr_upload_t *upload);
 esp_err_t baidu_get_tts_result(char *audio_data, int audio_len);
+/**
+ * @brief Synthesize text into stream and start playing it once enough is buffered.
+ * Several calls may append to the same stream, the clips then play back to back.
+ */
+esp_err_t baidu_tts_stream(const char *text, int text_len, audio_stream_t *stream);
 
 #endif // BAIDU_API_H
\ No newline at end of file
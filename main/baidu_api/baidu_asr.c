@@ -1,45 +1,53 @@
+#include <inttypes.h>
 #include "esp_log.h"
-#include "esp_crt_bundle.h"
+#include "esp_timer.h"
 #include "esp_http_client.h"
 #include "cJSON.h"
 #include "json_utils.h"
 
+#include "app_http.h"
 #include "baidu_api.h"
 
 
 static char *TAG = "BaiduAsr";
 
-static char response_data[4096];
-static int  recived_len;
+#define ASR_RESPONSE_SIZE (4096)
+
+// 每个请求各自的响应缓存, 整段上传和边录边传可同时进行
+typedef struct
+{
+    char data[ASR_RESPONSE_SIZE];
+    int len;
+} asr_response_t;
 
 // http客户端的事件处理回调函数
 static esp_err_t http_client_event_handler(esp_http_client_event_t *evt)
 {
+    asr_response_t *response = evt->user_data;
+
     switch (evt->event_id)
     {
     case HTTP_EVENT_ON_CONNECTED:
         ESP_LOGI(TAG, "connected to web-server");
-        recived_len = 0;
+        response->len = 0;
         break;
     case HTTP_EVENT_ON_DATA:
-        if (evt->user_data)
+        if (response->len + evt->data_len < sizeof(response->data))
         {
-            memcpy(evt->user_data + recived_len, evt->data, evt->data_len); // 将分片的每一片数据都复制到user_data
-            recived_len += evt->data_len;                                   // 累计偏移更新
+            memcpy(response->data + response->len, evt->data, evt->data_len); // 将分片的每一片数据都复制到缓存
+            response->len += evt->data_len;                                   // 累计偏移更新
+            response->data[response->len] = '\0';
         }
         printf("HTTP_EVENT_ON_DATA, len=%d\n", evt->data_len);
         break;
     case HTTP_EVENT_ON_FINISH:
         ESP_LOGI(TAG, "finished a request and response!");
-        recived_len = 0;
         break;
     case HTTP_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "disconnected to web-server");
-        recived_len = 0;
         break;
     case HTTP_EVENT_ERROR:
         ESP_LOGE(TAG, "error");
-        recived_len = 0;
         break;
     default:
         break;
@@ -48,6 +56,46 @@ static esp_err_t http_client_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+// 解析识别结果, err_no不为NULL时返回百度的错误码
+static char *asr_parse_result(const char *response, int *err_no)
+{
+    char *asr_data = NULL;
+    cJSON *json = cJSON_Parse(response);
+    if (json == NULL)
+    {
+        return NULL;
+    }
+    cJSON *err_json = cJSON_GetObjectItem(json, "err_no");
+    if (err_no)
+    {
+        *err_no = cJSON_IsNumber(err_json) ? err_json->valueint : -1;
+    }
+    cJSON *result_json = cJSON_GetObjectItem(json, "result");
+    if (result_json != NULL && cJSON_IsArray(result_json))
+    {
+        cJSON *result_array = cJSON_GetArrayItem(result_json, 0);
+        if (result_array != NULL && cJSON_IsString(result_array))
+        {
+            asr_data = strdup(result_array->valuestring);
+        }
+    }
+    cJSON_Delete(json);
+    return asr_data;
+}
+
+static int asr_build_url(char *url, size_t size)
+{
+    char dev_pid[] = "1537";   // 普通话识别
+    char *cuid = baidu_get_cuid_by_mac();
+    char *access_token = baidu_get_access_token();
+    if (access_token == NULL)
+    {
+        ESP_LOGE(TAG, "access token is NULL");
+        return -1;
+    }
+    return snprintf(url, size, "http://vop.baidu.com/server_api?dev_pid=%s&cuid=%s&token=%s", dev_pid, cuid, access_token);
+}
+
 /// @brief 语音转文字
 /// @param audio_data 
 /// @param audio_len 
@@ -56,51 +104,165 @@ char *baidu_get_asr_result(uint8_t *audio_data, int audio_len)
 {
     char *asr_data = NULL;
     char url[256];
-    char dev_pid[] = "1537";   // 普通话识别
-    char *cuid = baidu_get_cuid_by_mac();
-    char *access_token = baidu_get_access_token();
-    if (access_token == NULL)
+    if (asr_build_url(url, sizeof(url)) < 0)
     {
-        ESP_LOGE(TAG, "access token is NULL");
         return NULL;
     }
-    
-    sprintf(url, "http://vop.baidu.com/server_api?dev_pid=%s&cuid=%s&token=%s", dev_pid, cuid, access_token);
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_client_event_handler,
-        .user_data = response_data,
-    };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    // 连接池中的连接可能已连上, 不会再有HTTP_EVENT_ON_CONNECTED
+    asr_response_t *response = calloc(1, sizeof(asr_response_t));
+    if (response == NULL)
+    {
+        return NULL;
+    }
+    esp_http_client_handle_t client = app_http_acquire(url, http_client_event_handler, response);
+    if (client == NULL)
+    {
+        free(response);
+        return NULL;
+    }
 
     esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "audio/wav;rate=16000");
+    esp_http_client_set_timeout_ms(client, 10000);
+    app_http_set_header(client, "Content-Type", "audio/wav;rate=16000");
     esp_http_client_set_post_field(client, (const char *)audio_data, audio_len);
-    esp_err_t err = esp_http_client_perform(client);
+    esp_err_t err = app_http_perform(client);
     if (err == ESP_OK)
     {
-        cJSON *json = cJSON_Parse(response_data);
-        if (json != NULL)
-        {
-            cJSON *result_json = cJSON_GetObjectItem(json, "result");
-            if (result_json != NULL && cJSON_IsArray(result_json))
-            {
-                cJSON *result_array = cJSON_GetArrayItem(result_json, 0);
-                if (result_array != NULL && cJSON_IsString(result_array))
-                {
-                    asr_data = strdup(result_array->valuestring);
-                }
-            }
-            cJSON_Delete(json);
-        }
+        asr_data = asr_parse_result(response->data, NULL);
     }
     else
     {
         ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
     }
     
-    esp_http_client_cleanup(client);
+    app_http_release(client, NULL);
+    free(response);
 
     return asr_data;
 }
+
+struct baidu_asr_upload
+{
+    esp_http_client_handle_t client;
+    uint32_t bytes;
+    int64_t start_us;
+    char response[ASR_RESPONSE_SIZE];
+};
+
+baidu_asr_upload_t *baidu_asr_upload_open(int sample_rate)
+{
+    char url[256];
+    char content_type[32];
+
+    if (asr_build_url(url, sizeof(url)) < 0)
+    {
+        return NULL;
+    }
+    baidu_asr_upload_t *upload = calloc(1, sizeof(baidu_asr_upload_t));
+    if (upload == NULL)
+    {
+        return NULL;
+    }
+    upload->start_us = esp_timer_get_time();
+
+    upload->client = app_http_acquire(url, NULL, NULL);
+    if (upload->client == NULL)
+    {
+        free(upload);
+        return NULL;
+    }
+    esp_http_client_set_method(upload->client, HTTP_METHOD_POST);
+    esp_http_client_set_timeout_ms(upload->client, 10000);
+    // 边录边传, 长度未知, 用chunked编码, 数据为单声道16位PCM
+    snprintf(content_type, sizeof(content_type), "audio/pcm;rate=%d", sample_rate);
+    app_http_set_header(upload->client, "Content-Type", content_type);
+    esp_err_t err = app_http_open(upload->client, -1);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to open upload: %s", esp_err_to_name(err));
+        app_http_release(upload->client, NULL);
+        free(upload);
+        return NULL;
+    }
+    ESP_LOGI(TAG, "upload connected in %lld ms", (esp_timer_get_time() - upload->start_us) / 1000);
+    return upload;
+}
+
+static esp_err_t asr_upload_send(baidu_asr_upload_t *upload, const char *data, int len)
+{
+    while (len > 0)
+    {
+        int n = esp_http_client_write(upload->client, data, len);
+        if (n <= 0)
+        {
+            return ESP_FAIL;
+        }
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t baidu_asr_upload_write(baidu_asr_upload_t *upload, const void *pcm, int len)
+{
+    char chunk_head[12];
+
+    if (len <= 0)
+    {
+        return ESP_OK;
+    }
+    int head_len = snprintf(chunk_head, sizeof(chunk_head), "%x\r\n", len);
+    if (asr_upload_send(upload, chunk_head, head_len) != ESP_OK ||
+        asr_upload_send(upload, pcm, len) != ESP_OK ||
+        asr_upload_send(upload, "\r\n", 2) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "upload failed after %" PRIu32 " bytes", upload->bytes);
+        return ESP_FAIL;
+    }
+    upload->bytes += len;
+    return ESP_OK;
+}
+
+esp_err_t baidu_asr_upload_finish(baidu_asr_upload_t *upload, char **text)
+{
+    esp_err_t ret = ESP_FAIL;
+    int64_t end_us = esp_timer_get_time();
+    int err_no = -1;
+
+    *text = NULL;
+    if (asr_upload_send(upload, "0\r\n\r\n", 5) == ESP_OK && esp_http_client_fetch_headers(upload->client) >= 0)
+    {
+        int status = esp_http_client_get_status_code(upload->client);
+        int len = esp_http_client_read_response(upload->client, upload->response, sizeof(upload->response) - 1);
+        if (len >= 0)
+        {
+            upload->response[len] = '\0';
+            *text = asr_parse_result(upload->response, &err_no);
+        }
+        ESP_LOGI(TAG, "status %d, err_no %d, %" PRIu32 " bytes in %lld ms, result %lld ms after the last chunk",
+                 status, err_no, upload->bytes, (end_us - upload->start_us) / 1000, (esp_timer_get_time() - end_us) / 1000);
+        // 3301: 音频质量过差, 一般是没有说话, 重新上传也识别不出
+        if (status == 200 && (err_no == 0 || err_no == 3301))
+        {
+            ret = ESP_OK;
+        }
+        else
+        {
+            ESP_LOGE(TAG, "upload rejected: %s", upload->response);
+        }
+    }
+    else
+    {
+        ESP_LOGE(TAG, "no response to the upload");
+    }
+    baidu_asr_upload_abort(upload);
+    return ret;
+}
+
+void baidu_asr_upload_abort(baidu_asr_upload_t *upload)
+{
+    // A response that was not read completely closes the connection
+    app_http_release(upload->client, NULL);
+    free(upload);
+}
@@ -3,11 +3,11 @@
 #include "freertos/task.h"
 #include "esp_mac.h"
 #include "esp_log.h"
-#include "esp_crt_bundle.h"
 #include "esp_http_client.h"
 #include "cJSON.h"
 #include "json_utils.h"
 
+#include "app_http.h"
 #include "app_wifi.h"
 #include "baidu_api.h"
 
@@ -52,19 +52,16 @@ void baidu_update_access_token(void)
 
     snprintf(url, BAIDU_URI_LENGTH, BAIDU_AUTH_ENDPOINT "&client_id=%s&client_secret=%s", API_KEY, SECRET_KEY);
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = NULL,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
-    esp_http_client_handle_t http_client = esp_http_client_init(&config);
+    esp_http_client_handle_t http_client = app_http_acquire(url, NULL, NULL);
     if (http_client == NULL)
     {
         ESP_LOGE(TAG, "Error creating http client");
         free(url);
         return;
     }
-    if (esp_http_client_open(http_client, 0) != ESP_OK)
+    esp_http_client_set_method(http_client, HTTP_METHOD_GET);
+    esp_http_client_set_timeout_ms(http_client, 5000);
+    if (app_http_open(http_client, 0) != ESP_OK)
     {
         ESP_LOGE(TAG, "Error open http request to baidu auth server");
         goto _exit;
@@ -117,14 +114,13 @@ void baidu_update_access_token(void)
         goto _exit;
     }
     memset(sg_access_token, '\0', token_len);
-    snprintf(sg_access_token, "%s", token);
+    snprintf(sg_access_token, token_len, "%s", token);
     token_updated_flag = true;
     ESP_LOGI(TAG, "Baidu access token = %s", sg_access_token);
 
 _exit:
     free(url);
-    esp_http_client_close(http_client);
-    esp_http_client_cleanup(http_client);
+    app_http_release(http_client, NULL);
     if (token)
         free(token);
 }
@@ -1,23 +1,34 @@
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_http_client.h"
-#include "audio_player.h"
-#include "esp_crt_bundle.h"
 #include "inttypes.h"
 
 #include "app_audio.h"
+#include "app_http.h"
 #include "app_wifi.h"
 #include "baidu_api.h"
 
 static const char *TAG = "BaiduTts";
 
-static uint32_t file_total_len = 0;
+// How long a download may wait for the player to make room before the rest is dropped
+#define TTS_WRITE_TIMEOUT_MS 10000
+
+typedef struct
+{
+    audio_stream_t *stream;
+    esp_err_t write_err; // set once the stream stops taking data
+    uint32_t bytes;
+    bool error;          // the response is not audio, Baidu reports errors as JSON
+} tts_request_t;
 
 /* Define a function to handle HTTP events during an HTTP request */
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
+    tts_request_t *req = evt->user_data;
+
     switch (evt->event_id)
     {
     case HTTP_EVENT_ERROR:
@@ -30,24 +41,35 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
         ESP_LOGI(TAG, "HTTP_EVENT_HEADER_SENT");
         break;
     case HTTP_EVENT_ON_HEADER:
-        ESP_LOGI(TAG, "HTTP_EVENT_ON_HEADER");
-        file_total_len = 0;
+        ESP_LOGI(TAG, "HTTP_EVENT_ON_HEADER, %s: %s", evt->header_key, evt->header_value);
+        if (strcasecmp(evt->header_key, "Content-Type") == 0 && strncmp(evt->header_value, "audio/", 6) != 0)
+        {
+            req->error = true;
+        }
         break;
     case HTTP_EVENT_ON_DATA:
-        ESP_LOGI(TAG, "HTTP_EVENT_ON_DATA, len=(%" PRIu32 " + %d) [%d]", file_total_len, evt->data_len, MAX_FILE_SIZE);
-        if ((file_total_len + evt->data_len) < MAX_FILE_SIZE)
+        if (req->error)
+        {
+            ESP_LOGE(TAG, "TTS error: %.*s", evt->data_len, (char *)evt->data);
+            break;
+        }
+        if (req->write_err != ESP_OK)
         {
-            memcpy(audio_rx_buffer + file_total_len, (char *)evt->data, evt->data_len);
-            file_total_len += evt->data_len;
+            break;
+        }
+        // 边下载边播放
+        req->write_err = audio_stream_write(req->stream, evt->data, evt->data_len, pdMS_TO_TICKS(TTS_WRITE_TIMEOUT_MS));
+        if (req->write_err == ESP_OK)
+        {
+            req->bytes += evt->data_len;
+            if (audio_stream_ready(req->stream))
+            {
+                audio_stream_start_playback(req->stream);
+            }
         }
         break;
     case HTTP_EVENT_ON_FINISH:
-        ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH: %" PRIu32 ", %" PRIu32 " K", file_total_len, file_total_len / 1024);
-        // 接收完成, 开始播放
-        FILE *fp = NULL;
-        fp = fmemopen((void *)audio_rx_buffer, file_total_len, "rb");
-        if (fp)
-            audio_player_play(fp);
+        ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH: %" PRIu32 " bytes", req->bytes);
         break;
     case HTTP_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");
@@ -59,7 +81,7 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
-esp_err_t baidu_get_tts_result(char *audio_data, int audio_len)
+esp_err_t baidu_tts_stream(const char *text, int text_len, audio_stream_t *stream)
 {
     char *cuid = baidu_get_cuid_by_mac();
     char *access_token = baidu_get_access_token();
@@ -72,7 +94,7 @@ esp_err_t baidu_get_tts_result(char *audio_data, int audio_len)
     int body_size = snprintf(NULL, 0, "tex=&tok=%s&cuid=%s&ctp=1&lan=zh&spd=5&pit=5&vol=5&per=1&aue=3",
                              access_token,
                              cuid);
-    body_size += audio_len;
+    body_size += text_len;
     char *body = heap_caps_malloc((body_size + 1), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
     if (body == NULL)
     {
@@ -80,25 +102,30 @@ esp_err_t baidu_get_tts_result(char *audio_data, int audio_len)
         return ESP_ERR_NO_MEM;
     }
 
-    snprintf(body, body_size + 1, "tex=%s&tok=%s&cuid=%s&ctp=1&lan=zh&spd=5&pit=5&vol=5&per=1&aue=3",
-             audio_data,
+    snprintf(body, body_size + 1, "tex=%.*s&tok=%s&cuid=%s&ctp=1&lan=zh&spd=5&pit=5&vol=5&per=1&aue=3",
+             text_len,
+             text,
              access_token,
              cuid);
     // ----------------------------------------------------------------------------------------------
 
-    esp_http_client_config_t config = {
-        .url            = "http://tsn.baidu.com/text2audio",
-        .buffer_size    = 128000,
-        .buffer_size_tx = 4000,
-        .timeout_ms     = 40000,
-        .event_handler  = http_event_handler,
+    tts_request_t req = {
+        .stream    = stream,
+        .write_err = ESP_OK,
     };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    // 连接池中的客户端, 按句合成时后面的句子复用同一个连接
+    esp_http_client_handle_t client = app_http_acquire("http://tsn.baidu.com/text2audio", http_event_handler, &req);
+    if (client == NULL)
+    {
+        free(body);
+        return ESP_ERR_NO_MEM;
+    }
     esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
-    esp_http_client_set_header(client, "Accept", "*/*");
+    esp_http_client_set_timeout_ms(client, 40000);
+    app_http_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
+    app_http_set_header(client, "Accept", "*/*");
     esp_http_client_set_post_field(client, (const char *)body, body_size);
-    esp_err_t err = esp_http_client_perform(client);
+    esp_err_t err = app_http_perform(client);
     if (err == ESP_OK)
     {
         ESP_LOGE(TAG, "HTTP POST request success");
@@ -107,9 +134,37 @@ esp_err_t baidu_get_tts_result(char *audio_data, int audio_len)
     {
         ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
     }
-    
-    esp_http_client_cleanup(client);
 
+    app_http_release(client, NULL);
+    free(body);
+
+    if (err == ESP_OK && req.error)
+    {
+        err = ESP_FAIL;
+    }
+    else if (err == ESP_OK)
+    {
+        err = req.write_err;
+    }
+    // A clip shorter than the prebuffer plays once it is complete
+    if (err == ESP_OK && req.bytes > 0)
+    {
+        audio_stream_start_playback(stream);
+    }
+    return err;
+}
+
+esp_err_t baidu_get_tts_result(char *audio_data, int audio_len)
+{
+    audio_stream_config_t stream_config = AUDIO_STREAM_DEFAULT_CONFIG();
+    audio_stream_t *stream = audio_stream_new(&stream_config);
+    if (stream == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = baidu_tts_stream(audio_data, audio_len, stream);
+    audio_stream_finish(stream);
     return err;
 }
 
@@ -1,10 +1,15 @@
+#include <stdlib.h>
+#include <string.h>
 #include "esp_log.h"
-#include "esp_crt_bundle.h"
+#include "esp_timer.h"
 #include "esp_http_client.h"
 #include "cJSON.h"
 
+#include "app_http.h"
+#include "app_tts.h"
 #include "baidu_api.h"
 #include "chatgpt_api.h"
+#include "chatgpt_sse.h"
 
 static char *TAG = "chatgpt_api";
 
@@ -12,48 +17,100 @@ static char *TAG = "chatgpt_api";
 const char *url    = "https://api.closeai-proxy.xyz/v1/chat/completions";
 const char *apiKey = "XXXX";
 
-static char response_data[4096 * 2];
-
 // 聊天历史记录队列
 #define MAX_CHAT_HISTORY 20
 static char *chat_history[MAX_CHAT_HISTORY];
 static int chat_history_length = 0;
 
-// http客户端的事件处理回调函数
-static esp_err_t http_client_event_handler(esp_http_client_event_t *evt)
+static chatgpt_output_cb_t text_output;
+static void *text_output_ctx;
+
+// 每次取消加一, 请求记下开始时的值
+static volatile uint32_t s_generation;
+
+typedef struct
+{
+    chatgpt_sse_t sse;
+    chatgpt_output_cb_t output;
+    void *output_ctx;
+    char *answer; // 完整回答, 长度不设上限
+    size_t answer_len;
+    size_t answer_cap;
+    int64_t start_us;
+    int64_t first_delta_us;
+    uint32_t generation;
+} chatgpt_stream_t;
+
+static void chatgpt_on_delta(const char *text, size_t len, void *ctx)
 {
-    static int recived_len;
-    switch (evt->event_id)
-    {
-    case HTTP_EVENT_ON_CONNECTED:
-        recived_len = 0;
-        break;
-    case HTTP_EVENT_ON_DATA:
-        if (evt->user_data)
+    chatgpt_stream_t *stream = ctx;
+
+    // 已取消, 剩余的分片不再输出
+    if (stream->generation != s_generation)
+    {
+        return;
+    }
+    if (!stream->first_delta_us)
+    {
+        stream->first_delta_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "first delta after %lld ms", (stream->first_delta_us - stream->start_us) / 1000);
+    }
+    if (stream->answer_len + len + 1 > stream->answer_cap)
+    {
+        size_t cap = stream->answer_cap ? stream->answer_cap * 2 : 512;
+        while (stream->answer_len + len + 1 > cap)
+        {
+            cap *= 2;
+        }
+        char *grown = realloc(stream->answer, cap);
+        if (!grown)
         {
-            memcpy(evt->user_data + recived_len, evt->data, evt->data_len); // 将分片的每一片数据都复制到user_data
-            recived_len += evt->data_len;                                   // 累计偏移更新
+            ESP_LOGE(TAG, "no memory for %u bytes of answer", (unsigned)cap);
+            return;
         }
-        break;
-    case HTTP_EVENT_ON_FINISH:
-        recived_len = 0;
-        break;
-    case HTTP_EVENT_DISCONNECTED:
-        recived_len = 0;
-        break;
-    case HTTP_EVENT_ERROR:
-        recived_len = 0;
-        break;
-    default:
-        break;
+        stream->answer = grown;
+        stream->answer_cap = cap;
     }
+    memcpy(stream->answer + stream->answer_len, text, len);
+    stream->answer_len += len;
+    stream->answer[stream->answer_len] = '\0';
 
-    return ESP_OK;
+    if (stream->output)
+    {
+        stream->output(text, len, stream->output_ctx);
+    }
+    if (text_output)
+    {
+        text_output(text, len, text_output_ctx);
+    }
 }
 
-char *chatgpt_get_answer(char *prompt)
+uint32_t chatgpt_generation(void)
+{
+    return s_generation;
+}
+
+void chatgpt_cancel(void)
+{
+    s_generation++;
+}
+
+void chatgpt_set_text_output(chatgpt_output_cb_t output, void *ctx)
+{
+    text_output_ctx = ctx;
+    text_output = output;
+}
+
+char *chatgpt_get_answer(const char *prompt, uint32_t generation, chatgpt_output_cb_t output, void *ctx)
 {
     char *answer = NULL;
+    char buffer[256];
+
+    if (generation != s_generation)
+    {
+        ESP_LOGW(TAG, "request cancelled before it was sent");
+        return NULL;
+    }
 
     // 添加新的聊天记录到聊天历史队列
     if (chat_history_length >= MAX_CHAT_HISTORY)
@@ -90,6 +147,7 @@ char *chatgpt_get_answer(char *prompt)
 
     cJSON_AddStringToObject(root, "model", "gpt-3.5-turbo");
     cJSON_AddItemToObject(root, "messages", messages_array);
+    cJSON_AddBoolToObject(root, "stream", true);
 
     cJSON_AddNumberToObject(root, "temperature", 1);
     cJSON_AddNumberToObject(root, "presence_penalty", 0);
@@ -99,102 +157,142 @@ char *chatgpt_get_answer(char *prompt)
     ESP_LOGE(TAG, "Chat request: %s\n", request_params);
     cJSON_Delete(root);
 
-    // 发送HTTP请求
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_client_event_handler,
-        .user_data = response_data,
-        .crt_bundle_attach = esp_crt_bundle_attach};
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    // 发送HTTP请求, 回答以SSE分片返回, 每个分片解析后立即输出
+    chatgpt_stream_t stream = {
+        .output = output,
+        .output_ctx = ctx,
+        .start_us = esp_timer_get_time(),
+        .generation = generation,
+    };
+    chatgpt_sse_init(&stream.sse, chatgpt_on_delta, &stream);
+
+    // 连接保持在连接池中, 下一次提问不再握手
+    esp_http_client_handle_t client = app_http_acquire(url, NULL, NULL);
+    if (client == NULL)
+    {
+        chatgpt_sse_free(&stream.sse);
+        free(request_params);
+        return NULL;
+    }
 
     esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Authorization", apiKey);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, request_params, strlen(request_params));
-    // 设置超时时间20s
+    app_http_set_header(client, "Authorization", apiKey);
+    app_http_set_header(client, "Content-Type", "application/json");
+    app_http_set_header(client, "Accept", "text/event-stream");
+    // 设置超时时间20s, 流式响应时为两个分片之间的最长间隔
     esp_http_client_set_timeout_ms(client, 20000);
 
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK)
+    // 收到的数据直接交给SSE解析器; 每读一次检查是否已取消, 未读完的连接在释放时关闭
+    esp_err_t err = app_http_send(client, request_params, strlen(request_params));
+    while (err == ESP_OK && generation == s_generation)
     {
-        ESP_LOGI(TAG, "Chat Response Data: %s", response_data);
-
-        cJSON *json = cJSON_Parse(response_data);
-        if (json != NULL)
+        int len = esp_http_client_read(client, buffer, sizeof(buffer));
+        if (len <= 0)
         {
-            cJSON *choices_array = cJSON_GetObjectItem(json, "choices");
-            if (choices_array != NULL && cJSON_IsArray(choices_array) && cJSON_GetArraySize(choices_array) > 0)
-            {
-                cJSON *message_obj = cJSON_GetObjectItem(cJSON_GetArrayItem(choices_array, 0), "message");
-                if (message_obj != NULL)
-                {
-                    answer = strdup(cJSON_GetObjectItem(message_obj, "content")->valuestring);
-                }
-            }
-            cJSON_Delete(json);
+            err = esp_http_client_is_complete_data_received(client) ? ESP_OK : ESP_FAIL;
+            break;
         }
+        if (!chatgpt_sse_feed(&stream.sse, buffer, len))
+        {
+            ESP_LOGE(TAG, "no memory for the response, the rest is dropped");
+        }
+    }
+    chatgpt_sse_finish(&stream.sse);
+    if (generation != s_generation)
+    {
+        ESP_LOGW(TAG, "answer cancelled after %u bytes", (unsigned)stream.answer_len);
+    }
+    else if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Chat HTTP Post failed: %s", esp_err_to_name(err));
+    }
+    else if (stream.sse.error)
+    {
+        ESP_LOGE(TAG, "Chat error %d: %s", esp_http_client_get_status_code(client), stream.sse.error);
     }
     else
     {
-        answer = "Chat HTTP Post failed";
+        ESP_LOGI(TAG, "%d events, %d bad, %u bytes of answer in %lld ms%s", stream.sse.events, stream.sse.bad_events,
+                 (unsigned)stream.answer_len, (esp_timer_get_time() - stream.start_us) / 1000,
+                 stream.sse.done ? "" : ", no [DONE]");
+    }
+    // 连接中断时保留已收到的部分回答
+    if (stream.answer_len)
+    {
+        answer = stream.answer;
+        stream.answer = NULL;
     }
 
+    free(stream.answer);
+    chatgpt_sse_free(&stream.sse);
+    app_http_release(client, NULL);
     free(request_params);
-    esp_http_client_cleanup(client);
     return answer;
 }
 
-esp_err_t chatgpt_start(uint8_t *audio, int audio_len)
+static void chatgpt_speak(const char *text, size_t len, void *ctx)
 {
-    // 1.百度语音转文字
-    ESP_LOGE(TAG, "start baidu asr");
-    char *recognition_result = baidu_get_asr_result(audio, audio_len);
-    if (recognition_result == NULL)
+    app_tts_feed(text, len);
+}
+
+esp_err_t chatgpt_answer(const char *question, uint32_t generation)
+{
+    if (question == NULL || strlen(question) == 0)
     {
-        ESP_LOGE(TAG, "0. No text recognized");
+        ESP_LOGE(TAG, "No text recognized");
         return ESP_FAIL;
     }
-    if (strlen(recognition_result) == 0)
+    ESP_LOGE(TAG, "++++++++++user input: %s", question);
+
+    if (strcmp(question, "invalid_request_error") == 0)
     {
-        ESP_LOGE(TAG, "1. No text recognized");
+        ESP_LOGE(TAG, "Sorry, I can't understand.");
         return ESP_FAIL;
     }
-    ESP_LOGE(TAG, "++++++++++user input: %s", recognition_result);
-
-    if (strcmp(recognition_result, "invalid_request_error") == 0)
+    if (generation != s_generation)
     {
-        ESP_LOGE(TAG, "Sorry, I can't understand.");
+        ESP_LOGW(TAG, "question cancelled");
         return ESP_FAIL;
     }
 
-    // 2.获得chatgpt的回答
+    // 2.获得chatgpt的回答, 3.文字转语音
+    // 回答边接收边按句合成, 第一句播放时合成下一句
     ESP_LOGE(TAG, "start chatgpt");
-    char *response = chatgpt_get_answer(recognition_result);
+    esp_err_t status = app_tts_begin();
+    if (status != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Error start tts: %s", esp_err_to_name(status));
+    }
+    char *response = chatgpt_get_answer(question, generation, status == ESP_OK ? chatgpt_speak : NULL, NULL);
+    if (status == ESP_OK)
+    {
+        app_tts_end();
+    }
     if (response == NULL)
     {
         ESP_LOGE(TAG, "0. Sorry, I can't understand.");
         return ESP_FAIL;
     }
     ESP_LOGE(TAG, "++++++++++chatgpt response: %s\r\n", response);
-    if (strcmp(response, "invalid_request_error") == 0)
+    free(response);
+
+    return ESP_OK;
+}
+
+esp_err_t chatgpt_start(uint8_t *audio, int audio_len, uint32_t generation)
+{
+    // 1.百度语音转文字
+    ESP_LOGE(TAG, "start baidu asr");
+    char *recognition_result = baidu_get_asr_result(audio, audio_len);
+    if (recognition_result == NULL)
     {
-        ESP_LOGE(TAG, "1. Sorry, I can't understand.");
+        ESP_LOGE(TAG, "0. No text recognized");
         return ESP_FAIL;
     }
 
-    // 3.文字转语音
-    ESP_LOGE(TAG, "start baidu tts");
-    esp_err_t status = baidu_get_tts_result(response, strlen(response));
-    if (status != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Error post baidu tts: %s", esp_err_to_name(status));
-    }
+    esp_err_t ret = chatgpt_answer(recognition_result, generation);
 
     // 4.释放内存
-    if (recognition_result)
-        free(recognition_result);
-    if (response)
-        free(response);
-
-    return ESP_OK;
-}
\ No newline at end of file
+    free(recognition_result);
+    return ret;
+}
@@ -1,7 +1,40 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_system.h"
 
-esp_err_t chatgpt_start(uint8_t *audio, int audio_len);
+// 回答的文字分片, 收到一个SSE事件调用一次, text不以'\0'结尾
+typedef void (*chatgpt_output_cb_t)(const char *text, size_t len, void *ctx);
 
+/**
+ * @brief 当前的请求代数, 排队等待回答的问题记下它, 请求时传入
+ */
+uint32_t chatgpt_generation(void);
 
+/**
+ * @brief 取消之前代数的请求, 可在其他任务中调用; 进行中的请求停止接收, 排队的请求不再发出
+ */
+void chatgpt_cancel(void);
+
+/**
+ * @brief 整段上传录音识别后回答
+ */
+esp_err_t chatgpt_start(uint8_t *audio, int audio_len, uint32_t generation);
+
+/**
+ * @brief 回答已识别的问题, 边接收边播放
+ */
+esp_err_t chatgpt_answer(const char *question, uint32_t generation);
+
+/**
+ * @brief 流式请求chatgpt, 每收到一段回答就调用output
+ * @param generation chatgpt_generation()的值, chatgpt_cancel()之后停止接收
+ * @return 完整回答, 由调用者free; 失败返回NULL, 连接中断或取消时返回已收到的部分
+ */
+char *chatgpt_get_answer(const char *prompt, uint32_t generation, chatgpt_output_cb_t output, void *ctx);
+
+/**
+ * @brief 文字输出, 例如把回答打字到主机; 与语音同时进行, NULL关闭
+ */
+void chatgpt_set_text_output(chatgpt_output_cb_t output, void *ctx);
@@ -0,0 +1,396 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// jsmn_parse() itself is compiled in json_utils.c
+#define JSMN_HEADER
+#include "jsmn.h"
+#include "chatgpt_sse.h"
+
+// Tokens for a typical delta event, the array grows for larger ones
+#define SSE_TOKENS_MIN 64
+
+static bool sse_append(char **buf, size_t *len, size_t *cap, const char *data, size_t n)
+{
+    if (*len + n + 1 > *cap)
+    {
+        size_t new_cap = *cap ? *cap : 256;
+        while (*len + n + 1 > new_cap)
+        {
+            new_cap *= 2;
+        }
+        char *grown = realloc(*buf, new_cap);
+        if (!grown)
+        {
+            return false;
+        }
+        *buf = grown;
+        *cap = new_cap;
+    }
+    memcpy(*buf + *len, data, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+    return true;
+}
+
+/* ---------- JSON ---------- */
+
+// Index of the token after the subtree at i
+static int json_skip(const jsmntok_t *t, int count, int i)
+{
+    int end = i + 1;
+    for (int n = t[i].size; n > 0 && end < count; n--)
+    {
+        end = json_skip(t, count, end);
+    }
+    return end;
+}
+
+static int json_key(const char *js, const jsmntok_t *t, int count, int obj, const char *key)
+{
+    if (obj < 0 || obj >= count || t[obj].type != JSMN_OBJECT)
+    {
+        return -1;
+    }
+    size_t key_len = strlen(key);
+    int i = obj + 1;
+    for (int n = 0; n < t[obj].size && i + 1 < count; n++)
+    {
+        if (t[i].type == JSMN_STRING && (size_t)(t[i].end - t[i].start) == key_len &&
+            memcmp(js + t[i].start, key, key_len) == 0)
+        {
+            return i + 1;
+        }
+        i = json_skip(t, count, i);
+    }
+    return -1;
+}
+
+static int json_item(const jsmntok_t *t, int count, int arr, int index)
+{
+    if (arr < 0 || arr >= count || t[arr].type != JSMN_ARRAY || index >= t[arr].size)
+    {
+        return -1;
+    }
+    int i = arr + 1;
+    while (index-- > 0 && i < count)
+    {
+        i = json_skip(t, count, i);
+    }
+    return i < count ? i : -1;
+}
+
+static int json_hex4(const char *s)
+{
+    int v = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        char c = s[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9')
+        {
+            v |= c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            v |= c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            v |= c - 'A' + 10;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return v;
+}
+
+static size_t json_put_utf8(char *out, uint32_t cp)
+{
+    if (cp < 0x80)
+    {
+        out[0] = cp;
+        return 1;
+    }
+    if (cp < 0x800)
+    {
+        out[0] = 0xc0 | (cp >> 6);
+        out[1] = 0x80 | (cp & 0x3f);
+        return 2;
+    }
+    if (cp < 0x10000)
+    {
+        out[0] = 0xe0 | (cp >> 12);
+        out[1] = 0x80 | ((cp >> 6) & 0x3f);
+        out[2] = 0x80 | (cp & 0x3f);
+        return 3;
+    }
+    out[0] = 0xf0 | (cp >> 18);
+    out[1] = 0x80 | ((cp >> 12) & 0x3f);
+    out[2] = 0x80 | ((cp >> 6) & 0x3f);
+    out[3] = 0x80 | (cp & 0x3f);
+    return 4;
+}
+
+// Unescape a JSON string token in place, the result is never longer than the escaped text
+static size_t json_unescape(char *s, size_t len)
+{
+    size_t out = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (s[i] != '\\' || i + 1 >= len)
+        {
+            s[out++] = s[i];
+            continue;
+        }
+        char c = s[++i];
+        switch (c)
+        {
+        case 'n':
+            s[out++] = '\n';
+            break;
+        case 't':
+            s[out++] = '\t';
+            break;
+        case 'r':
+            s[out++] = '\r';
+            break;
+        case 'b':
+            s[out++] = '\b';
+            break;
+        case 'f':
+            s[out++] = '\f';
+            break;
+        case 'u':
+        {
+            int cp = i + 4 < len ? json_hex4(s + i + 1) : -1;
+            if (cp < 0)
+            {
+                s[out++] = c;
+                break;
+            }
+            i += 4;
+            // UTF-16 surrogate pair
+            if (cp >= 0xd800 && cp < 0xdc00 && i + 6 < len && s[i + 1] == '\\' && s[i + 2] == 'u')
+            {
+                int low = json_hex4(s + i + 3);
+                if (low >= 0xdc00 && low < 0xe000)
+                {
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    i += 6;
+                }
+            }
+            out += json_put_utf8(s + out, cp);
+            break;
+        }
+        default: // \" \\ \/
+            s[out++] = c;
+            break;
+        }
+    }
+    return out;
+}
+
+// Parse the JSON in sse->data, tokens are allocated to fit
+static int sse_parse_json(chatgpt_sse_t *sse, jsmntok_t **tokens)
+{
+    jsmn_parser parser;
+    unsigned int count = SSE_TOKENS_MIN;
+    int r;
+
+    *tokens = NULL;
+    do
+    {
+        jsmntok_t *grown = realloc(*tokens, count * sizeof(jsmntok_t));
+        if (!grown)
+        {
+            sse->oom = true;
+            return -1;
+        }
+        *tokens = grown;
+        jsmn_init(&parser);
+        r = jsmn_parse(&parser, sse->data, sse->data_len, *tokens, count);
+        count *= 2;
+    } while (r == JSMN_ERROR_NOMEM);
+    return r;
+}
+
+static void sse_emit_string(chatgpt_sse_t *sse, const jsmntok_t *tok)
+{
+    if (tok->type != JSMN_STRING || tok->end <= tok->start)
+    {
+        return;
+    }
+    size_t len = json_unescape(sse->data + tok->start, tok->end - tok->start);
+    if (len && sse->on_delta)
+    {
+        sse->on_delta(sse->data + tok->start, len, sse->ctx);
+    }
+}
+
+static void sse_dispatch(chatgpt_sse_t *sse)
+{
+    jsmntok_t *t;
+
+    if (!sse->data_len)
+    {
+        return;
+    }
+    if (!sse->json && sse->data_len == 6 && memcmp(sse->data, "[DONE]", 6) == 0)
+    {
+        sse->done = true;
+        sse->data_len = 0;
+        return;
+    }
+
+    int count = sse_parse_json(sse, &t);
+    if (count < 1 || t[0].type != JSMN_OBJECT)
+    {
+        sse->bad_events++;
+    }
+    else
+    {
+        sse->events++;
+        int choice = json_item(t, count, json_key(sse->data, t, count, 0, "choices"), 0);
+        int content = json_key(sse->data, t, count, json_key(sse->data, t, count, choice, "delta"), "content");
+        if (content < 0)
+        {
+            content = json_key(sse->data, t, count, json_key(sse->data, t, count, choice, "message"), "content");
+        }
+        if (content >= 0)
+        {
+            sse_emit_string(sse, &t[content]);
+        }
+
+        int message = json_key(sse->data, t, count, json_key(sse->data, t, count, 0, "error"), "message");
+        if (message >= 0 && t[message].type == JSMN_STRING && !sse->error)
+        {
+            size_t len = json_unescape(sse->data + t[message].start, t[message].end - t[message].start);
+            sse->error = strndup(sse->data + t[message].start, len);
+        }
+    }
+    free(t);
+    sse->data_len = 0;
+}
+
+/* ---------- SSE ---------- */
+
+static void sse_line(chatgpt_sse_t *sse)
+{
+    const char *line = sse->line ? sse->line : "";
+    size_t len = sse->line_len;
+
+    if (!sse->started && len)
+    {
+        sse->started = true;
+        sse->json = line[0] == '{' || line[0] == '[';
+    }
+    if (sse->json)
+    {
+        // Keep the body as is, it is parsed at the end
+        if (!sse_append(&sse->data, &sse->data_len, &sse->data_cap, line, len) ||
+            !sse_append(&sse->data, &sse->data_len, &sse->data_cap, "\n", 1))
+        {
+            sse->oom = true;
+        }
+        return;
+    }
+
+    if (len == 0)
+    {
+        sse_dispatch(sse);
+        return;
+    }
+    if (line[0] == ':' || len < 5 || memcmp(line, "data:", 5) != 0)
+    {
+        // Comment, or a field other than data
+        return;
+    }
+    line += 5;
+    len -= 5;
+    if (len && line[0] == ' ')
+    {
+        line++;
+        len--;
+    }
+    // Several data lines of one event are joined with a line feed
+    if ((sse->data_len && !sse_append(&sse->data, &sse->data_len, &sse->data_cap, "\n", 1)) ||
+        !sse_append(&sse->data, &sse->data_len, &sse->data_cap, line, len))
+    {
+        sse->oom = true;
+    }
+}
+
+void chatgpt_sse_init(chatgpt_sse_t *sse, chatgpt_sse_delta_cb_t on_delta, void *ctx)
+{
+    memset(sse, 0, sizeof(chatgpt_sse_t));
+    sse->on_delta = on_delta;
+    sse->ctx = ctx;
+}
+
+bool chatgpt_sse_feed(chatgpt_sse_t *sse, const char *buf, size_t len)
+{
+    size_t start = 0;
+
+    for (size_t i = 0; i < len && !sse->oom; i++)
+    {
+        char c = buf[i];
+        if (c != '\r' && c != '\n')
+        {
+            sse->skip_lf = false;
+            continue;
+        }
+        if (c == '\n' && sse->skip_lf && i == start)
+        {
+            // Second half of a CRLF split across two chunks
+            sse->skip_lf = false;
+            start = i + 1;
+            continue;
+        }
+        if (!sse_append(&sse->line, &sse->line_len, &sse->line_cap, buf + start, i - start))
+        {
+            sse->oom = true;
+            break;
+        }
+        sse_line(sse);
+        sse->line_len = 0;
+        sse->skip_lf = c == '\r';
+        if (c == '\r' && i + 1 < len && buf[i + 1] == '\n')
+        {
+            i++;
+            sse->skip_lf = false;
+        }
+        start = i + 1;
+    }
+    if (!sse->oom && start < len &&
+        !sse_append(&sse->line, &sse->line_len, &sse->line_cap, buf + start, len - start))
+    {
+        sse->oom = true;
+    }
+    return !sse->oom;
+}
+
+void chatgpt_sse_finish(chatgpt_sse_t *sse)
+{
+    if (sse->oom)
+    {
+        return;
+    }
+    if (sse->line_len)
+    {
+        sse_line(sse);
+        sse->line_len = 0;
+    }
+    sse_dispatch(sse);
+}
+
+void chatgpt_sse_free(chatgpt_sse_t *sse)
+{
+    free(sse->line);
+    free(sse->data);
+    free(sse->error);
+    memset(sse, 0, sizeof(chatgpt_sse_t));
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Incremental parser for the server-sent events of a streamed chat completion
+ * ("stream": true). Feed it the HTTP body in chunks of any size, it calls on_delta with the
+ * unescaped text of every choices[0].delta.content as soon as its event is complete.
+ *
+ * A body that is plain JSON instead of SSE, a non streaming completion or an error object,
+ * is parsed at chatgpt_sse_finish(): choices[0].message.content goes to on_delta and
+ * error.message to chatgpt_sse_t.error.
+ *
+ * No ESP-IDF dependencies, so it also builds on the host, see tools/chatgpt_sse_host.
+ */
+
+typedef void (*chatgpt_sse_delta_cb_t)(const char *text, size_t len, void *ctx);
+
+typedef struct
+{
+    chatgpt_sse_delta_cb_t on_delta;
+    void *ctx;
+
+    char *line;      // line being received
+    size_t line_len;
+    size_t line_cap;
+    char *data;      // data of the event being received, or the whole body in JSON mode
+    size_t data_len;
+    size_t data_cap;
+    bool skip_lf;    // the last line ended with CR, a following LF belongs to it
+    bool json;       // the body is not SSE
+    bool started;    // a non empty line was seen
+
+    bool done;       // data: [DONE] received
+    bool oom;        // a buffer could not grow, the rest of the body is ignored
+    int events;      // events parsed
+    int bad_events;  // events that were not valid JSON
+    char *error;     // error.message of an error reply, NULL otherwise
+} chatgpt_sse_t;
+
+void chatgpt_sse_init(chatgpt_sse_t *sse, chatgpt_sse_delta_cb_t on_delta, void *ctx);
+
+/**
+ * @brief Parse the next part of the body.
+ * @return false once out of memory
+ */
+bool chatgpt_sse_feed(chatgpt_sse_t *sse, const char *buf, size_t len);
+
+/**
+ * @brief End of body, dispatches an event not terminated by a blank line.
+ */
+void chatgpt_sse_finish(chatgpt_sse_t *sse);
+
+void chatgpt_sse_free(chatgpt_sse_t *sse);
@@ -7,6 +7,7 @@
 #include "driver/gpio.h"
 #include "esp32s3/rom/ets_sys.h"
 #include "audio_player.h"
+#include "app_prompt.h"
 #include "rgb_matrix.h"
 #include "app_led.h"
 #include "bsp_keyboard.h"
@@ -14,6 +15,7 @@
 #include "keyboard.h"
 #include "app_espnow.h"
 #include "app_uart.h"
+#include "settings.h"
 
 enum {
     SPECIAL_KEY_CUSTOM_LEFT = 0,
@@ -282,11 +284,11 @@ void shutdownByFn(void)
             if (xTaskGetTickCount() - fnPressedTime > 2000)
             {
                 bspWs2812Enable(false);
+                // Written while the power off sound plays
+                settings_commit();
                 if (!bsp_audio_mute_is_enable())
                 {
-                    FILE *fp = fopen("/spiffs/powerOff.wav", "r");
-                    if (fp)
-                        audio_player_play(fp);
+                    app_prompt_play(APP_PROMPT_POWER_OFF, false);
                 }
                 fnPressedTime = 0xffffffff;
                 shutdownState = 1;
@@ -298,9 +300,10 @@ void shutdownByFn(void)
         fnPressedTime = 0;
     }
 
-    if (shutdownState && !getFnKey() && audio_player_get_state() == AUDIO_PLAYER_STATE_IDLE)
+    if (shutdownState && !getFnKey() && audio_player_get_state() == AUDIO_PLAYER_STATE_IDLE && !app_prompt_is_playing())
     {
         shutdownState = 0;
+        settings_commit();
         bsp_power_off();
     }
 }
\ No newline at end of file
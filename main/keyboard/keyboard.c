@@ -15,6 +15,7 @@
 #include "app_espnow.h"
 #include "app_udp_client.h"
 #include "app_uart.h"
+#include "app_click.h"
 
 
 // 去抖动算法: https://www.kennethkuhn.com/electronics/debounce.c
@@ -225,6 +226,24 @@ static void keyToHidMessage(void)
     }
 }
 
+#if CONFIG_APP_KEY_CLICK
+/// @brief 有新按下的键时播放按键音, 直接通知混音器, 不经过播放器
+/// @param  
+static void keyClickOnPress(void)
+{
+    static uint8_t lastRemapBuffer[IO_NUMBER / 8] = {0};
+    bool pressed = false;
+    for (int16_t i = 0; i < IO_NUMBER / 8; i++)
+    {
+        if (remapBuffer[i] & ~lastRemapBuffer[i])
+            pressed = true;
+        lastRemapBuffer[i] = remapBuffer[i];
+    }
+    if (pressed)
+        app_click_play();
+}
+#endif
+
 /***************************************************************************
  * 键盘任务
 ***************************************************************************/
@@ -239,6 +258,9 @@ static void keyboardTask(void *arg)
         ScanKeyStates();
         ApplyDebounceFilter();
         keyboardRemap();
+#if CONFIG_APP_KEY_CLICK
+        keyClickOnPress();
+#endif
         keyToHidMessage();
         // printScanBuffer(); // 打印扫描到的键值
         printRemapBuffer(); // 打印映射后的键值
@@ -1,3 +1,6 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
 #include "esp_log.h"
 #include "esp_check.h"
 #include "driver/gpio.h"
@@ -26,6 +29,19 @@
 #define BSP_I2S_DSIN          (GPIO_NUM_16) // From ADC ES7210
 #define BSP_POWER_AMP_IO      (-1)          // (GPIO_NUM_46)
 #define BSP_MUTE_STATUS       (GPIO_NUM_1)
+/* Both directions of the duplex channel get the same descriptors. RX needs the depth: the AFE
+ * feed task reads 512 frame chunks, 24 descriptors of 64 frames hold 1536 frames, 96 ms or three
+ * chunks, so the feed task can be held up for two chunks before microphone frames are dropped.
+ * TX uses the short descriptors for latency and bsp_i2s_write() keeps at most
+ * BSP_I2S_TX_AHEAD_FRAMES queued, a new sound is heard within 32 ms while the output plays. */
+#define BSP_I2S_DMA_DESC_NUM    (24)
+#define BSP_I2S_DMA_FRAME_NUM   (64)        // 4 ms at 16 kHz
+#define BSP_I2S_TX_AHEAD_FRAMES (512)
+#define BSP_I2S_TX_FRAME_BYTES  (BSP_I2S_TX_CHANNELS * BSP_I2S_BITS / 8)
+#if CONFIG_APP_SR_TDM_CAPTURE
+#define BSP_I2S_RX_SLOTS      (4)           // ES7210 TDM frame, MIC1 to MIC4
+#define BSP_ADC_REF_GAIN      (0.0)         // MIC3 carries line level, not a microphone
+#endif
 
 #define BSP_ERROR_CHECK_RETURN_ERR(x)    ESP_ERROR_CHECK(x)
 #define BSP_ERROR_CHECK_RETURN_NULL(x)   ESP_ERROR_CHECK(x)
@@ -40,6 +56,17 @@ i2c_master_bus_handle_t i2c_bus_handle;
 
 static i2s_chan_handle_t i2s_tx_chan = NULL;
 static i2s_chan_handle_t i2s_rx_chan = NULL;
+static SemaphoreHandle_t i2s_tx_sent = NULL;  /* given for every TX descriptor sent */
+static int32_t i2s_tx_queued = 0;             /* frames written and not sent yet */
+static portMUX_TYPE i2s_tx_lock = portMUX_INITIALIZER_UNLOCKED;
+/* Playback timing against the capture, both directions run on one clock, so frame counts
+ * compare directly. Written under i2s_tx_lock. */
+static uint32_t i2s_rx_received = 0;          /* frames the RX DMA received, dropped ones included */
+static uint32_t i2s_rx_dropped = 0;           /* frames lost to an RX queue overflow */
+static uint32_t i2s_rx_read = 0;              /* frames bsp_i2s_read() returned */
+static int i2s_tx_run_pending = 0;            /* descriptors to be sent until the first one of a new run */
+static uint32_t i2s_tx_run_seq = 0;
+static uint32_t i2s_tx_run_frame = 0;         /* capture frame the last run started on */
 static const audio_codec_data_if_t *i2s_data_if = NULL; /* Codec data interface */
 
 /* Can be used for i2s_std_gpio_config_t and/or i2s_std_config_t initialization */
@@ -57,6 +84,22 @@ static const audio_codec_data_if_t *i2s_data_if = NULL; /* Codec data interface
         },                     \
     }
 
+#if CONFIG_APP_SR_TDM_CAPTURE
+/* The receive side in TDM mode, the DMA only stores the active slots, so MIC1, MIC2 and MIC3
+ * arrive interleaved in the order the AFE reads them. Clocks and slots are set again when
+ * the record device is opened.
+ */
+#define BSP_I2S_TDM_RX_CFG(_sample_rate)                                                   \
+    {                                                                                      \
+        .clk_cfg = I2S_TDM_CLK_DEFAULT_CONFIG(_sample_rate),                               \
+        .slot_cfg = I2S_TDM_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT,          \
+                                                        I2S_SLOT_MODE_STEREO,              \
+                                                        I2S_TDM_SLOT0 | I2S_TDM_SLOT1 |    \
+                                                            I2S_TDM_SLOT2),                \
+        .gpio_cfg = BSP_I2S_GPIO_CFG,                                                      \
+    }
+#endif
+
 /* This configuration is used by default in bsp_i2s_init() */
 #define BSP_I2S_DUPLEX_MONO_CFG(_sample_rate)                                                         \
     {                                                                                                 \
@@ -65,6 +108,42 @@ static const audio_codec_data_if_t *i2s_data_if = NULL; /* Codec data interface
         .gpio_cfg = BSP_I2S_GPIO_CFG,                                                                 \
     }
 
+static bool IRAM_ATTR bsp_i2s_tx_on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    BaseType_t need_yield = pdFALSE;
+
+    /* Sent silence while idle, the count stays at 0 */
+    portENTER_CRITICAL_ISR(&i2s_tx_lock);
+    i2s_tx_queued = i2s_tx_queued > BSP_I2S_DMA_FRAME_NUM ? i2s_tx_queued - BSP_I2S_DMA_FRAME_NUM : 0;
+    if (i2s_tx_run_pending && --i2s_tx_run_pending == 0)
+    {
+        /* The descriptor went out over the last BSP_I2S_DMA_FRAME_NUM frames. The RX descriptor in
+         * progress is not counted yet, so the start is placed up to one descriptor early, never late */
+        i2s_tx_run_frame = i2s_rx_received - BSP_I2S_DMA_FRAME_NUM;
+        i2s_tx_run_seq++;
+    }
+    portEXIT_CRITICAL_ISR(&i2s_tx_lock);
+    xSemaphoreGiveFromISR(i2s_tx_sent, &need_yield);
+    return need_yield == pdTRUE;
+}
+
+static bool IRAM_ATTR bsp_i2s_rx_on_recv(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    portENTER_CRITICAL_ISR(&i2s_tx_lock);
+    i2s_rx_received += BSP_I2S_DMA_FRAME_NUM;
+    portEXIT_CRITICAL_ISR(&i2s_tx_lock);
+    return false;
+}
+
+static bool IRAM_ATTR bsp_i2s_rx_on_recv_q_ovf(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    /* The reader never sees these frames, its position still moves past them */
+    portENTER_CRITICAL_ISR(&i2s_tx_lock);
+    i2s_rx_dropped += BSP_I2S_DMA_FRAME_NUM;
+    portEXIT_CRITICAL_ISR(&i2s_tx_lock);
+    return false;
+}
+
 esp_err_t bsp_i2s_init(const i2s_std_config_t *i2s_config)
 {
     esp_err_t ret = ESP_FAIL;
@@ -77,6 +156,8 @@ esp_err_t bsp_i2s_init(const i2s_std_config_t *i2s_config)
     /* Setup I2S peripheral */
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(CONFIG_BSP_I2S_NUM, I2S_ROLE_MASTER);
     chan_cfg.auto_clear = true; // Auto clear the legacy data in the DMA buffer
+    chan_cfg.dma_desc_num = BSP_I2S_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = BSP_I2S_DMA_FRAME_NUM;
     BSP_ERROR_CHECK_RETURN_ERR(i2s_new_channel(&chan_cfg, &i2s_tx_chan, &i2s_rx_chan));
 
     /* Setup I2S channels */
@@ -90,11 +171,28 @@ esp_err_t bsp_i2s_init(const i2s_std_config_t *i2s_config)
     if (i2s_tx_chan != NULL)
     {
         ESP_GOTO_ON_ERROR(i2s_channel_init_std_mode(i2s_tx_chan, p_i2s_cfg), err, TAG, "I2S channel initialization failed");
+        i2s_tx_sent = xSemaphoreCreateBinary();
+        ESP_GOTO_ON_FALSE(i2s_tx_sent, ESP_ERR_NO_MEM, err, TAG, "No memory for the TX semaphore");
+        const i2s_event_callbacks_t tx_cbs = {
+            .on_sent = bsp_i2s_tx_on_sent,
+        };
+        ESP_GOTO_ON_ERROR(i2s_channel_register_event_callback(i2s_tx_chan, &tx_cbs, NULL), err, TAG, "I2S callback failed");
         ESP_GOTO_ON_ERROR(i2s_channel_enable(i2s_tx_chan), err, TAG, "I2S enabling failed");
     }
     if (i2s_rx_chan != NULL)
     {
+#if CONFIG_APP_SR_TDM_CAPTURE
+        i2s_tdm_config_t tdm_cfg = BSP_I2S_TDM_RX_CFG(p_i2s_cfg->clk_cfg.sample_rate_hz);
+        tdm_cfg.slot_cfg.total_slot = BSP_I2S_RX_SLOTS;
+        ESP_GOTO_ON_ERROR(i2s_channel_init_tdm_mode(i2s_rx_chan, &tdm_cfg), err, TAG, "I2S channel initialization failed");
+#else
         ESP_GOTO_ON_ERROR(i2s_channel_init_std_mode(i2s_rx_chan, p_i2s_cfg), err, TAG, "I2S channel initialization failed");
+#endif
+        const i2s_event_callbacks_t rx_cbs = {
+            .on_recv = bsp_i2s_rx_on_recv,
+            .on_recv_q_ovf = bsp_i2s_rx_on_recv_q_ovf,
+        };
+        ESP_GOTO_ON_ERROR(i2s_channel_register_event_callback(i2s_rx_chan, &rx_cbs, NULL), err, TAG, "I2S callback failed");
         ESP_GOTO_ON_ERROR(i2s_channel_enable(i2s_rx_chan), err, TAG, "I2S enabling failed");
     }
 
@@ -234,6 +332,10 @@ esp_codec_dev_handle_t bsp_audio_codec_microphone_init(void)
 
     es7210_codec_cfg_t es7210_cfg = {
         .ctrl_if = i2c_ctrl_if,
+#if CONFIG_APP_SR_TDM_CAPTURE
+        // Three inputs switch the ES7210 to TDM, MIC3 is the playback reference
+        .mic_selected = ES7120_SEL_MIC1 | ES7120_SEL_MIC2 | ES7120_SEL_MIC3,
+#endif
     };
     const audio_codec_if_t *es7210_dev = es7210_codec_new(&es7210_cfg);
     BSP_NULL_CHECK(es7210_dev, NULL);
@@ -246,10 +348,10 @@ esp_codec_dev_handle_t bsp_audio_codec_microphone_init(void)
     return esp_codec_dev_new(&codec_es7210_dev_cfg);
 }
 
-#define CODEC_DEFAULT_SAMPLE_RATE          (16000)
-#define CODEC_DEFAULT_BIT_WIDTH            (16)
+#define CODEC_DEFAULT_SAMPLE_RATE          BSP_I2S_SAMPLE_RATE
+#define CODEC_DEFAULT_BIT_WIDTH            BSP_I2S_BITS
 #define CODEC_DEFAULT_ADC_VOLUME           (24.0)
-#define CODEC_DEFAULT_CHANNEL              (2)
+#define CODEC_DEFAULT_CHANNEL              BSP_I2S_TX_CHANNELS
 
 static esp_codec_dev_handle_t play_dev_handle;
 static esp_codec_dev_handle_t record_dev_handle;
@@ -259,12 +361,64 @@ esp_err_t bsp_i2s_read(void *audio_buffer, size_t len, size_t *bytes_read, uint3
     esp_err_t ret = ESP_OK;
     ret = esp_codec_dev_read(record_dev_handle, audio_buffer, len);
     *bytes_read = len;
+    portENTER_CRITICAL(&i2s_tx_lock);
+    i2s_rx_read += len / (BSP_I2S_RX_CHANNELS * sizeof(int16_t));
+    portEXIT_CRITICAL(&i2s_tx_lock);
     return ret;
 }
 
+uint32_t bsp_i2s_rx_position(void)
+{
+    portENTER_CRITICAL(&i2s_tx_lock);
+    uint32_t position = i2s_rx_read + i2s_rx_dropped;
+    portEXIT_CRITICAL(&i2s_tx_lock);
+    return position;
+}
+
+bool bsp_i2s_tx_idle(void)
+{
+    portENTER_CRITICAL(&i2s_tx_lock);
+    bool idle = i2s_tx_queued == 0;
+    portEXIT_CRITICAL(&i2s_tx_lock);
+    return idle;
+}
+
+uint32_t bsp_i2s_tx_run_start(uint32_t *frame)
+{
+    portENTER_CRITICAL(&i2s_tx_lock);
+    uint32_t seq = i2s_tx_run_seq;
+    *frame = i2s_tx_run_frame;
+    portEXIT_CRITICAL(&i2s_tx_lock);
+    return seq;
+}
+
 esp_err_t bsp_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
 {
     esp_err_t ret = ESP_OK;
+    int32_t frames = len / BSP_I2S_TX_FRAME_BYTES;
+
+    /* Wait for the queue ahead of the output to drain instead of filling every descriptor,
+     * with a timeout in case the channel was stopped */
+    while (i2s_tx_sent)
+    {
+        portENTER_CRITICAL(&i2s_tx_lock);
+        bool room = i2s_tx_queued == 0 || i2s_tx_queued + frames <= BSP_I2S_TX_AHEAD_FRAMES;
+        if (room)
+        {
+            /* Nothing ahead of this block, it starts a run. The driver fills the descriptor
+             * after the one in flight, so the run starts with the second descriptor sent */
+            if (i2s_tx_queued == 0)
+            {
+                i2s_tx_run_pending = 2;
+            }
+            i2s_tx_queued += frames;
+        }
+        portEXIT_CRITICAL(&i2s_tx_lock);
+        if (room || xSemaphoreTake(i2s_tx_sent, pdMS_TO_TICKS(100)) != pdTRUE)
+        {
+            break;
+        }
+    }
     ret = esp_codec_dev_write(play_dev_handle, audio_buffer, len);
     *bytes_written = len;
     return ret;
@@ -279,6 +433,18 @@ esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
         .channel = ch,
         .bits_per_sample = bits_cfg,
     };
+#if CONFIG_APP_SR_TDM_CAPTURE
+    // The microphones keep their TDM layout whatever the player sets
+    esp_codec_dev_sample_info_t record_fs = {
+        .sample_rate = rate,
+        .channel = BSP_I2S_RX_SLOTS,
+        .channel_mask = ESP_CODEC_DEV_MAKE_CHANNEL_MASK(0) | ESP_CODEC_DEV_MAKE_CHANNEL_MASK(1) |
+                        ESP_CODEC_DEV_MAKE_CHANNEL_MASK(2),
+        .bits_per_sample = bits_cfg,
+    };
+#else
+    esp_codec_dev_sample_info_t record_fs = fs;
+#endif
 
     if (play_dev_handle) {
         ret = esp_codec_dev_close(play_dev_handle);
@@ -292,7 +458,10 @@ esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
         ret |= esp_codec_dev_open(play_dev_handle, &fs);
     }
     if (record_dev_handle) {
-        ret |= esp_codec_dev_open(record_dev_handle, &fs);
+        ret |= esp_codec_dev_open(record_dev_handle, &record_fs);
+#if CONFIG_APP_SR_TDM_CAPTURE
+        ret |= esp_codec_dev_set_in_channel_gain(record_dev_handle, ESP_CODEC_DEV_MAKE_CHANNEL_MASK(2), BSP_ADC_REF_GAIN);
+#endif
     }
     return ret;
 }
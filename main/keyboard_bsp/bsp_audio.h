@@ -4,12 +4,40 @@
 #include <stdint.h>
 #include "esp_err.h"
 #include "driver/i2s_std.h"
+#if CONFIG_APP_SR_TDM_CAPTURE
+#include "driver/i2s_tdm.h"
+#endif
+
+/* The duplex I2S format, set once in bsp_audio_init(). Playback is converted to it, so the
+ * microphone stream is never interrupted by a clip.
+ */
+#define BSP_I2S_SAMPLE_RATE (16000)
+#define BSP_I2S_BITS        (16)
+#define BSP_I2S_TX_CHANNELS (2)
+
+/* Channels per frame bsp_i2s_read() returns: MIC1, MIC2 and the playback reference from MIC3
+ * in TDM mode, otherwise MIC1 and MIC2.
+ */
+#if CONFIG_APP_SR_TDM_CAPTURE
+#define BSP_I2S_RX_CHANNELS (3)
+#else
+#define BSP_I2S_RX_CHANNELS (2)
+#endif
 
 esp_err_t bsp_codec_mute_set(bool enable);
 esp_err_t bsp_codec_volume_set(int volume, int *volume_set);
 esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
 esp_err_t bsp_i2s_read(void *audio_buffer, size_t len, size_t *bytes_read, uint32_t timeout_ms);
 esp_err_t bsp_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
+
+/* Playback timing for the echo reference, in capture frames. Frames are counted on the RX DMA,
+ * the next frame bsp_i2s_read() returns has index bsp_i2s_rx_position(). A playback run starts
+ * with a bsp_i2s_write() while nothing is queued. When its first DMA descriptor has been sent,
+ * bsp_i2s_tx_run_start() returns a new sequence number and the capture frame the run started on.
+ */
+uint32_t bsp_i2s_rx_position(void);
+bool bsp_i2s_tx_idle(void);
+uint32_t bsp_i2s_tx_run_start(uint32_t *frame);
 esp_err_t bsp_i2c_init(void);
 esp_err_t bsp_audio_init(void);
 
@@ -18,6 +18,7 @@
 #include "app_uart.h"
 #include "app_led.h"
 #include "app_wifi.h"
+#include "app_http.h"
 #include "app_sr.h"
 #include "bsp_keyboard.h"
 #include "keyboard.h"
@@ -43,6 +44,8 @@ void app_main(void)
     
     app_uart_init();
 
+    // Before the network task, every HTTP request goes through the pool
+    ESP_ERROR_CHECK(app_http_init());
     app_network_start();
 
     app_tusb_hid_init();
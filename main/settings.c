@@ -4,19 +4,40 @@
  * SPDX-License-Identifier: Unlicense OR CC0-1.0
  */
 
+#include <inttypes.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_check.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "rgb_matrix_nvs.h"
 #include "settings.h"
 
 static const char *TAG = "settings";
 
 #define NAME_SPACE "sys_param"
-#define KEY "param"
+#define KEY "settings"
+// Separate keys written before the settings blob, migrated on the first boot
+#define LEGACY_KEY "param"
+#define LEGACY_RGB_KEY "rgb_matrix"
+
+#define SETTINGS_VERSION 1
+// Quiet time after the last change before it is committed, a burst of changes costs one commit
+#define SETTINGS_COMMIT_DELAY_MS 2000
+// Longest a change stays in RAM while new changes keep coming
+#define SETTINGS_COMMIT_MAX_DELAY_MS 10000
+
+typedef struct __attribute__((packed))
+{
+    uint16_t version;
+    uint16_t size;
+    sys_param_t sys;
+    uint8_t rgb_valid;
+    rgb_config_t rgb;
+} settings_blob_t;
 
 static sys_param_t g_sys_param = {0};
 
@@ -28,38 +49,174 @@ static const sys_param_t g_default_sys_param = {
     .led_b = 255,
 };
 
+// s_blob is the pending state, s_committed what NVS holds
+static settings_blob_t s_blob = {.version = SETTINGS_VERSION, .size = sizeof(settings_blob_t)};
+static settings_blob_t s_committed;
+static bool s_dirty = false;
+static bool s_legacy = false;
+static settings_stats_t s_stats;
+static SemaphoreHandle_t s_lock = NULL;
+static SemaphoreHandle_t s_commit_lock = NULL;
+static TaskHandle_t s_task = NULL;
+
+static void settings_mark_dirty(void)
+{
+    s_dirty = true;
+    s_stats.requests++;
+    if (s_task)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static esp_err_t settings_rgb_load(rgb_config_t *config)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_blob.rgb_valid)
+    {
+        *config = s_blob.rgb;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return ret;
+}
+
+static esp_err_t settings_rgb_save(const rgb_config_t *config)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_blob.rgb = *config;
+    s_blob.rgb_valid = 1;
+    settings_mark_dirty();
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+static const rgb_matrix_store_t s_rgb_store = {
+    .load = settings_rgb_load,
+    .save = settings_rgb_save,
+};
+
+static void settings_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Wait for the changes to settle, bounded so a steady stream still gets saved
+        TickType_t first = xTaskGetTickCount();
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SETTINGS_COMMIT_DELAY_MS)) &&
+               xTaskGetTickCount() - first < pdMS_TO_TICKS(SETTINGS_COMMIT_MAX_DELAY_MS))
+        {
+        }
+        settings_commit();
+    }
+}
+
+static esp_err_t settings_read_legacy(nvs_handle_t handle)
+{
+    size_t len = sizeof(sys_param_t);
+    esp_err_t ret = nvs_get_blob(handle, LEGACY_KEY, &g_sys_param, &len);
+    if (ESP_OK != ret)
+    {
+        return ret;
+    }
+    s_blob.sys = g_sys_param;
+
+    len = sizeof(rgb_config_t);
+    if (ESP_OK == nvs_get_blob(handle, LEGACY_RGB_KEY, &s_blob.rgb, &len))
+    {
+        s_blob.rgb_valid = 1;
+    }
+    s_legacy = true;
+    ESP_LOGI(TAG, "Migrating settings from separate keys");
+    return ESP_OK;
+}
+
 esp_err_t settings_read_parameter_from_nvs(void)
 {
+    if (!s_lock)
+    {
+        s_lock = xSemaphoreCreateMutex();
+        s_commit_lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(s_lock && s_commit_lock, ESP_ERR_NO_MEM, TAG, "no memory for settings locks");
+        rgb_matrix_nvs_set_store(&s_rgb_store);
+        xTaskCreate(settings_task, "settings", 3 * 1024, NULL, 2, &s_task);
+    }
+
     nvs_handle_t my_handle = 0;
     esp_err_t ret = nvs_open(NAME_SPACE, NVS_READONLY, &my_handle);
-    if (ESP_ERR_NVS_NOT_FOUND == ret)
+    if (ESP_OK == ret)
     {
-        ESP_LOGW(TAG, "Not found, Set to default");
+        settings_blob_t blob = {0};
+        size_t len = sizeof(blob);
+        ret = nvs_get_blob(my_handle, KEY, &blob, &len);
+        if (ESP_OK == ret && (blob.version != SETTINGS_VERSION || blob.size != sizeof(blob) || len != sizeof(blob)))
+        {
+            ESP_LOGW(TAG, "Unknown settings version %d size %d", blob.version, blob.size);
+            ret = ESP_ERR_NVS_NOT_FOUND;
+        }
+        if (ESP_OK == ret)
+        {
+            s_blob = blob;
+            s_committed = blob;
+            g_sys_param = blob.sys;
+        }
+        else if (ESP_ERR_NVS_NOT_FOUND == ret)
+        {
+            ret = settings_read_legacy(my_handle);
+        }
+        nvs_close(my_handle);
+    }
+
+    if (ESP_OK != ret)
+    {
+        ESP_LOGW(TAG, "Not found (0x%x), Set to default", ret);
         memcpy(&g_sys_param, &g_default_sys_param, sizeof(sys_param_t));
         settings_write_parameter_to_nvs();
         return ESP_OK;
     }
-
-    ESP_GOTO_ON_FALSE(ESP_OK == ret, ret, err, TAG, "nvs open failed (0x%x)", ret);
-
-    size_t len = sizeof(sys_param_t);
-    ret = nvs_get_blob(my_handle, KEY, &g_sys_param, &len);
-    ESP_GOTO_ON_FALSE(ESP_OK == ret, ret, err, TAG, "can't read param");
-    nvs_close(my_handle);
-
-    return ret;
-err:
-    if (my_handle)
+    if (s_legacy)
     {
-        nvs_close(my_handle);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        settings_mark_dirty();
+        xSemaphoreGive(s_lock);
     }
-    return ret;
+    return ESP_OK;
 }
 
 esp_err_t settings_write_parameter_to_nvs(void)
 {
-    ESP_LOGI(TAG, "Saving settings");
-    nvs_handle_t my_handle = {0};
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_INVALID_STATE, TAG, "settings not loaded");
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_blob.sys = g_sys_param;
+    settings_mark_dirty();
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+esp_err_t settings_commit(void)
+{
+    settings_blob_t blob;
+    bool legacy;
+
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_INVALID_STATE, TAG, "settings not loaded");
+    xSemaphoreTake(s_commit_lock, portMAX_DELAY);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool dirty = s_dirty;
+    blob = s_blob;
+    legacy = s_legacy;
+    s_dirty = false;
+    xSemaphoreGive(s_lock);
+
+    if (!dirty || (!legacy && !memcmp(&blob, &s_committed, sizeof(blob))))
+    {
+        s_stats.skipped += dirty;
+        xSemaphoreGive(s_commit_lock);
+        return ESP_OK;
+    }
+
+    nvs_handle_t my_handle = 0;
     esp_err_t err = nvs_open(NAME_SPACE, NVS_READWRITE, &my_handle);
     if (err != ESP_OK)
     {
@@ -67,10 +224,38 @@ esp_err_t settings_write_parameter_to_nvs(void)
     }
     else
     {
-        err = nvs_set_blob(my_handle, KEY, &g_sys_param, sizeof(sys_param_t));
-        err |= nvs_commit(my_handle);
+        err = nvs_set_blob(my_handle, KEY, &blob, sizeof(blob));
+        if (ESP_OK == err && legacy)
+        {
+            nvs_erase_key(my_handle, LEGACY_KEY);
+            nvs_erase_key(my_handle, LEGACY_RGB_KEY);
+        }
+        if (ESP_OK == err)
+        {
+            err = nvs_commit(my_handle);
+        }
         nvs_close(my_handle);
     }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (ESP_OK == err)
+    {
+        s_committed = blob;
+        s_legacy = false;
+        s_stats.commits++;
+    }
+    else
+    {
+        // Keep the changes pending, the next change or shutdown retries
+        s_dirty = true;
+        s_stats.failures++;
+    }
+    settings_stats_t stats = s_stats;
+    xSemaphoreGive(s_lock);
+    xSemaphoreGive(s_commit_lock);
+
+    ESP_LOGI(TAG, "Saving settings %s, %" PRIu32 " commits for %" PRIu32 " changes, %" PRIu32 " skipped, %" PRIu32 " failed",
+             ESP_OK == err ? "done" : "failed", stats.commits, stats.requests, stats.skipped, stats.failures);
     return ESP_OK == err ? ESP_OK : ESP_FAIL;
 }
 
@@ -78,3 +263,10 @@ sys_param_t *settings_get_parameter(void)
 {
     return &g_sys_param;
 }
+
+void settings_get_stats(settings_stats_t *stats)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
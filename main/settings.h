@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include <stdint.h>
+#include "esp_err.h"
+
 enum
 {
     MODE_HID_USB = 0,
@@ -30,6 +33,30 @@ typedef struct
     uint8_t led_b;
 } sys_param_t;
 
+typedef struct
+{
+    uint32_t requests; // changes reported, system and RGB
+    uint32_t commits;  // NVS commits done
+    uint32_t skipped;  // commits left out because the blob was unchanged
+    uint32_t failures; // commits that failed and were retried later
+} settings_stats_t;
+
+/**
+ * @brief Load the system and RGB matrix settings and start the commit task.
+ * Must run before rgb_matrix_init(), which reads its config from here.
+ */
 esp_err_t settings_read_parameter_from_nvs(void);
+
+/**
+ * @brief Mark the system settings changed. Changes are kept in RAM and committed
+ * together once no new change came for a while.
+ */
 esp_err_t settings_write_parameter_to_nvs(void);
+
+/**
+ * @brief Commit pending changes now, call before the power goes away.
+ */
+esp_err_t settings_commit(void);
+
 sys_param_t *settings_get_parameter(void);
+void settings_get_stats(settings_stats_t *stats);
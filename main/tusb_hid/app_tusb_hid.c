@@ -13,6 +13,7 @@
 #include "driver/gpio.h"
 
 #include "app_tusb_hid.h"
+#include "app_led_stream.h"
 
 static const char *TAG = "TUSB HID";
 
@@ -20,7 +21,14 @@ static bool tusb_hid_is_inited = false;
 
 /************* TinyUSB descriptors ****************/
 
-#define TUSB_DESC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + CFG_TUD_HID * TUD_HID_DESC_LEN)
+enum
+{
+    ITF_NUM_KEYBOARD = 0,
+    ITF_NUM_LED_STREAM,
+    ITF_NUM_TOTAL
+};
+
+#define TUSB_DESC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
 
 /**
  * @brief HID report descriptor
@@ -33,28 +41,39 @@ const uint8_t hid_report_descriptor[] = {
     TUD_HID_REPORT_DESC_MOUSE(HID_REPORT_ID(HID_ITF_PROTOCOL_MOUSE)),
 };
 
+/**
+ * @brief Raw HID report descriptor of the LED stream interface, vendor page 0xFF00
+ */
+const uint8_t led_stream_report_descriptor[] = {
+    TUD_HID_REPORT_DESC_GENERIC_INOUT(APP_LED_STREAM_REPORT_SIZE),
+};
+
 /**
  * @brief String descriptor
  */
-const char *hid_string_descriptor[5] = {
+const char *hid_string_descriptor[6] = {
     // array of pointer to string descriptors
     (char[]){0x09, 0x04},     // 0: is supported language is English (0x0409)
     "TinyUSB",                // 1: Manufacturer
     "TinyUSB ESP32S3 Device", // 2: Product
     "123456",                 // 3: Serials, should use chip ID
     "CURSOR KEYBOARD",        // 4: HID
+    "CURSOR LED STREAM",      // 5: raw HID for host LED streaming
 };
 
 /**
  * @brief Configuration descriptor
  *
- * This is a simple configuration descriptor that defines 1 configuration and 1 HID interface
+ * This is a simple configuration descriptor that defines 1 configuration and 2 HID interfaces,
+ * the keyboard and a raw HID interface with an OUT endpoint polled every 1 ms for LED streaming
  */
 static const uint8_t hid_configuration_descriptor[] = {
     // Configuration number, interface count, string index, total length, attribute, power in mA
-    TUD_CONFIG_DESCRIPTOR(1, 1, 0, TUSB_DESC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, TUSB_DESC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
     // Interface number, string index, boot protocol, report descriptor len, EP In address, size & polling interval
-    TUD_HID_DESCRIPTOR(0, 4, false, sizeof(hid_report_descriptor), 0x81, 16, 10),
+    TUD_HID_DESCRIPTOR(ITF_NUM_KEYBOARD, 4, false, sizeof(hid_report_descriptor), 0x81, 16, 10),
+    // Interface number, string index, protocol, report descriptor len, EP Out & In address, size & polling interval
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_LED_STREAM, 5, HID_ITF_PROTOCOL_NONE, sizeof(led_stream_report_descriptor), 0x02, 0x82, APP_LED_STREAM_REPORT_SIZE, 1),
 };
 
 /********* TinyUSB HID callbacks ***************/
@@ -63,8 +82,8 @@ static const uint8_t hid_configuration_descriptor[] = {
 // Application return pointer to descriptor, whose contents must exist long enough for transfer to complete
 uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance)
 {
-    // We use only one interface and one HID report descriptor, so we can ignore parameter 'instance'
-    return hid_report_descriptor;
+    // HID instances are numbered in interface order
+    return instance == ITF_NUM_LED_STREAM ? led_stream_report_descriptor : hid_report_descriptor;
 }
 
 // Invoked when received GET_REPORT control request
@@ -84,6 +103,10 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_t
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize)
 {
+    if (instance == ITF_NUM_LED_STREAM)
+    {
+        appLedStreamReceive(buffer, bufsize);
+    }
 }
 
 void app_tusb_hid_send_key(uint8_t *keyBuf, uint8_t len)
@@ -96,6 +119,13 @@ void app_tusb_hid_send_key(uint8_t *keyBuf, uint8_t len)
     tud_hid_keyboard_report(HID_ITF_PROTOCOL_KEYBOARD, special_key_mask, key_cmd);
 }
 
+void app_tusb_hid_send_raw(const uint8_t *data, uint16_t len)
+{
+    if (!tusb_hid_is_inited || !tud_hid_n_ready(ITF_NUM_LED_STREAM))
+        return;
+    tud_hid_n_report(ITF_NUM_LED_STREAM, 0, data, len);
+}
+
 #define USB_MODE_PIN 4
 void usb_mode_pin_init(void)
 {
@@ -6,6 +6,7 @@ extern "C" {
 
 void app_tusb_hid_init(void);
 void app_tusb_hid_send_key(uint8_t *keyBuf, uint8_t len);
+void app_tusb_hid_send_raw(const uint8_t *data, uint16_t len);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The firmware compiles jsmn_parse() in json_utils.c, here it comes from the header
+#include "jsmn.h"
+#include "chatgpt_sse.h"
+
+// Random chunkings tried per transcript, on top of whole, byte by byte and every two way split
+#define HOST_RANDOM_RUNS 200
+
+typedef struct
+{
+    char *data;
+    size_t len;
+} host_buf_t;
+
+static bool read_file(const char *path, host_buf_t *buf)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "can't open %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    buf->len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    buf->data = malloc(buf->len + 1);
+    buf->len = fread(buf->data, 1, buf->len, file);
+    buf->data[buf->len] = '\0';
+    fclose(file);
+    return true;
+}
+
+static void on_delta(const char *text, size_t len, void *ctx)
+{
+    host_buf_t *out = ctx;
+    out->data = realloc(out->data, out->len + len + 1);
+    memcpy(out->data + out->len, text, len);
+    out->len += len;
+    out->data[out->len] = '\0';
+}
+
+/* Feed the transcript in chunks, chunk(i) gives the size of chunk i. The result is the text of
+ * all deltas, or "error: " and the message for an error reply.
+ */
+static char *replay(const host_buf_t *in, size_t (*chunk)(size_t index, void *arg), void *arg, bool *done)
+{
+    chatgpt_sse_t sse;
+    host_buf_t out = {calloc(1, 1), 0};
+
+    chatgpt_sse_init(&sse, on_delta, &out);
+    for (size_t pos = 0, i = 0; pos < in->len; i++)
+    {
+        size_t n = chunk(i, arg);
+        n = n > in->len - pos ? in->len - pos : n;
+        chatgpt_sse_feed(&sse, in->data + pos, n);
+        pos += n;
+    }
+    chatgpt_sse_finish(&sse);
+
+    if (sse.error)
+    {
+        free(out.data);
+        out.data = malloc(strlen(sse.error) + 8);
+        sprintf(out.data, "error: %s", sse.error);
+    }
+    *done = sse.done;
+    chatgpt_sse_free(&sse);
+    return out.data;
+}
+
+static size_t chunk_fixed(size_t index, void *arg)
+{
+    return *(size_t *)arg;
+}
+
+static size_t chunk_split(size_t index, void *arg)
+{
+    return index == 0 ? *(size_t *)arg : SIZE_MAX;
+}
+
+static size_t chunk_random(size_t index, void *arg)
+{
+    return 1 + rand() % *(size_t *)arg;
+}
+
+static bool check(const char *path, const char *how, char *got, const char *expected)
+{
+    bool ok = strcmp(got, expected) == 0;
+    if (!ok)
+    {
+        fprintf(stderr, "%s, %s:\n  got      \"%s\"\n  expected \"%s\"\n", path, how, got, expected);
+    }
+    free(got);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s transcript...\n  expects the text in <transcript>.expected\n", argv[0]);
+        return 2;
+    }
+
+    for (int a = 1; a < argc; a++)
+    {
+        host_buf_t in, expected;
+        char path[512];
+        char how[64];
+        bool done, whole_done;
+        int runs = 0, bad = 0;
+
+        snprintf(path, sizeof(path), "%s.expected", argv[a]);
+        if (!read_file(argv[a], &in) || !read_file(path, &expected))
+        {
+            return 2;
+        }
+        // The expected file ends with one line feed that is not part of the text
+        if (expected.len && expected.data[expected.len - 1] == '\n')
+        {
+            expected.data[--expected.len] = '\0';
+        }
+
+        size_t size = in.len;
+        bad += !check(argv[a], "whole", replay(&in, chunk_fixed, &size, &whole_done), expected.data);
+        size = 1;
+        bad += !check(argv[a], "byte by byte", replay(&in, chunk_fixed, &size, &done), expected.data);
+        bad += done != whole_done;
+        runs += 2;
+        for (size = 1; size < in.len; size++, runs++)
+        {
+            snprintf(how, sizeof(how), "split at %zu", size);
+            bad += !check(argv[a], how, replay(&in, chunk_split, &size, &done), expected.data);
+            bad += done != whole_done;
+        }
+        srand(1);
+        for (int i = 0; i < HOST_RANDOM_RUNS; i++, runs++)
+        {
+            size = 1 + rand() % 64;
+            snprintf(how, sizeof(how), "random run %d", i);
+            bad += !check(argv[a], how, replay(&in, chunk_random, &size, &done), expected.data);
+            bad += done != whole_done;
+        }
+
+        printf("%-28s %6zu bytes %6d runs %s%s\n", argv[a], in.len, runs, whole_done ? "[DONE] " : "", bad ? "FAILED" : "ok");
+        failed += bad != 0;
+        free(in.data);
+        free(expected.data);
+    }
+    return failed ? 1 : 0;
+}
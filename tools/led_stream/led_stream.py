@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+"""Stream LED frames to the keyboard over its raw HID interface and measure the throughput.
+
+The protocol is described in main/app_led/app_led_stream.h. Every SHOW is acknowledged once
+the frame left the LED data line, so the reported latency covers USB, the LED task and the
+strip transfer. Only the Python standard library is needed, the device is opened via hidraw.
+"""
+
+import argparse
+import colorsys
+import glob
+import math
+import os
+import select
+import statistics
+import sys
+import time
+
+REPORT_SIZE = 64
+CMD_PIXELS = 0x01
+CMD_SHOW = 0x02
+CMD_STOP = 0x03
+ACK = 0x80
+PIXELS_MAX = (REPORT_SIZE - 4) // 3
+# Usage Page (Vendor 0xFF00), the start of TUD_HID_REPORT_DESC_GENERIC_INOUT
+VENDOR_PAGE = bytes([0x06, 0x00, 0xFF])
+
+
+def find_device():
+    for path in sorted(glob.glob('/sys/class/hidraw/hidraw*')):
+        try:
+            with open(os.path.join(path, 'device', 'report_descriptor'), 'rb') as f:
+                desc = f.read()
+            with open(os.path.join(path, 'device', 'uevent')) as f:
+                uevent = f.read()
+        except OSError:
+            continue
+        # Espressif VID, the keyboard interface has no vendor page
+        if desc.startswith(VENDOR_PAGE) and ':0000303A:' in uevent.upper():
+            return '/dev/' + os.path.basename(path)
+    return None
+
+
+def pattern_rainbow(frame, count):
+    out = bytearray()
+    for i in range(count):
+        r, g, b = colorsys.hsv_to_rgb(((i * 4 + frame * 2) % 256) / 256.0, 1.0, 1.0)
+        out += bytes((int(r * 255), int(g * 255), int(b * 255)))
+    return out
+
+
+def pattern_dot(frame, count):
+    out = bytearray(count * 3)
+    pos = frame % count
+    out[pos * 3:pos * 3 + 3] = b'\xff\xff\xff'
+    return out
+
+
+def pattern_breathe(frame, count):
+    v = int((math.sin(frame / 30.0) + 1) * 127.5)
+    return bytearray((v, v // 2, 0) * count)
+
+
+PATTERNS = {'rainbow': pattern_rainbow, 'dot': pattern_dot, 'breathe': pattern_breathe}
+
+
+def changed_runs(frame, last, count):
+    """Runs of LEDs that differ from the last frame, at most PIXELS_MAX long."""
+    i = 0
+    while i < count:
+        if last is not None and frame[i * 3:i * 3 + 3] == last[i * 3:i * 3 + 3]:
+            i += 1
+            continue
+        start = i
+        while i < count and i - start < PIXELS_MAX and (last is None or frame[i * 3:i * 3 + 3] != last[i * 3:i * 3 + 3]):
+            i += 1
+        yield start, i - start
+
+
+class Stream:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR)
+        self.sent = {}
+        self.latency = []
+        self.reports = 0
+        self.current = (0, 0)
+
+    def write(self, payload):
+        # Report ID 0 prefix, the interface has no report IDs
+        os.write(self.fd, b'\x00' + bytes(payload).ljust(REPORT_SIZE, b'\x00'))
+        self.reports += 1
+
+    def pixels(self, frame, start, count):
+        self.write(bytes((CMD_PIXELS, start, count, 0)) + frame[start * 3:(start + count) * 3])
+
+    def show(self, seq):
+        self.sent[seq] = time.monotonic()
+        self.write(bytes((CMD_SHOW, seq)))
+
+    def stop(self):
+        self.write(bytes((CMD_STOP,)))
+
+    def poll(self, timeout):
+        """Collect acks, returns the number received."""
+        acks = 0
+        while select.select([self.fd], [], [], timeout)[0]:
+            data = os.read(self.fd, REPORT_SIZE + 1)
+            timeout = 0
+            if len(data) >= 6 and data[0] == ACK | CMD_SHOW:
+                sent = self.sent.pop(data[1], None)
+                if sent is not None:
+                    self.latency.append(time.monotonic() - sent)
+                self.current = (data[2] | data[3] << 8, data[4] | data[5] << 8)
+                acks += 1
+        return acks
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('-d', '--device', help='hidraw node, found by the vendor report descriptor if omitted')
+    parser.add_argument('-p', '--pattern', choices=sorted(PATTERNS), default='rainbow')
+    parser.add_argument('-n', '--leds', type=int, default=96)
+    parser.add_argument('-f', '--fps', type=float, default=0, help='target frame rate, 0 sends as fast as the acks come back')
+    parser.add_argument('-t', '--seconds', type=float, default=10)
+    parser.add_argument('--full', action='store_true', help='always send every LED instead of only the changed ones')
+    parser.add_argument('--inflight', type=int, default=2, help='frames sent ahead of the last ack')
+    args = parser.parse_args()
+
+    path = args.device or find_device()
+    if not path:
+        sys.exit('no LED stream interface found, pass --device /dev/hidrawN')
+    stream = Stream(path)
+    pattern = PATTERNS[args.pattern]
+
+    print(f'{path}: {args.pattern}, {args.leds} LEDs, {"full" if args.full else "delta"} frames')
+    start = time.monotonic()
+    next_frame = start
+    last = None
+    frame = 0
+    shown = 0
+    window_start, window_shown, window_lat = start, 0, 0
+    while time.monotonic() - start < args.seconds:
+        if args.fps:
+            delay = next_frame - time.monotonic()
+            if delay > 0:
+                shown += stream.poll(delay)
+            next_frame += 1.0 / args.fps
+        while len(stream.sent) >= args.inflight:
+            got = stream.poll(0.1)
+            if not got:
+                # Ack lost or device reset, do not stall forever
+                stream.sent.clear()
+            shown += got
+
+        data = pattern(frame, args.leds)
+        for run_start, run_count in changed_runs(data, None if args.full else last, args.leds):
+            stream.pixels(data, run_start, run_count)
+        stream.show(frame & 0xFF)
+        last = data
+        frame += 1
+        shown += stream.poll(0)
+
+        now = time.monotonic()
+        if now - window_start >= 1.0:
+            lat = stream.latency[window_lat:]
+            lat_ms = statistics.mean(lat) * 1000 if lat else 0
+            print(f'{(shown - window_shown) / (now - window_start):6.1f} fps  latency {lat_ms:5.2f} ms  '
+                  f'{stream.reports / frame:4.1f} reports/frame  {stream.current[0]} mA (requested {stream.current[1]} mA)')
+            window_start, window_shown, window_lat = now, shown, len(stream.latency)
+
+    shown += stream.poll(0.2)
+    elapsed = time.monotonic() - start
+    stream.stop()
+    lat = sorted(stream.latency)
+    print(f'{shown} frames shown in {elapsed:.1f} s, {shown / elapsed:.1f} fps sustained')
+    if lat:
+        print(f'latency ms: mean {statistics.mean(lat) * 1000:.2f}  p50 {lat[len(lat) // 2] * 1000:.2f}  '
+              f'p95 {lat[int(len(lat) * 0.95)] * 1000:.2f}  max {lat[-1] * 1000:.2f}')
+
+
+if __name__ == '__main__':
+    main()
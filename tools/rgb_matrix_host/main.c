@@ -0,0 +1,331 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "rgb_matrix.h"
+#include "rgb_matrix_nvs.h"
+#include "lib8tion/lib8tion.h"
+
+// Calls of rgb_matrix_task() without a flush after which an effect counts as stuck
+#define HOST_TASK_CALL_LIMIT 1000
+// A pseudo random key is pressed every this many frames for the reactive effects
+#define HOST_KEY_INTERVAL    10
+// Key hits are dropped once their 16 bit millisecond tick would overflow
+#define HOST_SETTLE_SECONDS  70
+
+typedef struct {
+    uint8_t     effect;
+    const char *name;
+} host_effect_t;
+
+static const host_effect_t host_effects[] = {
+#define RGB_MATRIX_EFFECT(name, ...) {RGB_MATRIX_##name, #name},
+#include "rgb_matrix_effects.inc"
+#undef RGB_MATRIX_EFFECT
+};
+
+static int64_t  s_now_us;
+static uint32_t s_flushes;
+static RGB      s_leds[CONFIG_MATRIX_LED_COUNT];
+// What the LEDs would show, s_leds after gamma and current limiting
+static RGB      s_output[COLOR_BATCH_ALIGN(CONFIG_MATRIX_LED_COUNT)] __attribute__((aligned(16)));
+static uint32_t s_key_seed = 1;
+
+/* ---------- IDF and driver stand-ins ---------- */
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+esp_err_t nvs_init_rgb_matrix()
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flush_rgb_matrix(bool if_flush)
+{
+    return ESP_OK;
+}
+
+static void null_init(void)
+{
+    memset(s_leds, 0, sizeof(s_leds));
+}
+
+static void null_set_color(int index, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (index >= 0 && index < CONFIG_MATRIX_LED_COUNT) {
+        s_leds[index].r = r;
+        s_leds[index].g = g;
+        s_leds[index].b = b;
+    }
+}
+
+static void null_set_color_all(uint8_t r, uint8_t g, uint8_t b)
+{
+    for (int i = 0; i < CONFIG_MATRIX_LED_COUNT; i++) {
+        null_set_color(i, r, g, b);
+    }
+}
+
+static void null_flush(void)
+{
+    rgb_matrix_output_apply(s_leds, s_output, CONFIG_MATRIX_LED_COUNT);
+    s_flushes++;
+}
+
+const rgb_matrix_driver_t rgb_matrix_driver = {
+    .init          = null_init,
+    .flush         = null_flush,
+    .set_color     = null_set_color,
+    .set_color_all = null_set_color_all,
+};
+
+/* ---------- frame output ---------- */
+
+typedef struct {
+    FILE *strip; // PPM, frames stacked top to bottom in key matrix layout
+    FILE *raw;   // rgb24 video, one CONFIG_MATRIX_COLS x CONFIG_MATRIX_ROWS picture per frame
+    int   scale;
+} host_dump_t;
+
+static FILE *dump_open(const char *dir, const char *name, const char *ext)
+{
+    char  path[512];
+    FILE *file;
+
+    snprintf(path, sizeof(path), "%s/%s.%s", dir, name, ext);
+    file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+    }
+    return file;
+}
+
+static RGB dump_pixel(uint8_t row, uint8_t col)
+{
+    uint8_t led   = g_led_config.matrix_co[row][col];
+    RGB     black = {0};
+    return led == NO_LED ? black : s_output[led];
+}
+
+static void dump_frame(host_dump_t *dump)
+{
+    for (uint8_t row = 0; row < CONFIG_MATRIX_ROWS; row++) {
+        for (uint8_t col = 0; col < CONFIG_MATRIX_COLS; col++) {
+            RGB pixel = dump_pixel(row, col);
+            fputc(pixel.r, dump->raw);
+            fputc(pixel.g, dump->raw);
+            fputc(pixel.b, dump->raw);
+        }
+        for (int y = 0; y < dump->scale; y++) {
+            for (uint8_t col = 0; col < CONFIG_MATRIX_COLS; col++) {
+                RGB pixel = dump_pixel(row, col);
+                for (int x = 0; x < dump->scale; x++) {
+                    fputc(pixel.r, dump->strip);
+                    fputc(pixel.g, dump->strip);
+                    fputc(pixel.b, dump->strip);
+                }
+            }
+        }
+    }
+}
+
+/* ---------- benchmark ---------- */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void host_inputs(uint16_t frame)
+{
+    rgb_matrix_audio_t audio = {0};
+    uint8_t            t     = frame;
+
+    if (frame % HOST_KEY_INTERVAL == 0) {
+        s_key_seed = s_key_seed * 1103515245u + 12345u;
+        process_rgb_matrix((s_key_seed >> 16) % CONFIG_MATRIX_ROWS, (s_key_seed >> 8) % CONFIG_MATRIX_COLS, true);
+    }
+
+    audio.level = sin8(t * 4);
+    for (uint8_t i = 0; i < RGB_MATRIX_AUDIO_BANDS; i++) {
+        audio.band[i] = sin8(t * 2 + i * 16);
+    }
+    rgb_matrix_audio_publish(&audio);
+}
+
+// Run rgb_matrix_task() until the driver is flushed once, returns the time spent or 0 if stuck
+static uint64_t host_render_frame(void)
+{
+    uint32_t flushes = s_flushes;
+    uint64_t start   = now_ns();
+
+    for (int calls = 0; s_flushes == flushes; calls++) {
+        if (calls == HOST_TASK_CALL_LIMIT) {
+            return 0;
+        }
+        rgb_matrix_task();
+    }
+    return now_ns() - start;
+}
+
+/* Let the key hits of the previous effect expire, so the output of an effect does not depend
+ * on which effects ran before it. Whole frames are rendered so the next effect starts on a
+ * frame boundary.
+ */
+static void host_settle(void)
+{
+    for (int i = 0; i < HOST_SETTLE_SECONDS; i++) {
+        s_now_us += 1000000;
+        host_render_frame();
+    }
+}
+
+static bool host_run_effect(const host_effect_t *effect, uint16_t frames, const char *dump_dir, int scale)
+{
+    host_dump_t dump     = {.scale = scale};
+    uint64_t    total_ns = 0;
+    uint64_t    max_ns   = 0;
+    uint32_t    max_ma   = 0;
+    uint32_t    hash     = 2166136261u;
+    bool        ok       = true;
+
+    if (dump_dir) {
+        dump.strip = dump_open(dump_dir, effect->name, "ppm");
+        dump.raw   = dump_open(dump_dir, effect->name, "rgb");
+        if (!dump.strip || !dump.raw) {
+            ok = false;
+            goto exit;
+        }
+        fprintf(dump.strip, "P6\n%d %d\n255\n", CONFIG_MATRIX_COLS * scale, CONFIG_MATRIX_ROWS * scale * frames);
+    }
+
+    /* Switch without rgb_matrix_mode_noeeprom(), which logs every change. The first frame still
+     * renders with init set because the mode differs from the last rendered effect.
+     */
+    host_settle();
+    rgb_matrix_config.mode = effect->effect;
+    s_key_seed             = 1;
+    srand(1);
+    random16_set_seed(1337); // RAND16_SEED of lib8tion.c
+
+    for (uint16_t frame = 0; frame < frames; frame++) {
+        s_now_us += RGB_MATRIX_LED_FLUSH_LIMIT * 1000;
+        host_inputs(frame);
+
+        uint64_t ns = host_render_frame();
+        if (!ns) {
+            fprintf(stderr, "%s: no flush after %d task calls at frame %u\n", effect->name, HOST_TASK_CALL_LIMIT, frame);
+            ok = false;
+            break;
+        }
+        total_ns += ns;
+        max_ns = ns > max_ns ? ns : max_ns;
+        hash   = fnv1a(hash, s_output, CONFIG_MATRIX_LED_COUNT * sizeof(RGB));
+
+        uint32_t requested_ma;
+        rgb_matrix_output_get_current(&requested_ma, NULL);
+        max_ma = requested_ma > max_ma ? requested_ma : max_ma;
+        if (dump_dir) {
+            dump_frame(&dump);
+        }
+    }
+
+    printf("%-28s %10" PRIu64 " %10" PRIu64 " %8" PRIu32 "   %08" PRIx32 "%s\n", effect->name, total_ns / frames, max_ns, max_ma, hash, ok ? "" : "   FAILED");
+
+exit:
+    if (dump.strip) {
+        fclose(dump.strip);
+    }
+    if (dump.raw) {
+        fclose(dump.raw);
+    }
+    return ok;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n frames] [-e effect] [-d dir] [-s scale] [-l]\n"
+            "  -n frames  frames rendered per effect, default 600\n"
+            "  -e effect  only effects whose name contains this string\n"
+            "  -d dir     write <effect>.ppm frame strips and <effect>.rgb raw video to dir\n"
+            "  -s scale   pixels per key in the frame strip, default 4\n"
+            "  -l         list the effects enabled in sdkconfig\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    int         frames   = 600;
+    int         scale    = 4;
+    const char *filter   = NULL;
+    const char *dump_dir = NULL;
+    int         failed   = 0;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "n:e:d:s:lh")) != -1) {
+        switch (opt) {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'e':
+            filter = optarg;
+            break;
+        case 'd':
+            dump_dir = optarg;
+            break;
+        case 's':
+            scale = atoi(optarg);
+            break;
+        case 'l':
+            for (size_t i = 0; i < sizeof(host_effects) / sizeof(host_effects[0]); i++) {
+                printf("%s\n", host_effects[i].name);
+            }
+            return 0;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (frames < 1 || frames > UINT16_MAX || scale < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    rgb_matrix_init();
+
+    printf("%d LEDs, %d frames at %d ms, %d mA budget\n", CONFIG_MATRIX_LED_COUNT, frames, RGB_MATRIX_LED_FLUSH_LIMIT, CONFIG_RGB_MATRIX_CURRENT_LIMIT_MA);
+    printf("%-28s %10s %10s %8s   %s\n", "effect", "ns/frame", "max ns", "peak mA", "fnv1a");
+    for (size_t i = 0; i < sizeof(host_effects) / sizeof(host_effects[0]); i++) {
+        if (filter && !strstr(host_effects[i].name, filter)) {
+            continue;
+        }
+        if (!host_run_effect(&host_effects[i], frames, dump_dir, scale)) {
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Host stand-in for the IDF header, only what the rgb matrix sources use
+#pragma once
+
+typedef int esp_err_t;
+
+#define ESP_OK   0
+#define ESP_FAIL -1
@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Host stand-in for the IDF header, time is a virtual clock advanced by the harness
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,13 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Host stand-in for the led_strip component, the harness provides a null rgb_matrix_driver
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct led_strip_t *led_strip_handle_t;